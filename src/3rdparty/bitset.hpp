@@ -0,0 +1,376 @@
+/*****************************************************
+ *  Garbage-collectable Data Structure: BitSet.
+ *
+ *  NOTE: it is a dense set over objects carrying a small, unique,
+ *        non-negative "id" field (e.g. tac::Temp). It is used
+ *        for dataflow analysis, where util::Set is too slow.
+ *
+ *        _T must be a pointer type with an "int id" member.
+ *        NULL is never an element of a BitSet.
+ *
+ *  PUBLIC INTERFACES:
+ *    iterator
+ *      - iterator type (elements are visited in ascending id order)
+ *
+ *    BitSet()
+ *      - default constructor
+ *
+ *    BitSet(size_t universe)
+ *      - constructor (with room for ids in [0, universe) preallocated)
+ *
+ *    BitSet(const set_type& s)
+ *      - constructs a set as same as the given set
+ *
+ *    size_t size(void) const
+ *      - returns the size of this set
+ *
+ *    void add(const _T e)
+ *      - adds an element to this set
+ *
+ *    void remove(const _T e)
+ *      - removes an element from this set
+ *
+ *    bool contains(const _T e) const
+ *      - tests whether this set contains the specified element
+ *
+ *    bool empty(void) const
+ *      - whether it is an empty set
+ *
+ *    void clear(void)
+ *      - erases all the elements in this set
+ *
+ *    BitSet<_T>* unionWith(const BitSet<_T>* s) const
+ *      - gets the union of this set and set s (i.e. this \cup s)
+ *
+ *    BitSet<_T>* intersectionWith(const BitSet<_T>* s) const
+ *      - gets the intersection of this set and set s (i.e. this \cap s)
+ *
+ *    BitSet<_T>* differenceFrom(const BitSet<_T>* s) const
+ *      - gets the difference set from set s (i.e. this - s)
+ *
+ *    void addAll(const BitSet<_T>* s)
+ *      - in-place union (i.e. this := this \cup s)
+ *
+ *    void removeAll(const BitSet<_T>* s)
+ *      - in-place difference (i.e. this := this - s)
+ *
+ *    void retainAll(const BitSet<_T>* s)
+ *      - in-place intersection (i.e. this := this \cap s)
+ *
+ *    void assign(const BitSet<_T>* s)
+ *      - makes this set equal to s without allocating (when possible)
+ *
+ *    BitSet<_T>* clone(void) const
+ *      - clones this set
+ *
+ *    bool equal(const BitSet<_T>* s) const
+ *      - tests whether this set is equal to the given set
+ *
+ *    iterator begin(void) const
+ *      - gets the begin iterator
+ *
+ *    iterator end(void) const
+ *      - gets the end iterator
+ *
+ *  The bulk operations work a machine word at a time, and two words at
+ *  a time with SSE2 when the compiler targets it.
+ */
+
+#ifndef __MIND_BITSET__
+#define __MIND_BITSET__
+
+#include "boehmgc.hpp"
+#include "vector.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace mind {
+
+namespace util {
+
+template <typename _T> class BitSet {
+  private:
+    typedef unsigned long _Word;
+    enum { _BITS = sizeof(_Word) * 8 };
+
+    size_t _nwords; // words in use (bits beyond them are zero)
+    size_t _capacity;
+    _Word *_words;
+
+    // maps an id back to its element (shared by all BitSet<_T>'s)
+    static Vector<_T> &_elements(void) {
+        static Vector<_T> elems;
+        return elems;
+    }
+
+    static size_t _wordsFor(size_t universe) {
+        return (universe + _BITS - 1) / _BITS;
+    }
+
+    void _reserve(size_t nwords) {
+        if (nwords <= _capacity)
+            return;
+
+        size_t cap = std::max(nwords, _capacity * 2);
+        _Word *w = new _Word[cap];
+        std::copy(_words, _words + _nwords, w);
+        std::fill(w + _nwords, w + cap, 0ul);
+        _words = w;
+        _capacity = cap;
+    }
+
+    void _grow(size_t nwords) {
+        if (nwords > _nwords) {
+            _reserve(nwords);
+            std::fill(_words + _nwords, _words + nwords, 0ul);
+            _nwords = nwords;
+        }
+    }
+
+    // d[i] = a[i] | b[i]
+    static void _or(_Word *d, const _Word *a, const _Word *b, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(d + i), _mm_or_si128(x, y));
+        }
+#endif
+        for (; i < n; ++i)
+            d[i] = a[i] | b[i];
+    }
+
+    // d[i] = a[i] & b[i]
+    static void _and(_Word *d, const _Word *a, const _Word *b, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(d + i), _mm_and_si128(x, y));
+        }
+#endif
+        for (; i < n; ++i)
+            d[i] = a[i] & b[i];
+    }
+
+    // d[i] = a[i] & ~b[i]
+    static void _andNot(_Word *d, const _Word *a, const _Word *b, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+            _mm_storeu_si128((__m128i *)(d + i), _mm_andnot_si128(y, x));
+        }
+#endif
+        for (; i < n; ++i)
+            d[i] = a[i] & ~b[i];
+    }
+
+    // whether a[0..n) == b[0..n)
+    static bool _same(const _Word *a, const _Word *b, size_t n) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        for (; i + 2 <= n; i += 2) {
+            __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+            __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF)
+                return false;
+        }
+#endif
+        for (; i < n; ++i)
+            if (a[i] != b[i])
+                return false;
+
+        return true;
+    }
+
+    static bool _zero(const _Word *a, size_t n) {
+        for (size_t i = 0; i < n; ++i)
+            if (0 != a[i])
+                return false;
+
+        return true;
+    }
+
+  public:
+    typedef BitSet<_T> set_type;
+
+    class iterator {
+      private:
+        const set_type *_s;
+        size_t _bit;
+
+        void _seek(void) {
+            size_t w = _bit / _BITS;
+            if (w >= _s->_nwords) {
+                _bit = _s->_nwords * _BITS;
+                return;
+            }
+
+            _Word x = _s->_words[w] & (~0ul << (_bit % _BITS));
+            while (0 == x) {
+                if (++w >= _s->_nwords) {
+                    _bit = _s->_nwords * _BITS;
+                    return;
+                }
+                x = _s->_words[w];
+            }
+            _bit = w * _BITS + __builtin_ctzl(x);
+        }
+
+      public:
+        iterator(const set_type *s, size_t bit) : _s(s), _bit(bit) { _seek(); }
+
+        _T operator*(void) const { return _elements()[_bit]; }
+
+        iterator &operator++(void) {
+            ++_bit;
+            _seek();
+            return *this;
+        }
+
+        bool operator==(const iterator &it) const { return _bit == it._bit; }
+        bool operator!=(const iterator &it) const { return _bit != it._bit; }
+    };
+
+    BitSet() {
+        _nwords = _capacity = 0;
+        _words = NULL;
+    }
+
+    BitSet(size_t universe) {
+        _nwords = 0;
+        _capacity = _wordsFor(universe);
+        _words = new _Word[_capacity];
+        std::fill(_words, _words + _capacity, 0ul);
+    }
+
+    BitSet(const set_type &s) {
+        _nwords = _capacity = s._nwords;
+        _words = new _Word[_capacity];
+        std::copy(s._words, s._words + s._nwords, _words);
+    }
+
+    size_t size(void) const {
+        size_t n = 0;
+        for (size_t i = 0; i < _nwords; ++i)
+            n += __builtin_popcountl(_words[i]);
+
+        return n;
+    }
+
+    void add(const _T e) {
+        if (NULL == e)
+            return;
+
+        size_t id = e->id;
+        Vector<_T> &elems = _elements();
+        if (id >= elems.size())
+            elems.resize(std::max(id + 1, elems.size() * 2), NULL);
+        elems[id] = e;
+
+        _grow(id / _BITS + 1);
+        _words[id / _BITS] |= (1ul << (id % _BITS));
+    }
+
+    void remove(const _T e) {
+        if (NULL == e)
+            return;
+
+        size_t id = e->id;
+        if (id / _BITS < _nwords)
+            _words[id / _BITS] &= ~(1ul << (id % _BITS));
+    }
+
+    bool contains(const _T e) const {
+        if (NULL == e)
+            return false;
+
+        size_t id = e->id;
+        return (id / _BITS < _nwords) &&
+               (0 != (_words[id / _BITS] & (1ul << (id % _BITS))));
+    }
+
+    bool empty(void) const { return _zero(_words, _nwords); }
+
+    void clear(void) {
+        std::fill(_words, _words + _nwords, 0ul);
+        // we don't release the memory here
+    }
+
+    void addAll(const set_type *s) {
+        _grow(s->_nwords);
+        _or(_words, _words, s->_words, s->_nwords);
+    }
+
+    void removeAll(const set_type *s) {
+        _andNot(_words, _words, s->_words, std::min(_nwords, s->_nwords));
+    }
+    void retainAll(const set_type *s) {
+        size_t n = std::min(_nwords, s->_nwords);
+        _and(_words, _words, s->_words, n);
+        std::fill(_words + n, _words + _nwords, 0ul);
+    }
+
+    void assign(const set_type *s) {
+        if (this == s)
+            return;
+
+        _reserve(s->_nwords);
+        std::copy(s->_words, s->_words + s->_nwords, _words);
+        if (_nwords > s->_nwords)
+            std::fill(_words + s->_nwords, _words + _nwords, 0ul);
+        else
+            _nwords = s->_nwords;
+    }
+
+    set_type *unionWith(const set_type *s) const {
+        set_type *tmp = clone();
+        tmp->addAll(s);
+
+        return tmp;
+    }
+
+    set_type *intersectionWith(const set_type *s) const {
+        size_t n = std::min(_nwords, s->_nwords);
+        set_type *tmp = new set_type(n * _BITS);
+        tmp->_nwords = n;
+        _and(tmp->_words, _words, s->_words, n);
+
+        return tmp;
+    }
+
+    set_type *differenceFrom(const set_type *s) const {
+        set_type *tmp = clone();
+        tmp->removeAll(s);
+
+        return tmp;
+    }
+
+    set_type *clone(void) const { return new set_type(*this); }
+
+    bool equal(const set_type *s) const {
+        size_t n = std::min(_nwords, s->_nwords);
+
+        return _same(_words, s->_words, n) &&
+               _zero(_words + n, _nwords - n) &&
+               _zero(s->_words + n, s->_nwords - n);
+    }
+
+    iterator begin(void) const { return iterator(this, 0); }
+
+    iterator end(void) const { return iterator(this, _nwords * _BITS); }
+};
+
+} // namespace util
+} // namespace mind
+
+#endif // __MIND_BITSET__
@@ -0,0 +1,559 @@
+/*****************************************************
+ *  Implementation of the graph-coloring register allocator.
+ *
+ *  Reference: L. George and A. W. Appel. Iterated Register Coalescing.
+ *             ACM TOPLAS 18(3), 1996.
+ *             (see also: Modern Compiler Implementation, Chapter 11)
+ */
+
+#include "asm/reg_alloc.hpp"
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace mind;
+using namespace mind::assembly;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* Constructor.
+ *
+ * PARAMETERS:
+ *   regs     - the registers which can be handed out (in order of preference)
+ *   num_regs - how many registers there are
+ */
+GraphColorAllocator::GraphColorAllocator(const int *regs, int num_regs)
+    : RegAllocator(regs, num_regs) {
+    _k = num_regs;
+}
+
+/* Gets the node of a temporary variable (creating it when necessary).
+ *
+ * PARAMETERS:
+ *   v     - the temporary variable
+ * RETURNS:
+ *   the node number
+ */
+int GraphColorAllocator::getNode(Temp v) {
+    if ((size_t)v->id >= _node.size())
+        _node.resize(v->id + 1, -1);
+
+    if (_node[v->id] < 0) {
+        _node[v->id] = _temps.size();
+        _temps.push_back(v);
+    }
+
+    return _node[v->id];
+}
+
+/* Adds an interference edge.
+ *
+ * PARAMETERS:
+ *   u, v  - the two nodes
+ */
+void GraphColorAllocator::addEdge(int u, int v) {
+    int n = _temps.size();
+
+    if (u == v || _adjSet[u * n + v])
+        return;
+
+    _adjSet[u * n + v] = _adjSet[v * n + u] = true;
+    _adjList[u].push_back(v);
+    _adjList[v].push_back(u);
+    ++_degree[u];
+    ++_degree[v];
+}
+
+/* Builds the interference graph and the move lists.
+ *
+ * NOTE: a definition interferes with everything alive after it, except
+ *       (for a copy) with its source: if the two are not otherwise
+ *       interfering, they may share a register.
+ * PARAMETERS:
+ *   g     - the control-flow graph (liveness of every TAC analyzed)
+ */
+void GraphColorAllocator::build(FlowGraph *g) {
+    Temp uses[2];
+
+    _temps.clear();
+    _node.clear();
+    _moves.clear();
+    _simplifyWorklist.clear();
+    _freezeWorklist.clear();
+    _worklistMoves.clear();
+    _selectStack.clear();
+
+    // Step 1. creates the nodes and sums up the spill costs
+    _cost.clear();
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        BasicBlock *b = *it;
+        double weight = 1;
+        for (int d = 0; d < b->loop_depth && d < 8; ++d)
+            weight *= 10;
+
+        for (BitSet<Temp>::iterator sit = b->LiveIn->begin();
+             sit != b->LiveIn->end(); ++sit)
+            getNode(*sit);
+
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = t->getUses(uses);
+            if (NULL != t->getDef())
+                uses[n++] = t->getDef();
+
+            for (int i = 0; i < n; ++i) {
+                if (NULL == uses[i])
+                    continue;
+                int v = getNode(uses[i]);
+                if ((size_t)v >= _cost.size())
+                    _cost.resize(v + 1, 0);
+                _cost[v] += weight;
+            }
+        }
+
+        if (BasicBlock::BY_JUMP != b->end_kind && NULL != b->var) {
+            int v = getNode(b->var);
+            if ((size_t)v >= _cost.size())
+                _cost.resize(v + 1, 0);
+            _cost[v] += weight;
+        }
+    }
+
+    int n = _temps.size();
+    _cost.resize(n, 0);
+    _adjSet.assign(n * n, false);
+    _adjList.assign(n, Vector<int>());
+    _moveList.assign(n, Vector<int>());
+    _degree.assign(n, 0);
+    _alias.assign(n, -1);
+    _color.assign(n, -1);
+    _state.assign(n, INITIAL);
+    _stamp.assign(n, 0);
+    _curStamp = 0;
+
+    // Step 2. adds the edges and the moves
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        for (Tac *t = (*it)->tac_chain; t != NULL; t = t->next) {
+            Temp def = t->getDef();
+            if (NULL == def)
+                continue;
+
+            int d = getNode(def);
+            Temp src = NULL;
+            if (Tac::ASSIGN == t->op_code && def != t->op1.var &&
+                t->LiveOut->contains(def)) {
+                src = t->op1.var;
+                Move m;
+                m.x = d;
+                m.y = getNode(src);
+                m.state = WORKLIST;
+                _moveList[m.x].push_back(_moves.size());
+                _moveList[m.y].push_back(_moves.size());
+                _worklistMoves.push_back(_moves.size());
+                _moves.push_back(m);
+            }
+
+            for (BitSet<Temp>::iterator sit = t->LiveOut->begin();
+                 sit != t->LiveOut->end(); ++sit)
+                if (*sit != src)
+                    addEdge(d, getNode(*sit));
+
+            // a selection reads its value after writing the destination
+            if (Tac::SEL_NZ == t->op_code || Tac::SEL_Z == t->op_code)
+                addEdge(d, getNode(t->op2.var));
+        }
+    }
+}
+
+/* Gets the neighbours which are still in the graph.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ *   adj   - receives the neighbours
+ */
+void GraphColorAllocator::adjacent(int u, Vector<int> &adj) {
+    adj.clear();
+    for (size_t i = 0; i < _adjList[u].size(); ++i) {
+        int v = _adjList[u][i];
+        if (SELECTED != _state[v] && COALESCED != _state[v])
+            adj.push_back(v);
+    }
+}
+
+/* Gets the moves of a node which could still be coalesced.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ *   mvs   - receives the move numbers
+ */
+void GraphColorAllocator::nodeMoves(int u, Vector<int> &mvs) {
+    mvs.clear();
+    for (size_t i = 0; i < _moveList[u].size(); ++i) {
+        int m = _moveList[u][i];
+        if (ACTIVE == _moves[m].state || WORKLIST == _moves[m].state)
+            mvs.push_back(m);
+    }
+}
+
+/* Whether a node is related to some move which could still be coalesced.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+bool GraphColorAllocator::moveRelated(int u) {
+    for (size_t i = 0; i < _moveList[u].size(); ++i) {
+        int m = _moveList[u][i];
+        if (ACTIVE == _moves[m].state || WORKLIST == _moves[m].state)
+            return true;
+    }
+
+    return false;
+}
+
+/* Puts every node into the proper worklist.
+ */
+void GraphColorAllocator::makeWorklist(void) {
+    for (size_t u = 0; u < _temps.size(); ++u) {
+        if (_degree[u] >= _k) {
+            _state[u] = SPILL;
+        } else if (moveRelated(u)) {
+            _state[u] = FREEZE;
+            _freezeWorklist.push_back(u);
+        } else {
+            _state[u] = SIMPLIFY;
+            _simplifyWorklist.push_back(u);
+        }
+    }
+}
+
+/* Removes a node of low degree from the graph.
+ */
+void GraphColorAllocator::simplify(void) {
+    Vector<int> adj;
+
+    int u = _simplifyWorklist.back();
+    _simplifyWorklist.pop_back();
+    if (SIMPLIFY != _state[u])
+        return; // stale entry
+
+    _state[u] = SELECTED;
+    _selectStack.push_back(u);
+    adjacent(u, adj);
+    for (size_t i = 0; i < adj.size(); ++i)
+        decrementDegree(adj[i]);
+}
+
+/* Decrements the degree of a node.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+void GraphColorAllocator::decrementDegree(int u) {
+    if (_degree[u]-- != _k || SPILL != _state[u])
+        return;
+
+    // it has just become of low degree
+    Vector<int> adj;
+    enableMoves(u);
+    adjacent(u, adj);
+    for (size_t i = 0; i < adj.size(); ++i)
+        enableMoves(adj[i]);
+
+    if (moveRelated(u)) {
+        _state[u] = FREEZE;
+        _freezeWorklist.push_back(u);
+    } else {
+        _state[u] = SIMPLIFY;
+        _simplifyWorklist.push_back(u);
+    }
+}
+
+/* Makes the moves of a node ready for coalescing again.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+void GraphColorAllocator::enableMoves(int u) {
+    for (size_t i = 0; i < _moveList[u].size(); ++i) {
+        int m = _moveList[u][i];
+        if (ACTIVE == _moves[m].state) {
+            _moves[m].state = WORKLIST;
+            _worklistMoves.push_back(m);
+        }
+    }
+}
+
+/* Moves a node to the simplify worklist when it is ready.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+void GraphColorAllocator::addWorkList(int u) {
+    if (FREEZE == _state[u] && !moveRelated(u) && _degree[u] < _k) {
+        _state[u] = SIMPLIFY;
+        _simplifyWorklist.push_back(u);
+    }
+}
+
+/* The Briggs test: two nodes can be coalesced safely if the combined
+ * node has less than K neighbours of significant degree.
+ *
+ * PARAMETERS:
+ *   u, v  - the two nodes
+ */
+bool GraphColorAllocator::conservative(int u, int v) {
+    Vector<int> adj;
+    int k = 0;
+
+    ++_curStamp;
+    for (int pass = 0; pass < 2; ++pass) {
+        adjacent(pass == 0 ? u : v, adj);
+        for (size_t i = 0; i < adj.size(); ++i) {
+            int w = adj[i];
+            if (_stamp[w] == _curStamp)
+                continue;
+            _stamp[w] = _curStamp;
+            if (_degree[w] >= _k)
+                ++k;
+        }
+    }
+
+    return k < _k;
+}
+
+/* Gets the representative of a (possibly coalesced) node.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+int GraphColorAllocator::getAlias(int u) {
+    while (COALESCED == _state[u])
+        u = _alias[u];
+
+    return u;
+}
+
+/* Tries to coalesce a move.
+ */
+void GraphColorAllocator::coalesce(void) {
+    int m = _worklistMoves.back();
+    _worklistMoves.pop_back();
+    if (WORKLIST != _moves[m].state)
+        return; // stale entry
+
+    int u = getAlias(_moves[m].x);
+    int v = getAlias(_moves[m].y);
+    int n = _temps.size();
+
+    if (u == v) {
+        _moves[m].state = COALESCED_MOVE;
+        addWorkList(u);
+
+    } else if (_adjSet[u * n + v]) {
+        _moves[m].state = CONSTRAINED;
+        addWorkList(u);
+        addWorkList(v);
+
+    } else if (conservative(u, v)) {
+        _moves[m].state = COALESCED_MOVE;
+        combine(u, v);
+        addWorkList(u);
+
+    } else {
+        _moves[m].state = ACTIVE;
+    }
+}
+
+/* Coalesces node v into node u.
+ *
+ * PARAMETERS:
+ *   u, v  - the two nodes
+ */
+void GraphColorAllocator::combine(int u, int v) {
+    Vector<int> adj;
+
+    _state[v] = COALESCED;
+    _alias[v] = u;
+    _cost[u] += _cost[v];
+    _moveList[u].insert(_moveList[u].end(), _moveList[v].begin(),
+                        _moveList[v].end());
+    enableMoves(v);
+
+    adjacent(v, adj);
+    for (size_t i = 0; i < adj.size(); ++i) {
+        addEdge(adj[i], u);
+        decrementDegree(adj[i]);
+    }
+
+    if (_degree[u] >= _k && FREEZE == _state[u])
+        _state[u] = SPILL;
+}
+
+/* Gives up coalescing the moves of a low-degree node.
+ */
+void GraphColorAllocator::freeze(void) {
+    int u = _freezeWorklist.back();
+    _freezeWorklist.pop_back();
+    if (FREEZE != _state[u])
+        return; // stale entry
+
+    _state[u] = SIMPLIFY;
+    _simplifyWorklist.push_back(u);
+    freezeMoves(u);
+}
+
+/* Freezes the moves of a node.
+ *
+ * PARAMETERS:
+ *   u     - the node
+ */
+void GraphColorAllocator::freezeMoves(int u) {
+    Vector<int> mvs;
+
+    nodeMoves(u, mvs);
+    for (size_t i = 0; i < mvs.size(); ++i) {
+        Move &m = _moves[mvs[i]];
+        int v = getAlias(m.y) == getAlias(u) ? getAlias(m.x) : getAlias(m.y);
+        m.state = FROZEN;
+
+        if (FREEZE == _state[v] && !moveRelated(v) && _degree[v] < _k) {
+            _state[v] = SIMPLIFY;
+            _simplifyWorklist.push_back(v);
+        }
+    }
+}
+
+/* Selects a node to be (potentially) spilled: the one with the lowest
+ * spill cost per interference.
+ *
+ * RETURNS:
+ *   false if there is no node of significant degree left
+ */
+bool GraphColorAllocator::selectSpill(void) {
+    int best = -1;
+
+    for (size_t u = 0; u < _temps.size(); ++u) {
+        if (SPILL != _state[u])
+            continue;
+        if (best < 0 ||
+            _cost[u] * _degree[best] < _cost[best] * _degree[u])
+            best = u;
+    }
+    if (best < 0)
+        return false;
+
+    _state[best] = SIMPLIFY;
+    _simplifyWorklist.push_back(best);
+    freezeMoves(best);
+
+    return true;
+}
+
+/* Gets the color a node would like to have (biased coloring).
+ *
+ * PARAMETERS:
+ *   u     - the node
+ *   used  - the colors taken by the neighbours
+ * RETURNS:
+ *   a free color: the hinted register of the node, or the color of a
+ *   node it is copied from or to (-1 if none of them is free)
+ */
+int GraphColorAllocator::preferredColor(int u, Vector<bool> &used) {
+    Vector<int> wanted;
+    wanted.push_back(getHint(_temps[u]));
+    for (size_t i = 0; i < _moveList[u].size(); ++i) {
+        Move &m = _moves[_moveList[u][i]];
+        int v = getAlias(m.x) == u ? getAlias(m.y) : getAlias(m.x);
+        if (COLORED == _state[v] && _color[v] >= 0)
+            wanted.push_back(_regs[_color[v]]);
+        else
+            wanted.push_back(getHint(_temps[v]));
+    }
+
+    for (size_t i = 0; i < wanted.size(); ++i)
+        for (int c = 0; c < _k && wanted[i] >= 0; ++c)
+            if (_regs[c] == wanted[i] && !used[c])
+                return c;
+
+    return -1;
+}
+
+/* Assigns colors to the nodes.
+ *
+ * NOTE: an optimistically pushed node which finds no color left is
+ *       spilled for real. Otherwise the color is chosen by the hints
+ *       (see preferredColor), or else it is one hinted to no node if
+ *       possible.
+ */
+void GraphColorAllocator::assignColors(void) {
+    Vector<bool> used;
+
+    while (!_selectStack.empty()) {
+        int u = _selectStack.back();
+        _selectStack.pop_back();
+
+        used.assign(_k, false);
+        for (size_t i = 0; i < _adjList[u].size(); ++i) {
+            int w = getAlias(_adjList[u][i]);
+            if (COLORED == _state[w] && _color[w] >= 0)
+                used[_color[w]] = true;
+        }
+
+        _state[u] = COLORED;
+        _color[u] = preferredColor(u, used);
+        for (int c = 0; c < _k && _color[u] < 0; ++c)
+            if (!used[c] && std::find(_hint.begin(), _hint.end(),
+                                      _regs[c]) == _hint.end())
+                _color[u] = c;
+        for (int c = 0; c < _k && _color[u] < 0; ++c)
+            if (!used[c])
+                _color[u] = c;
+    }
+
+    for (size_t u = 0; u < _temps.size(); ++u)
+        if (COALESCED == _state[u])
+            _color[u] = _color[getAlias(u)];
+}
+
+/* Assigns registers to the temporary variables of a function.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (liveness of every TAC analyzed)
+ */
+void GraphColorAllocator::allocate(FlowGraph *g) {
+    g->findLoops();
+    build(g);
+    makeWorklist();
+
+    for (;;) {
+        if (!_simplifyWorklist.empty())
+            simplify();
+        else if (!_worklistMoves.empty())
+            coalesce();
+        else if (!_freezeWorklist.empty())
+            freeze();
+        else if (!selectSpill())
+            break;
+    }
+    assignColors();
+
+    int spilled = 0, coalesced = 0;
+    resetAssignment();
+    for (size_t u = 0; u < _temps.size(); ++u) {
+        setReg(_temps[u], _color[u] < 0 ? -1 : _regs[_color[u]]);
+        if (_color[u] < 0)
+            ++spilled;
+    }
+    for (size_t m = 0; m < _moves.size(); ++m)
+        if (COALESCED_MOVE == _moves[m].state)
+            ++coalesced;
+
+    if (Option::showStats())
+        std::cerr << "graph coloring: " << _temps.size() << " nodes, "
+                  << coalesced << " of " << _moves.size()
+                  << " copies coalesced, " << spilled << " spilled"
+                  << std::endl;
+}
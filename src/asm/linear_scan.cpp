@@ -0,0 +1,263 @@
+/*****************************************************
+ *  Implementation of the linear-scan register allocator.
+ *
+ *  Reference: M. Poletto and V. Sarkar. Linear Scan Register Allocation.
+ *             ACM TOPLAS 21(5), 1999.
+ */
+
+#include "asm/reg_alloc.hpp"
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+using namespace mind;
+using namespace mind::assembly;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* Constructor.
+ *
+ * PARAMETERS:
+ *   regs     - the registers which can be handed out (in order of preference)
+ *   num_regs - how many registers there are
+ */
+LinearScanAllocator::LinearScanAllocator(const int *regs, int num_regs)
+    : RegAllocator(regs, num_regs) {}
+
+/* Makes the interval of a temporary variable cover the given position.
+ *
+ * PARAMETERS:
+ *   v      - the temporary variable (may be NULL)
+ *   pos    - the position
+ *   weight - the spill cost added by that position (0 if not a use or
+ *            a definition)
+ */
+void LinearScanAllocator::extend(Temp v, int pos, double weight) {
+    if (NULL == v)
+        return;
+
+    if ((size_t)v->id >= _index.size())
+        _index.resize(v->id + 1, NULL);
+
+    Interval *i = _index[v->id];
+    if (NULL == i) {
+        i = new Interval;
+        i->var = v;
+        i->start = i->end = pos;
+        i->reg = -1;
+        i->weight = 0;
+        i->copySrc = NULL;
+        _index[v->id] = i;
+        _intervals.push_back(i);
+
+    } else {
+        i->start = std::min(i->start, pos);
+        i->end = std::max(i->end, pos);
+    }
+    i->weight += weight;
+}
+
+/* Computes the live intervals.
+ *
+ * NOTE: the blocks are numbered in reverse postorder, and in every block
+ *       the entry, each TAC and the exit get a position of their own.
+ *       A variable live into (out of) a block covers its entry (exit),
+ *       so an interval is a conservative approximation of the real
+ *       lifetime, which may have holes.
+ * PARAMETERS:
+ *   g     - the control-flow graph (liveness already analyzed)
+ */
+void LinearScanAllocator::buildIntervals(FlowGraph *g) {
+    Vector<int> order;
+    Temp uses[2];
+    int pos = 0;
+
+    _intervals.clear();
+    _index.clear();
+    g->computeReversePostorder(order);
+
+    for (size_t k = 0; k < order.size(); ++k) {
+        BasicBlock *b = g->getBlock(order[k]);
+        double weight = 1;
+        for (int d = 0; d < b->loop_depth && d < 8; ++d)
+            weight *= 10;
+
+        int entry = pos++;
+        for (BitSet<Temp>::iterator it = b->LiveIn->begin(); it != b->LiveIn->end();
+             ++it)
+            extend(*it, entry, 0);
+
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = t->getUses(uses);
+            for (int i = 0; i < n; ++i)
+                extend(uses[i], pos, weight);
+            extend(t->getDef(), pos, weight);
+            if (Tac::ASSIGN == t->op_code)
+                addCopy(t->op0.var, t->op1.var, pos);
+            ++pos;
+        }
+
+        int exit = pos++;
+        if (BasicBlock::BY_JUMP != b->end_kind)
+            extend(b->var, exit, weight);
+        for (BitSet<Temp>::iterator it = b->LiveOut->begin();
+             it != b->LiveOut->end(); ++it)
+            extend(*it, exit, 0);
+    }
+}
+
+/* Records a copy between two temporary variables.
+ *
+ * PARAMETERS:
+ *   dst   - the destination of the copy
+ *   src   - the source of the copy
+ *   pos   - the position of the copy
+ * NOTE: both intervals already cover the position.
+ */
+void LinearScanAllocator::addCopy(Temp dst, Temp src, int pos) {
+    if (NULL == dst || NULL == src || dst == src)
+        return;
+
+    Interval *d = _index[dst->id], *s = _index[src->id];
+    d->copies.push_back(s);
+    s->copies.push_back(d);
+    if (d->start == pos && NULL == d->copySrc)
+        d->copySrc = s;
+}
+
+/* Takes a free register for an interval.
+ *
+ * PARAMETERS:
+ *   cur   - the interval
+ *   free_regs - the free registers (the preferred one is at the back)
+ * RETURNS:
+ *   the register, removed from "free_regs"
+ * NOTE: the hinted register of the temporary comes first, then the
+ *       register of an interval copied from or to (or the hinted
+ *       register of one which has none yet). Otherwise a register
+ *       hinted to no temporary is preferred.
+ */
+int LinearScanAllocator::takeFreeReg(Interval *cur, Vector<int> &free_regs) {
+    Vector<int> wanted;
+    wanted.push_back(getHint(cur->var));
+    for (size_t k = 0; k < cur->copies.size(); ++k) {
+        Interval *c = cur->copies[k];
+        wanted.push_back(c->reg >= 0 ? c->reg : getHint(c->var));
+    }
+
+    for (size_t k = 0; k < wanted.size(); ++k) {
+        if (wanted[k] < 0)
+            continue;
+        Vector<int>::iterator it =
+            std::find(free_regs.begin(), free_regs.end(), wanted[k]);
+        if (it != free_regs.end()) {
+            free_regs.erase(it);
+            return wanted[k];
+        }
+    }
+
+    // keeps the registers hinted to other temporaries free if possible
+    for (int k = (int)free_regs.size() - 1; k >= 0; --k) {
+        int r = free_regs[k];
+        if (std::find(_hint.begin(), _hint.end(), r) == _hint.end()) {
+            free_regs.erase(free_regs.begin() + k);
+            return r;
+        }
+    }
+
+    int r = free_regs.back();
+    free_regs.pop_back();
+    return r;
+}
+
+/* Orders the intervals by increasing start point.
+ */
+bool LinearScanAllocator::startsBefore(Interval *x, Interval *y) {
+    return x->start < y->start;
+}
+
+/* Assigns registers to the temporary variables of a function.
+ *
+ * NOTE: an interval is only expired when it ends strictly before the
+ *       current one starts; thus the destination of a TAC never shares
+ *       the register of one of its sources, and the instructions need
+ *       not care about the order in which they read and write. The
+ *       exception is a copy whose source dies there: the destination
+ *       may take the register over, and no "mv" is needed.
+ * PARAMETERS:
+ *   g     - the control-flow graph (liveness already analyzed)
+ */
+void LinearScanAllocator::allocate(FlowGraph *g) {
+    g->findLoops();
+    buildIntervals(g);
+    resetAssignment();
+
+    std::stable_sort(_intervals.begin(), _intervals.end(), startsBefore);
+
+    Vector<Interval *> active; // sorted by increasing end point
+    Vector<int> free_regs; // the preferred one is at the back
+    free_regs.assign(_regs.rbegin(), _regs.rend());
+    int spilled = 0;
+
+    for (size_t k = 0; k < _intervals.size(); ++k) {
+        Interval *cur = _intervals[k];
+
+        // expires the old intervals
+        size_t n = 0;
+        while (n < active.size() && active[n]->end < cur->start)
+            free_regs.push_back(active[n++]->reg);
+        active.erase(active.begin(), active.begin() + n);
+
+        Interval *src = cur->copySrc;
+        if (NULL != src && src->reg >= 0 && src->end == cur->start) {
+            Vector<Interval *>::iterator pos =
+                std::find(active.begin(), active.end(), src);
+            if (pos != active.end()) {
+                free_regs.push_back(src->reg);
+                active.erase(pos);
+            }
+        }
+
+        if (free_regs.empty()) {
+            // spills the cheapest interval (the one ending last on a tie)
+            int victim = -1;
+            for (int j = (int)active.size() - 1; j >= 0; --j) {
+                Interval *a = active[j];
+                if (a->weight < cur->weight ||
+                    (a->weight == cur->weight && a->end > cur->end)) {
+                    if (victim < 0 || a->weight < active[victim]->weight)
+                        victim = j;
+                }
+            }
+            if (victim >= 0) {
+                cur->reg = active[victim]->reg;
+                active[victim]->reg = -1;
+                active.erase(active.begin() + victim);
+            } else {
+                cur->reg = -1;
+            }
+            ++spilled;
+
+        } else {
+            cur->reg = takeFreeReg(cur, free_regs);
+        }
+
+        if (cur->reg >= 0) {
+            Vector<Interval *>::iterator pos = active.begin();
+            while (pos != active.end() && (*pos)->end <= cur->end)
+                ++pos;
+            active.insert(pos, cur);
+        }
+    }
+
+    for (size_t k = 0; k < _intervals.size(); ++k)
+        setReg(_intervals[k]->var, _intervals[k]->reg);
+
+    if (Option::showStats())
+        std::cerr << "linear scan: " << _intervals.size() << " intervals, "
+                  << spilled << " spilled" << std::endl;
+}
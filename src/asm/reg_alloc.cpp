@@ -0,0 +1,104 @@
+/*****************************************************
+ *  Implementation of the RegAllocator interface.
+ *
+ */
+
+#include "asm/reg_alloc.hpp"
+#include "config.hpp"
+#include "tac/tac.hpp"
+
+using namespace mind;
+using namespace mind::assembly;
+using namespace mind::tac;
+
+/* Constructor.
+ *
+ * PARAMETERS:
+ *   regs     - the registers which can be handed out (in order of preference)
+ *   num_regs - how many registers there are
+ */
+RegAllocator::RegAllocator(const int *regs, int num_regs) {
+    mind_assert(NULL != regs && num_regs > 0);
+
+    _regs.assign(regs, regs + num_regs);
+}
+
+/* Gets the register assigned to a temporary variable.
+ *
+ * PARAMETERS:
+ *   v     - the temporary variable
+ * RETURNS:
+ *   the register number, or -1 if the variable has been spilled
+ */
+int RegAllocator::getReg(Temp v) {
+    if (NULL == v || (size_t)v->id >= _assign.size())
+        return -1;
+
+    return _assign[v->id];
+}
+
+/* Forgets the assignment of the previous function.
+ */
+void RegAllocator::resetAssignment(void) { _assign.clear(); }
+
+/* Records the register of a temporary variable.
+ *
+ * PARAMETERS:
+ *   v     - the temporary variable
+ *   reg   - the register number (-1 for spilled)
+ */
+void RegAllocator::setReg(Temp v, int reg) {
+    if ((size_t)v->id >= _assign.size())
+        _assign.resize(v->id + 1, -1);
+
+    _assign[v->id] = reg;
+}
+
+/* Makes a temporary variable prefer a register.
+ *
+ * PARAMETERS:
+ *   v     - the temporary variable
+ *   reg   - the register number (e.g. RiscvReg::A0 for a return value)
+ * NOTE: the hint is only followed if the register is free; a register
+ *       which cannot be handed out is ignored.
+ */
+void RegAllocator::setHint(Temp v, int reg) {
+    if (NULL == v || !isAllocatable(reg))
+        return;
+
+    if ((size_t)v->id >= _hint.size())
+        _hint.resize(v->id + 1, -1);
+
+    _hint[v->id] = reg;
+}
+
+/* Forgets the preferred registers of the previous function.
+ */
+void RegAllocator::clearHints(void) { _hint.clear(); }
+
+/* Gets the preferred register of a temporary variable.
+ *
+ * PARAMETERS:
+ *   v     - the temporary variable
+ * RETURNS:
+ *   the register number, or -1 if there is no preference
+ */
+int RegAllocator::getHint(Temp v) {
+    if (NULL == v || (size_t)v->id >= _hint.size())
+        return -1;
+
+    return _hint[v->id];
+}
+
+/* Tests whether a register can be handed out.
+ *
+ * PARAMETERS:
+ *   reg   - the register number
+ */
+bool RegAllocator::isAllocatable(int reg) {
+    for (size_t k = 0; k < _regs.size(); ++k)
+        if (_regs[k] == reg)
+            return true;
+
+    return false;
+}
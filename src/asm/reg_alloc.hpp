@@ -0,0 +1,212 @@
+/*****************************************************
+ *  Whole-function Register Allocators.
+ *
+ *  These allocators decide, for a whole function at once, which
+ *  temporary variables live in a register during their entire
+ *  lifetime. The others are "spilled": the machine description keeps
+ *  them in the stack frame and moves them through a few scratch
+ *  registers (see RiscvDesc::getRegForRead and getRegForWrite).
+ *
+ *  They work on the control-flow graph, after FlowGraph::analyzeLiveness
+ *  and BasicBlock::analyzeLiveness have been done.
+ *
+ *  A temporary may prefer a register (a "hint"): the one it is passed
+ *  in or returned in, or the one of a temporary it is copied from or
+ *  to. The hinted register is taken whenever it is free, so that the
+ *  "mv" between the two disappears.
+ */
+
+#ifndef __MIND_REGALLOC__
+#define __MIND_REGALLOC__
+
+#include "3rdparty/vector.hpp"
+#include "define.hpp"
+
+namespace mind {
+#define MIND_REGALLOC_DEFINED
+namespace assembly {
+
+/**
+ * Register allocator (interface).
+ *
+ * NOTE: registers are identified by numbers of the target machine
+ *       (e.g. RiscvReg::T0); the allocator only hands out the ones
+ *       given to its constructor.
+ */
+class RegAllocator {
+  public:
+    // constructor
+    RegAllocator(const int *regs, int num_regs);
+    // assigns registers to the temporary variables of a function
+    virtual void allocate(tac::FlowGraph *) = 0;
+    // gets the register assigned to a temporary (-1 if spilled)
+    int getReg(tac::Temp);
+    // makes a temporary prefer a register (e.g. an argument register)
+    void setHint(tac::Temp, int);
+    // forgets the preferred registers of the previous function
+    void clearHints(void);
+    // destructor
+    virtual ~RegAllocator() {}
+
+  protected:
+    util::Vector<int> _regs;   // the registers which can be handed out
+    util::Vector<int> _assign; // register of every temp (indexed by id)
+    util::Vector<int> _hint;   // preferred register of every temp (by id)
+
+    // forgets the assignment of the previous function
+    void resetAssignment(void);
+    // records the register of a temporary (-1 for spilled)
+    void setReg(tac::Temp, int);
+    // gets the preferred register of a temporary (-1 if none)
+    int getHint(tac::Temp);
+    // whether a register can be handed out
+    bool isAllocatable(int);
+};
+
+/**
+ * Linear-scan register allocator (Poletto & Sarkar).
+ *
+ * Every temporary gets one live interval over a linear order of the
+ * whole function (the reverse postorder of the CFG). The intervals are
+ * scanned by increasing start point, and when the registers run out
+ * the interval with the lowest spill cost is spilled (the one which
+ * ends last, among equal costs). A free register is chosen by the
+ * hints: the preferred register of the temporary, or the one of a
+ * temporary it is copied from or to.
+ */
+class LinearScanAllocator : public RegAllocator {
+  public:
+    // constructor
+    LinearScanAllocator(const int *regs, int num_regs);
+    // assigns registers to the temporary variables of a function
+    virtual void allocate(tac::FlowGraph *);
+
+  private:
+    // live interval of a temporary
+    struct Interval {
+        tac::Temp var; // the temporary
+        int start;     // first position where it is alive
+        int end;       // last position where it is alive
+        int reg;       // the assigned register (-1 if spilled)
+        double weight; // spill cost: 10^(loop depth) per use or definition
+        util::Vector<Interval *> copies; // the intervals copied from or to
+        Interval *copySrc; // the source of the copy it starts with (or NULL)
+    };
+
+    util::Vector<Interval *> _intervals; // all the intervals
+    util::Vector<Interval *> _index;     // interval of every temp (by id)
+
+    // computes the live intervals
+    void buildIntervals(tac::FlowGraph *);
+    // makes the interval of a temporary cover the given position
+    void extend(tac::Temp, int, double);
+    // records a copy between two temporaries
+    void addCopy(tac::Temp, tac::Temp, int);
+    // takes a free register (the hinted one if possible)
+    int takeFreeReg(Interval *, util::Vector<int> &);
+    // orders the intervals by increasing start point
+    static bool startsBefore(Interval *, Interval *);
+};
+
+/**
+ * Graph-coloring register allocator with iterated coalescing
+ * (George & Appel).
+ *
+ * The interference graph is built from the LiveOut set of every TAC.
+ * The copies (Tac::ASSIGN) are coalesced whenever the Briggs test says
+ * it is safe, so that both sides get the same register and the "mv"
+ * disappears. When no node can be simplified, the one with the lowest
+ * (spill cost / degree) is spilled, where every use or definition
+ * costs 10^(loop depth). The copies which could not be coalesced still
+ * bias the colors (as do the hints), so they may vanish all the same.
+ *
+ * NOTE: the spilled temporaries are not rewritten; the machine
+ *       description moves them through its scratch registers.
+ */
+class GraphColorAllocator : public RegAllocator {
+  public:
+    // constructor
+    GraphColorAllocator(const int *regs, int num_regs);
+    // assigns registers to the temporary variables of a function
+    virtual void allocate(tac::FlowGraph *);
+
+  private:
+    // states of a node (a temporary)
+    enum { INITIAL, SIMPLIFY, FREEZE, SPILL, SELECTED, COALESCED, COLORED };
+    // states of a move
+    enum { WORKLIST, ACTIVE, COALESCED_MOVE, CONSTRAINED, FROZEN };
+
+    // a copy instruction between two nodes
+    struct Move {
+        int x, y;  // the two nodes
+        int state; // what has become of it
+    };
+
+    int _k; // number of colors (i.e. registers)
+
+    util::Vector<tac::Temp> _temps; // temporary of every node
+    util::Vector<int> _node;        // node of every temp (by id), or -1
+    util::Vector<bool> _adjSet;     // adjacency matrix
+    util::Vector<util::Vector<int> > _adjList;  // adjacency lists
+    util::Vector<util::Vector<int> > _moveList; // moves of every node
+    util::Vector<int> _degree;  // degree of every node
+    util::Vector<int> _alias;   // coalesced into which node
+    util::Vector<int> _color;   // color of every node (-1: spilled)
+    util::Vector<int> _state;   // state of every node
+    util::Vector<double> _cost; // spill cost of every node
+    util::Vector<int> _stamp;   // visiting marks (see adjacent)
+    int _curStamp;
+
+    util::Vector<Move> _moves;
+    // the worklists (NOTE: entries whose state no longer matches are stale)
+    util::Vector<int> _simplifyWorklist;
+    util::Vector<int> _freezeWorklist;
+    util::Vector<int> _worklistMoves;
+    util::Vector<int> _selectStack;
+
+    // gets the node of a temporary (creating it when necessary)
+    int getNode(tac::Temp);
+    // builds the interference graph and the move lists
+    void build(tac::FlowGraph *);
+    // adds an interference edge
+    void addEdge(int, int);
+    // puts every node into the proper worklist
+    void makeWorklist(void);
+    // gets the neighbours which are still in the graph
+    void adjacent(int, util::Vector<int> &);
+    // gets the moves of a node which could still be coalesced
+    void nodeMoves(int, util::Vector<int> &);
+    // whether a node is related to some copy which could be coalesced
+    bool moveRelated(int);
+    // removes a node of low degree from the graph
+    void simplify(void);
+    // decrements the degree of a node
+    void decrementDegree(int);
+    // makes the moves of a node and its neighbours ready for coalescing
+    void enableMoves(int);
+    // tries to coalesce a move
+    void coalesce(void);
+    // moves a node to the simplify worklist when it is ready
+    void addWorkList(int);
+    // the Briggs test for coalescing two nodes
+    bool conservative(int, int);
+    // gets the representative of a (possibly coalesced) node
+    int getAlias(int);
+    // coalesces the second node into the first one
+    void combine(int, int);
+    // gives up coalescing the moves of a low-degree node
+    void freeze(void);
+    // freezes the moves of a node
+    void freezeMoves(int);
+    // selects a node to be (potentially) spilled
+    bool selectSpill(void);
+    // gets the color a node would like to have
+    int preferredColor(int, util::Vector<bool> &);
+    // assigns colors to the nodes
+    void assignColors(void);
+};
+
+} // namespace assembly
+} // namespace mind
+
+#endif // __MIND_REGALLOC__
@@ -61,6 +61,41 @@ void RiscvStackFrameManager::reserve(Temp v) {
     slots[size] = v;
     size = reserved_size = reserved_size + 1;
     UPDATE_MAX();
+
+    shared.push_back(new BitSet<Temp>());
+    shared.back()->add(v);
+}
+
+/* Reserves a temporary variable in the reserved area, sharing the slot of
+ * other reserved variables if possible.
+ *
+ * PARAMETERS:
+ *   v         - the temporary variable to reserve
+ *   conflicts - the variables which are alive at the same time as v
+ * NOTE:
+ *   a slot is shared by variables which are never alive at the same
+ *   time (i.e. the reserved slots color the interference graph greedily)
+ */
+void RiscvStackFrameManager::reserve(Temp v, BitSet<Temp> *conflicts) {
+    if (v->is_offset_fixed)
+        return;
+
+    for (int i = 0; i < reserved_size; ++i) {
+        BitSet<Temp> *content = shared[i];
+        bool free = true;
+        for (BitSet<Temp>::iterator it = content->begin();
+             it != content->end() && free; ++it)
+            free = !conflicts->contains(*it);
+
+        if (free) {
+            v->offset = offsetOf(i);
+            v->is_offset_fixed = true;
+            content->add(v);
+            return;
+        }
+    }
+
+    reserve(v);
 }
 
 /* Finds a slot with the given variable as its content.
@@ -91,7 +126,7 @@ int RiscvStackFrameManager::findSlotOf(Temp v) {
  *   a slot number representing the slot into which
  *   the variable can be safely saved.
  */
-int RiscvStackFrameManager::getSlotToWrite(Temp v, Set<Temp> *liveness) {
+int RiscvStackFrameManager::getSlotToWrite(Temp v, BitSet<Temp> *liveness) {
     mind_assert(NULL != v && NULL != liveness && !v->is_offset_fixed);
 
     int i = findSlotOf(v);
@@ -7,7 +7,8 @@
 #ifndef __MIND_RISCVFM__
 #define __MIND_RISCVFM__
 
-#include "3rdparty/set.hpp"
+#include "3rdparty/bitset.hpp"
+#include "3rdparty/vector.hpp"
 #include "define.hpp"
 
 namespace mind {
@@ -29,8 +30,10 @@ class RiscvStackFrameManager {
     void reset(void);
     // reserves a variable in the local variable area
     void reserve(tac::Temp v);
+    // reserves a variable in a slot shared with the non-conflicting ones
+    void reserve(tac::Temp v, util::BitSet<tac::Temp> *conflicts);
     // gets a slot to spill some register (i.e. to save some temporary variable)
-    int getSlotToWrite(tac::Temp v, util::Set<tac::Temp> *liveness);
+    int getSlotToWrite(tac::Temp v, util::BitSet<tac::Temp> *liveness);
     // gets the size of the stack frame
     int getStackFrameSize(void);
 
@@ -41,6 +44,7 @@ class RiscvStackFrameManager {
     int start_offset;  // start offset
     int capacity;      // how many slots
     tac::Temp *slots;  // dynamic slots
+    util::Vector<util::BitSet<tac::Temp> *> shared; // content of reserved slots
 
     // computes the offset of a specified slot
     int offsetOf(int slot_num);
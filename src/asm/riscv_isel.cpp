@@ -0,0 +1,636 @@
+/*****************************************************
+ *  Instruction selection for RISC-V.
+ *
+ *  Inside a basic block, the temporaries holding known constants
+ *  (defined by LoadImm4, copied by Assign, or computed from other
+ *  constants) are the leaves of the expression DAG. Every TAC is covered
+ *  by the cheapest rule of the table below, which may take a constant
+ *  operand as an immediate number (addi, slti, xori, ...), use x0 for
+ *  zero, or fold the whole TAC into a single "li". A LoadImm4 is only
+ *  emitted when some rule still needs its value in a register. The value
+ *  of a rematerializable temporary (see RiscvDesc::findRematerializable)
+ *  is known in every block, and it is only loaded when read. The rules
+ *  using czero.eqz/czero.nez are only taken with Option::useZicond().
+ *
+ *  To support a new instruction, add it to RiscvInstr::OpCode and
+ *  riscv_opcodes (riscv_md.cpp), then write the rules using it here.
+ */
+
+#include "asm/riscv_md.hpp"
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <climits>
+#include <sstream>
+
+using namespace mind::assembly;
+using namespace mind::tac;
+using namespace mind::util;
+using namespace mind;
+
+// declaration of empty string
+#define EMPTY_STR std::string()
+
+// the operand forms a rule accepts: R (in a register) or I (constant)
+enum { F_R, F_I, F_RR, F_RI, F_IR, F_II };
+
+// the register operands of an instruction template
+enum { O_NONE, O_D, O_A, O_B, O_ZERO };
+
+// the immediate numbers of an instruction template
+enum {
+    I_NONE,
+    I_A,         // the value of op1
+    I_B,         // the value of op2
+    I_NEG_B,     // -op2
+    I_A_PLUS_1,  // op1 + 1
+    I_B_PLUS_1,  // op2 + 1
+    I_ONE,       // 1
+    I_MINUS_ONE, // -1
+    I_FOLD       // the value of the whole TAC
+};
+
+// an instruction to emit
+struct RiscvTemplate {
+    RiscvInstr::OpCode op;
+    int r0, r1, r2; // register operands
+    int imm;        // immediate number
+};
+
+/* Constraints on the constant operands. */
+static bool fits12(int x) { return x >= -2048 && x <= 2047; }
+static bool a_fits(int a, int) { return fits12(a); }
+static bool b_fits(int, int b) { return fits12(b); }
+static bool neg_b_fits(int, int b) { return b > -2048 && b <= 2048; }
+static bool a_plus_1_fits(int a, int) { return a >= -2049 && a <= 2046; }
+static bool b_plus_1_fits(int, int b) { return b >= -2049 && b <= 2046; }
+static bool a_zero(int a, int) { return 0 == a; }
+static bool b_zero(int, int b) { return 0 == b; }
+static bool a_nonzero(int a, int) { return 0 != a; }
+static bool b_nonzero(int, int b) { return 0 != b; }
+static bool b_shamt(int, int b) { return b >= 0 && b <= 31; }
+static bool divisible(int a, int b) { return 0 != b && !(INT_MIN == a && -1 == b); }
+
+#define D O_D
+#define A O_A
+#define B O_B
+#define X0 O_ZERO
+#define _ O_NONE
+
+/* The rules of the instruction selector.
+ *
+ * NOTE: the cost of a rule is the number of its instructions, plus one
+ *       for every nonzero constant it needs in a register. Among rules
+ *       of the same cost, the first one wins.
+ */
+static const struct RiscvRule {
+    Tac::Kind tac;              // the TAC it covers
+    int form;                   // the forms of the operands
+    bool (*fits)(int, int);     // constraint on the constants (NULL: none)
+    int n;                      // number of instructions
+    RiscvTemplate seq[4];       // the instructions
+} isel_rules[] = {
+    {Tac::ASSIGN, F_R, NULL, 1, {{RiscvInstr::ASSIGN, D, A, _, I_NONE}}},
+    {Tac::ASSIGN, F_I, NULL, 1, {{RiscvInstr::LI, D, _, _, I_A}}},
+
+    {Tac::NEG, F_R, NULL, 1, {{RiscvInstr::NEG, D, A, _, I_NONE}}},
+    {Tac::NEG, F_I, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::NOT, F_R, NULL, 1, {{RiscvInstr::SEQZ, D, A, _, I_NONE}}},
+    {Tac::NOT, F_I, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::LNOT, F_R, NULL, 1, {{RiscvInstr::SEQZ, D, A, _, I_NONE}}},
+    {Tac::LNOT, F_I, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::BNOT, F_R, NULL, 1, {{RiscvInstr::NOT, D, A, _, I_NONE}}},
+    {Tac::BNOT, F_I, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    {Tac::ADD, F_RR, NULL, 1, {{RiscvInstr::ADD, D, A, B, I_NONE}}},
+    {Tac::ADD, F_RI, b_fits, 1, {{RiscvInstr::ADDI, D, A, _, I_B}}},
+    {Tac::ADD, F_IR, a_fits, 1, {{RiscvInstr::ADDI, D, B, _, I_A}}},
+    {Tac::ADD, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    {Tac::SUB, F_RR, NULL, 1, {{RiscvInstr::SUB, D, A, B, I_NONE}}},
+    {Tac::SUB, F_RI, neg_b_fits, 1, {{RiscvInstr::ADDI, D, A, _, I_NEG_B}}},
+    {Tac::SUB, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    {Tac::MUL, F_RR, NULL, 1, {{RiscvInstr::MUL, D, A, B, I_NONE}}},
+    {Tac::MUL, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::DIV, F_RR, NULL, 1, {{RiscvInstr::DIV, D, A, B, I_NONE}}},
+    {Tac::DIV, F_II, divisible, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::MOD, F_RR, NULL, 1, {{RiscvInstr::MOD, D, A, B, I_NONE}}},
+    {Tac::MOD, F_II, divisible, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::SHL, F_RR, NULL, 1, {{RiscvInstr::SLL, D, A, B, I_NONE}}},
+    {Tac::SHL, F_RI, b_shamt, 1, {{RiscvInstr::SLLI, D, A, _, I_B}}},
+    {Tac::SHL, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::SHR, F_RR, NULL, 1, {{RiscvInstr::SRL, D, A, B, I_NONE}}},
+    {Tac::SHR, F_RI, b_shamt, 1, {{RiscvInstr::SRLI, D, A, _, I_B}}},
+    {Tac::SHR, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::SAR, F_RR, NULL, 1, {{RiscvInstr::SRA, D, A, B, I_NONE}}},
+    {Tac::SAR, F_RI, b_shamt, 1, {{RiscvInstr::SRAI, D, A, _, I_B}}},
+    {Tac::SAR, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    {Tac::MULH, F_RR, NULL, 1, {{RiscvInstr::MULH, D, A, B, I_NONE}}},
+    {Tac::MULH, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    // a < b
+    {Tac::LES, F_RR, NULL, 1, {{RiscvInstr::SLT, D, A, B, I_NONE}}},
+    {Tac::LES, F_RI, b_fits, 1, {{RiscvInstr::SLTI, D, A, _, I_B}}},
+    {Tac::LES, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // a > b  <=>  b < a
+    {Tac::GTR, F_RR, NULL, 1, {{RiscvInstr::SLT, D, B, A, I_NONE}}},
+    {Tac::GTR, F_IR, a_fits, 1, {{RiscvInstr::SLTI, D, B, _, I_A}}},
+    {Tac::GTR, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // a <= b  <=>  !(b < a)  <=>  a < b + 1
+    {Tac::LEQ,
+     F_RR,
+     NULL,
+     2,
+     {{RiscvInstr::SLT, D, B, A, I_NONE}, {RiscvInstr::XORI, D, D, _, I_ONE}}},
+    {Tac::LEQ, F_RI, b_plus_1_fits, 1, {{RiscvInstr::SLTI, D, A, _, I_B_PLUS_1}}},
+    {Tac::LEQ,
+     F_IR,
+     a_fits,
+     2,
+     {{RiscvInstr::SLTI, D, B, _, I_A}, {RiscvInstr::XORI, D, D, _, I_ONE}}},
+    {Tac::LEQ, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // a >= b  <=>  !(a < b)  <=>  b < a + 1
+    {Tac::GEQ,
+     F_RR,
+     NULL,
+     2,
+     {{RiscvInstr::SLT, D, A, B, I_NONE}, {RiscvInstr::XORI, D, D, _, I_ONE}}},
+    {Tac::GEQ,
+     F_RI,
+     b_fits,
+     2,
+     {{RiscvInstr::SLTI, D, A, _, I_B}, {RiscvInstr::XORI, D, D, _, I_ONE}}},
+    {Tac::GEQ, F_IR, a_plus_1_fits, 1, {{RiscvInstr::SLTI, D, B, _, I_A_PLUS_1}}},
+    {Tac::GEQ, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    // a == b  <=>  (a ^ b) == 0
+    {Tac::EQU,
+     F_RR,
+     NULL,
+     2,
+     {{RiscvInstr::XOR, D, A, B, I_NONE}, {RiscvInstr::SEQZ, D, D, _, I_NONE}}},
+    {Tac::EQU, F_RI, b_zero, 1, {{RiscvInstr::SEQZ, D, A, _, I_NONE}}},
+    {Tac::EQU, F_IR, a_zero, 1, {{RiscvInstr::SEQZ, D, B, _, I_NONE}}},
+    {Tac::EQU,
+     F_RI,
+     b_fits,
+     2,
+     {{RiscvInstr::XORI, D, A, _, I_B}, {RiscvInstr::SEQZ, D, D, _, I_NONE}}},
+    {Tac::EQU,
+     F_IR,
+     a_fits,
+     2,
+     {{RiscvInstr::XORI, D, B, _, I_A}, {RiscvInstr::SEQZ, D, D, _, I_NONE}}},
+    {Tac::EQU, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // a != b  <=>  (a ^ b) != 0
+    {Tac::NEQ,
+     F_RR,
+     NULL,
+     2,
+     {{RiscvInstr::XOR, D, A, B, I_NONE}, {RiscvInstr::SNEZ, D, D, _, I_NONE}}},
+    {Tac::NEQ, F_RI, b_zero, 1, {{RiscvInstr::SNEZ, D, A, _, I_NONE}}},
+    {Tac::NEQ, F_IR, a_zero, 1, {{RiscvInstr::SNEZ, D, B, _, I_NONE}}},
+    {Tac::NEQ,
+     F_RI,
+     b_fits,
+     2,
+     {{RiscvInstr::XORI, D, A, _, I_B}, {RiscvInstr::SNEZ, D, D, _, I_NONE}}},
+    {Tac::NEQ,
+     F_IR,
+     a_fits,
+     2,
+     {{RiscvInstr::XORI, D, B, _, I_A}, {RiscvInstr::SNEZ, D, D, _, I_NONE}}},
+    {Tac::NEQ, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    // a && b  <=>  ((a == 0) - 1) & b != 0   (using no other register)
+    {Tac::LAND,
+     F_RR,
+     NULL,
+     4,
+     {{RiscvInstr::SEQZ, D, A, _, I_NONE},
+      {RiscvInstr::ADDI, D, D, _, I_MINUS_ONE},
+      {RiscvInstr::AND, D, D, B, I_NONE},
+      {RiscvInstr::SNEZ, D, D, _, I_NONE}}},
+    {Tac::LAND, F_RI, b_nonzero, 1, {{RiscvInstr::SNEZ, D, A, _, I_NONE}}},
+    {Tac::LAND, F_RI, b_zero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::LAND, F_IR, a_nonzero, 1, {{RiscvInstr::SNEZ, D, B, _, I_NONE}}},
+    {Tac::LAND, F_IR, a_zero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::LAND, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // a || b  <=>  (a | b) != 0
+    {Tac::LOR,
+     F_RR,
+     NULL,
+     2,
+     {{RiscvInstr::OR, D, A, B, I_NONE}, {RiscvInstr::SNEZ, D, D, _, I_NONE}}},
+    {Tac::LOR, F_RI, b_zero, 1, {{RiscvInstr::SNEZ, D, A, _, I_NONE}}},
+    {Tac::LOR, F_RI, b_nonzero, 1, {{RiscvInstr::LI, D, _, _, I_ONE}}},
+    {Tac::LOR, F_IR, a_zero, 1, {{RiscvInstr::SNEZ, D, B, _, I_NONE}}},
+    {Tac::LOR, F_IR, a_nonzero, 1, {{RiscvInstr::LI, D, _, _, I_ONE}}},
+    {Tac::LOR, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+
+    // c ? b : 0  <=>  -(c != 0) & b   (czero.eqz with Zicond)
+    {Tac::SEL_NZ, F_RR, NULL, 1, {{RiscvInstr::CZERO_EQZ, D, B, A, I_NONE}}},
+    {Tac::SEL_NZ,
+     F_RR,
+     NULL,
+     3,
+     {{RiscvInstr::SNEZ, D, A, _, I_NONE},
+      {RiscvInstr::NEG, D, D, _, I_NONE},
+      {RiscvInstr::AND, D, D, B, I_NONE}}},
+    {Tac::SEL_NZ, F_RI, b_zero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::SEL_NZ, F_IR, a_nonzero, 1, {{RiscvInstr::MOVE, D, B, _, I_NONE}}},
+    {Tac::SEL_NZ, F_IR, a_zero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::SEL_NZ, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+    // c ? 0 : b  <=>  -(c == 0) & b   (czero.nez with Zicond)
+    {Tac::SEL_Z, F_RR, NULL, 1, {{RiscvInstr::CZERO_NEZ, D, B, A, I_NONE}}},
+    {Tac::SEL_Z,
+     F_RR,
+     NULL,
+     3,
+     {{RiscvInstr::SEQZ, D, A, _, I_NONE},
+      {RiscvInstr::NEG, D, D, _, I_NONE},
+      {RiscvInstr::AND, D, D, B, I_NONE}}},
+    {Tac::SEL_Z, F_RI, b_zero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::SEL_Z, F_IR, a_zero, 1, {{RiscvInstr::MOVE, D, B, _, I_NONE}}},
+    {Tac::SEL_Z, F_IR, a_nonzero, 1, {{RiscvInstr::MOVE, D, X0, _, I_NONE}}},
+    {Tac::SEL_Z, F_II, NULL, 1, {{RiscvInstr::LI, D, _, _, I_FOLD}}},
+};
+
+#undef D
+#undef A
+#undef B
+#undef X0
+#undef _
+
+#define NUM_RULES ((int)(sizeof(isel_rules) / sizeof(isel_rules[0])))
+
+/* Gets the value of an immediate operand of a template.
+ */
+static int template_imm(int imm, int a, int b, int folded) {
+    switch (imm) {
+    case I_A:
+        return a;
+    case I_B:
+        return b;
+    case I_NEG_B:
+        return -b;
+    case I_A_PLUS_1:
+        return a + 1;
+    case I_B_PLUS_1:
+        return b + 1;
+    case I_ONE:
+        return 1;
+    case I_MINUS_ONE:
+        return -1;
+    case I_FOLD:
+        return folded;
+    default:
+        return 0;
+    }
+}
+
+/* Whether a TAC is a unary one (w.r.t. the forms of isel_rules).
+ */
+static bool is_unary(Tac *t) {
+    switch (t->op_code) {
+    case Tac::ASSIGN:
+    case Tac::NEG:
+    case Tac::NOT:
+    case Tac::LNOT:
+    case Tac::BNOT:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/* Forgets all the known constants.
+ */
+void RiscvDesc::resetConsts(void) { ++_curGen; }
+
+/* Gets the constant held by a temporary at the current point.
+ *
+ * PARAMETERS:
+ *   v     - the temporary
+ *   val   - receives the value
+ * RETURNS:
+ *   whether the value is known
+ */
+bool RiscvDesc::getConst(Temp v, int &val) {
+    if (NULL == v || (size_t)v->id >= _constGen.size() ||
+        _constGen[v->id] != _curGen)
+        return getRematValue(v, val);
+
+    val = _constVal[v->id];
+    return true;
+}
+
+/* Gets the TAC giving the constant held by a temporary.
+ *
+ * RETURNS:
+ *   the TAC passed in the current block (NULL if none)
+ */
+Tac *RiscvDesc::getConstDef(Temp v) {
+    if (NULL == v || (size_t)v->id >= _constGen.size() ||
+        _constGen[v->id] != _curGen)
+        return NULL;
+
+    return _constDef[v->id];
+}
+
+/* Records the value of the temporary defined by a TAC.
+ *
+ * PARAMETERS:
+ *   t     - the TAC (just passed by the selector or the emitter)
+ */
+void RiscvDesc::updateConsts(Tac *t) {
+    Temp v = t->getDef();
+    if (NULL == v)
+        return;
+
+    if ((size_t)v->id >= _constGen.size()) {
+        _constVal.resize(v->id + 1, 0);
+        _constGen.resize(v->id + 1, 0);
+        _constDef.resize(v->id + 1, NULL);
+    }
+
+    int a = 0, b = 0, r;
+    bool known;
+    if (Tac::LOAD_IMM4 == t->op_code) {
+        known = true;
+        r = t->op1.ival;
+    } else {
+        known = getConst(t->op1.var, a) &&
+                (is_unary(t) || getConst(t->op2.var, b)) &&
+                t->evaluate(a, b, r);
+    }
+
+    if (known) {
+        _constVal[v->id] = r;
+        _constGen[v->id] = _curGen;
+        _constDef[v->id] = t;
+    } else {
+        _constGen[v->id] = 0;
+    }
+}
+
+/* Chooses the cheapest rule covering a TAC.
+ *
+ * PARAMETERS:
+ *   t     - the TAC
+ * RETURNS:
+ *   index of the rule in isel_rules
+ */
+int RiscvDesc::selectRule(Tac *t) {
+    int a = 0, b = 0;
+    bool ka = getConst(t->op1.var, a);
+    bool kb = !is_unary(t) && getConst(t->op2.var, b);
+    int best = -1, best_cost = INT_MAX;
+
+    for (int k = 0; k < NUM_RULES; ++k) {
+        const RiscvRule &r = isel_rules[k];
+        if (r.tac != t->op_code)
+            continue;
+        if (!Option::useZicond() && (RiscvInstr::CZERO_EQZ == r.seq[0].op ||
+                                     RiscvInstr::CZERO_NEZ == r.seq[0].op))
+            continue;
+
+        bool ra, rb; // whether op1 / op2 are taken in registers
+        switch (r.form) {
+        case F_R:
+            ra = true;
+            rb = false;
+            break;
+        case F_I:
+            ra = false;
+            rb = false;
+            break;
+        case F_RR:
+            ra = rb = true;
+            break;
+        case F_RI:
+            ra = true;
+            rb = false;
+            break;
+        case F_IR:
+            ra = false;
+            rb = true;
+            break;
+        default: // F_II
+            ra = rb = false;
+            break;
+        }
+        if ((!ra && !ka) || (!rb && !is_unary(t) && !kb))
+            continue;
+        if (F_I == r.form || F_II == r.form) {
+            int folded;
+            if (!t->evaluate(a, b, folded))
+                continue;
+        }
+        if (NULL != r.fits && !r.fits(a, b))
+            continue;
+
+        // every nonzero constant in a register needs a "li"
+        int cost = r.n;
+        if (ra && ka && 0 != a)
+            ++cost;
+        if (rb && kb && 0 != b)
+            ++cost;
+
+        if (cost < best_cost) {
+            best = k;
+            best_cost = cost;
+        }
+    }
+
+    mind_assert(best >= 0); // every TAC has a F_R or F_RR rule
+
+    return best;
+}
+
+/* Marks the LoadImm4 defining a constant as necessary (the value is
+ * wanted in a register).
+ */
+static void want_in_reg(Tac *def) {
+    if (NULL != def && Tac::LOAD_IMM4 == def->op_code)
+        def->mark = 1;
+}
+
+/* Selects the instruction patterns for the TACs of a basic block.
+ *
+ * NOTE: the chosen rule is stored in Tac::mark (and for LoadImm4,
+ *       Tac::mark tells whether the "li" is necessary).
+ * PARAMETERS:
+ *   b     - the basic block
+ *   fused - the comparison fused into the final branch (may be NULL)
+ */
+void RiscvDesc::selectInstructions(BasicBlock *b, Tac *fused) {
+    int val;
+
+    resetConsts();
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+        if (Tac::LOAD_IMM4 == t->op_code) {
+            // values living across blocks are always loaded
+            t->mark = b->LiveOut->contains(t->op0.var) ? 1 : 0;
+
+        } else if (t == fused) {
+            t->mark = -1;
+            if (getConst(t->op1.var, val) && 0 != val)
+                want_in_reg(getConstDef(t->op1.var));
+            if (getConst(t->op2.var, val) && 0 != val)
+                want_in_reg(getConstDef(t->op2.var));
+
+        } else if (!t->LiveOut->contains(t->op0.var)) {
+            t->mark = selectRule(t); // (will not be emitted anyway)
+
+        } else {
+            t->mark = selectRule(t);
+            int form = isel_rules[t->mark].form;
+            if ((F_R == form || F_RR == form || F_RI == form) &&
+                getConst(t->op1.var, val) && 0 != val)
+                want_in_reg(getConstDef(t->op1.var));
+            if ((F_RR == form || F_IR == form) &&
+                getConst(t->op2.var, val) && 0 != val)
+                want_in_reg(getConstDef(t->op2.var));
+        }
+        updateConsts(t);
+    }
+
+    // the value of a BY_RETURN block is always in a register
+    // (for BY_JZERO blocks, a known condition turns into a jump)
+    if (BasicBlock::BY_RETURN == b->end_kind && getConst(b->var, val))
+        want_in_reg(getConstDef(b->var));
+
+    resetConsts(); // ready for emitTac
+}
+
+/* Translates a single TAC into Riscv instructions (and records the result).
+ *
+ * NOTE: selectInstructions should have been called on the block.
+ * PARAMETERS:
+ *   t     - the TAC to translate
+ * SIDE-EFFECT:
+ *   modifies the "_tail" field
+ */
+void RiscvDesc::emitTac(Tac *t) {
+    std::ostringstream oss;
+    t->dump(oss);
+    addInstr(RiscvInstr::COMMENT, NULL, NULL, NULL, 0, EMPTY_STR,
+             oss.str().c_str() + 4);
+
+    // eliminates useless assignments (and the constants which can be
+    // loaded again where they are read, see getRegForRead)
+    int val;
+    if (!t->LiveOut->contains(t->op0.var) || getRematValue(t->op0.var, val)) {
+        updateConsts(t);
+        return;
+    }
+
+    if (Tac::LOAD_IMM4 == t->op_code) {
+        // uses "load immediate number" instruction (if still necessary)
+        if (t->mark) {
+            int r0 = getRegForWrite(t->op0.var, 0, 0, t->LiveOut);
+            addInstr(RiscvInstr::LI, _reg[r0], NULL, NULL, t->op1.ival,
+                     EMPTY_STR, NULL);
+        }
+        updateConsts(t);
+        return;
+    }
+
+    mind_assert(t->mark >= 0 && t->mark < NUM_RULES);
+    const RiscvRule &rule = isel_rules[t->mark];
+
+    // acquires the registers
+    int a = 0, b = 0, folded = 0;
+    bool ka = getConst(t->op1.var, a);
+    bool kb = !is_unary(t) && getConst(t->op2.var, b);
+    bool ra = (F_R == rule.form || F_RR == rule.form || F_RI == rule.form);
+    bool rb = (F_RR == rule.form || F_IR == rule.form);
+    if (F_I == rule.form || F_II == rule.form)
+        t->evaluate(a, b, folded);
+
+    // (a known zero is read from x0)
+    ra = ra && !(ka && 0 == a);
+    rb = rb && !(kb && 0 == b);
+    LiveSet *liveness = t->LiveOut->clone();
+    if (ra)
+        liveness->add(t->op1.var);
+    if (rb)
+        liveness->add(t->op2.var);
+    int r1 = RiscvReg::ZERO, r2 = RiscvReg::ZERO;
+    if (ra)
+        r1 = getRegForRead(t->op1.var, 0, liveness);
+    if (rb)
+        r2 = getRegForRead(t->op2.var, r1, liveness);
+
+    // a copy from a dying source takes its register over
+    if (Tac::ASSIGN == t->op_code && F_R == rule.form && ra &&
+        takeOverReg(r1, t->op0.var, t->LiveOut)) {
+        updateConsts(t);
+        return;
+    }
+    int r0 = getRegForWrite(t->op0.var, r1, r2, liveness);
+
+    // a source read after the destination has been written must not share
+    // the register of the destination: the operands of && are swapped, and
+    // a selection builds its mask in a scratch register "rd" instead
+    int rd = r0;
+    bool written = false;
+    for (int k = 0; k < rule.n; ++k) {
+        const RiscvTemplate &x = rule.seq[k];
+        if (written && r0 == r2 && (O_B == x.r1 || O_B == x.r2)) {
+            mind_assert(F_RR == rule.form);
+            if (Tac::LAND == t->op_code) {
+                std::swap(r1, r2); // (a && a is fine as it is)
+            } else {
+                rd = selectRegToSpill(r1, r2, liveness);
+                spillReg(rd, liveness);
+            }
+            break;
+        }
+        if (O_D == x.r0)
+            written = true;
+    }
+
+    // a coalesced copy needs no instruction
+    if (Tac::ASSIGN == t->op_code && F_R == rule.form && r0 == r1) {
+        updateConsts(t);
+        return;
+    }
+
+    for (int k = 0; k < rule.n; ++k) {
+        const RiscvTemplate &x = rule.seq[k];
+        RiscvReg *r[3];
+        int ops[3] = {x.r0, x.r1, x.r2};
+
+        for (int j = 0; j < 3; ++j) {
+            switch (ops[j]) {
+            case O_D:
+                // (only the last instruction writes the destination)
+                r[j] = _reg[(k + 1 == rule.n && 0 == j) ? r0 : rd];
+                break;
+            case O_A:
+                r[j] = _reg[r1];
+                break;
+            case O_B:
+                r[j] = _reg[r2];
+                break;
+            case O_ZERO:
+                r[j] = _reg[RiscvReg::ZERO];
+                break;
+            default:
+                r[j] = NULL;
+                break;
+            }
+        }
+
+        addInstr(x.op, r[0], r[1], r[2], template_imm(x.imm, a, b, folded),
+                 EMPTY_STR, NULL);
+    }
+
+    updateConsts(t);
+}
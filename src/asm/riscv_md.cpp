@@ -4,8 +4,9 @@
  */
 
 #include "asm/riscv_md.hpp"
-#include "3rdparty/set.hpp"
+#include "3rdparty/bitset.hpp"
 #include "asm/offset_counter.hpp"
+#include "asm/reg_alloc.hpp"
 #include "asm/riscv_frame_manager.hpp"
 #include "config.hpp"
 #include "options.hpp"
@@ -14,6 +15,8 @@
 #include "tac/flow_graph.hpp"
 #include "tac/tac.hpp"
 
+#include <algorithm>
+#include <climits>
 #include <cstring>
 #include <iomanip>
 #include <sstream>
@@ -27,6 +30,25 @@ using namespace mind;
 #define EMPTY_STR std::string()
 #define WORD_SIZE 4
 
+// how many jumps to the following label have been removed (see emitTrace)
+static int fall_through_jumps = 0;
+// how many comparisons have been fused into branches (see emitFusedBranch)
+static int fused_branches = 0;
+// how many branches have been inverted to fall through (see emitTrace)
+static int inverted_branches = 0;
+// how many registers have been stored into the stack frame (see spillReg)
+static int spilled_regs = 0;
+// how many variables have been loaded from the stack frame
+static int reloaded_regs = 0;
+// how many constants have been loaded again instead of reloaded
+static int remat_loads = 0;
+
+// the distance to a use beyond the current block
+#define FAR_AWAY (INT_MAX - 1)
+
+// whether a temporary can be loaded again by a "li" (see findRematerializable)
+enum { REMAT_UNKNOWN, REMAT_YES, REMAT_NO };
+
 /* Constructor of RiscvReg.
  *
  * PARAMETERS:
@@ -38,6 +60,7 @@ RiscvReg::RiscvReg(const char *reg_name, bool is_general) {
     dirty = false;
     var = NULL;
     general = is_general;
+    pinned = false;
 }
 
 /* Constructor of RiscvDesc.
@@ -87,8 +110,34 @@ RiscvDesc::RiscvDesc(void) {
     _reg[RiscvReg::A6] = new RiscvReg("a6", true); // argument
     _reg[RiscvReg::A7] = new RiscvReg("a7", true); // argument
 
-    _lastUsedReg = 0;
+    _curPos = 0;
+    _curGen = 0;
     _label_counter = 0;
+
+    _ra = NULL;
+    if (Option::getRegAlloc() != Option::LOCAL_RA) {
+        // t5 and t6 are kept for moving the spilled variables from/to the
+        // stack frame; the other general-purpose registers are handed out
+        // by the whole-function allocator (and so leave the local pool)
+        int regs[RiscvReg::TOTAL_NUM];
+        int num_regs = 0;
+        for (int i = 0; i < RiscvReg::TOTAL_NUM; ++i) {
+            if (_reg[i]->general && (i != RiscvReg::T5) &&
+                (i != RiscvReg::T6)) {
+                regs[num_regs++] = i;
+                _reg[i]->general = false;
+            }
+        }
+        if (Option::getRegAlloc() == Option::GRAPH_COLOR_RA)
+            _ra = new GraphColorAllocator(regs, num_regs);
+        else
+            _ra = new LinearScanAllocator(regs, num_regs);
+    } else {
+        // any register of the local pool can be pinned through a loop
+        for (int i = 0; i < RiscvReg::TOTAL_NUM; ++i)
+            if (_reg[i]->general)
+                _pinRegs.push_back(i);
+    }
 }
 
 /* Gets the offset counter for this machine.
@@ -132,6 +181,15 @@ void RiscvDesc::emitPieces(scope::GlobalScope *gscope, Piece *ps,
 
         ps = ps->next;
     }
+
+    if (Option::doOptimize() && Option::showStats()) {
+        showPeepholeStats();
+        std::cerr << "fused compare-and-branch: " << fused_branches
+                  << std::endl;
+        std::cerr << "register spills: " << spilled_regs << " stores, "
+                  << reloaded_regs << " reloads, " << remat_loads
+                  << " rematerialized" << std::endl;
+    }
 }
 
 /* Allocates a new label (for a basic block).
@@ -158,21 +216,48 @@ const char *RiscvDesc::getNewLabel(void) {
  */
 RiscvInstr *RiscvDesc::prepareSingleChain(BasicBlock *b, FlowGraph *g) {
     RiscvInstr leading;
-    int r0;
+    int r0, val, h;
+
+    // a comparison which only feeds the final branch is fused into it
+    Tac *cmp = NULL;
+    if (Option::doOptimize() && BasicBlock::BY_JZERO == b->end_kind)
+        cmp = findFusibleCompare(b);
+    selectInstructions(b, cmp);
+    computeNextUses(b);
+    takePinnedRegs(b, g);
 
     _tail = &leading;
-    for (Tac *t = b->tac_chain; t != NULL; t = t->next)
-        emitTac(t);
+    _curPos = 0;
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next, ++_curPos)
+        if (t != cmp)
+            emitTac(t);
 
     switch (b->end_kind) {
     case BasicBlock::BY_JUMP:
-        spillDirtyRegs(b->LiveOut);
+        h = getPinnedLoop(_pinEnter, b);
+        if (h >= 0)
+            loadPinnedRegs(b, g->getBlock(h)); // (a preheader)
+        else
+            spillDirtyRegs(b->LiveOut);
         addInstr(RiscvInstr::J, NULL, NULL, NULL, 0,
                  std::string(g->getBlock(b->next[0])->entry_label), NULL);
         // "B" for "branch"
         break;
 
     case BasicBlock::BY_JZERO:
+        if (NULL != cmp) {
+            emitFusedBranch(cmp, b, g);
+            break;
+        }
+        if (getConst(b->var, val)) {
+            // the condition is known: jumps to the right successor
+            spillDirtyRegs(b->LiveOut);
+            addInstr(RiscvInstr::J, NULL, NULL, NULL, 0,
+                     std::string(g->getBlock(b->next[0 == val ? 0 : 1])
+                                     ->entry_label),
+                     NULL);
+            break;
+        }
         r0 = getRegForRead(b->var, 0, b->LiveOut);
         spillDirtyRegs(b->LiveOut);
         // uses "branch if equal to zero" instruction
@@ -185,8 +270,9 @@ RiscvInstr *RiscvDesc::prepareSingleChain(BasicBlock *b, FlowGraph *g) {
     case BasicBlock::BY_RETURN:
         r0 = getRegForRead(b->var, 0, b->LiveOut);
         spillDirtyRegs(b->LiveOut); // just to deattach all temporary variables
-        addInstr(RiscvInstr::MOVE, _reg[RiscvReg::A0], _reg[r0], NULL, 0,
-                 EMPTY_STR, NULL);
+        if (RiscvReg::A0 != r0) // (unless the hint has been followed)
+            addInstr(RiscvInstr::MOVE, _reg[RiscvReg::A0], _reg[r0], NULL, 0,
+                     EMPTY_STR, NULL);
         addInstr(RiscvInstr::MOVE, _reg[RiscvReg::SP], _reg[RiscvReg::FP], NULL,
                  0, EMPTY_STR, NULL);
         addInstr(RiscvInstr::LW, _reg[RiscvReg::RA], _reg[RiscvReg::FP], NULL,
@@ -199,154 +285,180 @@ RiscvInstr *RiscvDesc::prepareSingleChain(BasicBlock *b, FlowGraph *g) {
     default:
         mind_assert(false); // unreachable
     }
+
+    // the next block begins with all the registers free
+    for (int i = 0; i < RiscvReg::TOTAL_NUM; ++i) {
+        _reg[i]->var = NULL;
+        _reg[i]->dirty = false;
+        _reg[i]->pinned = false;
+    }
     _tail = NULL;
     return leading.next;
 }
 
-/* Translates a single TAC into Riscv instructions (and records the result.
+/* Moves the comparison computing the condition of a branch to the end
+ * of its block, if nothing after it reads the condition or writes the
+ * operands.
  *
  * PARAMETERS:
- *   t     - the TAC to translate
- * SIDE-EFFECT:
- *   modifies the "_tail" field
+ *   g     - the control-flow graph (before the liveness analysis)
+ * NOTE:
+ *   a fused compare-and-branch reads the operands at the end of the
+ *   block, so they must be live there (see findFusibleCompare).
  */
-void RiscvDesc::emitTac(Tac *t) {
-    std::ostringstream oss;
-    t->dump(oss);
-    addInstr(RiscvInstr::COMMENT, NULL, NULL, NULL, 0, EMPTY_STR, oss.str().c_str() + 4);
+void RiscvDesc::sinkCompares(FlowGraph *g) {
+    Temp uses[2];
 
-    switch (t->op_code) {
-    case Tac::LOAD_IMM4:
-        emitLoadImm4Tac(t);
-        break;
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        BasicBlock *b = *it;
+        if (BasicBlock::BY_JZERO != b->end_kind)
+            continue;
 
-    case Tac::NEG:
-        emitUnaryTac(RiscvInstr::NEG, t);
-        break;
-    
-    case Tac::NOT:
-        emitUnaryTac(RiscvInstr::NOT, t);
-        break;
-    
-    case Tac::BNOT:
-        emitUnaryTac(RiscvInstr::BNOT, t);
-        break;
-    
-    case Tac::LNOT:
-        emitUnaryTac(RiscvInstr::LNOT, t);
-        break;
+        Tac *def = NULL, *last = NULL;
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            if (t->getDef() == b->var)
+                def = t;
+            last = t;
+        }
+        if (NULL == def || def == last)
+            continue;
 
-    case Tac::ADD:
-        emitBinaryTac(RiscvInstr::ADD, t);
-        break;
+        switch (def->op_code) {
+        case Tac::LES:
+        case Tac::LEQ:
+        case Tac::GTR:
+        case Tac::GEQ:
+        case Tac::EQU:
+        case Tac::NEQ:
+            break;
 
-    case Tac::MUL:
-        emitBinaryTac(RiscvInstr::MUL, t);
-        break;
+        default:
+            continue;
+        }
 
-    case Tac::SUB:
-        emitBinaryTac(RiscvInstr::SUB, t);
-        break;
+        bool movable = true;
+        for (Tac *t = def->next; t != NULL && movable; t = t->next) {
+            int n = t->getUses(uses);
+            for (int i = 0; i < n; ++i)
+                if (uses[i] == b->var)
+                    movable = false;
 
-    case Tac::DIV:
-        emitBinaryTac(RiscvInstr::DIV, t);
-        break;
+            Temp d = t->getDef();
+            if (NULL != d && (d == def->op1.var || d == def->op2.var))
+                movable = false;
+        }
+        if (!movable)
+            continue;
 
-    case Tac::MOD:
-        emitBinaryTac(RiscvInstr::MOD, t);
-        break;
+        if (NULL == def->prev)
+            b->tac_chain = def->next;
+        else
+            def->prev->next = def->next;
+        def->next->prev = def->prev;
+        last->next = def;
+        def->prev = last;
+        def->next = NULL;
+    }
+}
 
-    case Tac::LES:
-        emitBinaryTac(RiscvInstr::LES,t);
-        break;
+/* Finds the comparison which could be fused into the final branch.
+ *
+ * PARAMETERS:
+ *   b     - a BY_JZERO basic block
+ * RETURNS:
+ *   the comparison TAC defining the branch condition, if it is the last
+ *   TAC of the block and the condition is used nowhere else; NULL
+ *   otherwise
+ * NOTE:
+ *   the operands of an earlier comparison may have lost their registers
+ *   at the end of the block (see sinkCompares).
+ */
+Tac *RiscvDesc::findFusibleCompare(BasicBlock *b) {
+    Tac *def = b->tac_chain;
+    while (NULL != def && NULL != def->next)
+        def = def->next;
 
-    case Tac::LEQ:
-        emitBinaryTac(RiscvInstr::LEQ,t);
-        break;
+    if (NULL == def || def->getDef() != b->var ||
+        b->LiveOut->contains(b->var))
+        return NULL;
 
+    switch (def->op_code) {
+    case Tac::LES:
+    case Tac::LEQ:
     case Tac::GTR:
-        emitBinaryTac(RiscvInstr::GTR,t);
-        break;
-
     case Tac::GEQ:
-        emitBinaryTac(RiscvInstr::GEQ,t);
-        break;
-
-    case Tac::LOR:
-        emitBinaryTac(RiscvInstr::OR,t);
-        break;
-
-    case Tac::LAND:
-        emitBinaryTac(RiscvInstr::AND,t);
-        break;
-
     case Tac::EQU:
-        emitBinaryTac(RiscvInstr::EQU,t);
-        break;
-
     case Tac::NEQ:
-        emitBinaryTac(RiscvInstr::NEQ,t);
-        break;
-
-    case Tac::ASSIGN:
-        emitUnaryTac(RiscvInstr::ASSIGN,t);
-        break;
+        return def;
 
     default:
-        mind_assert(false); // should not appear inside a basic block
+        return NULL;
     }
 }
 
-/* Translates a LoadImm4 TAC into Riscv instructions.
+/* Translates the end of a BY_JZERO block whose condition is computed by
+ * a comparison into a single compare-and-branch instruction.
  *
  * PARAMETERS:
- *   t     - the LoadImm4 TAC
+ *   cmp   - the comparison TAC (see findFusibleCompare)
+ *   b     - the basic block
+ *   g     - the control-flow graph
  */
-void RiscvDesc::emitLoadImm4Tac(Tac *t) {
-    // eliminates useless assignments
-    if (!t->LiveOut->contains(t->op0.var))
-        return;
+void RiscvDesc::emitFusedBranch(Tac *cmp, BasicBlock *b, FlowGraph *g) {
+    LiveSet *liveness = b->LiveOut->clone();
+    int r1 = RiscvReg::ZERO, r2 = RiscvReg::ZERO, val;
+    // (a known zero is compared with x0)
+    bool ra = !getConst(cmp->op1.var, val) || 0 != val;
+    bool rb = !getConst(cmp->op2.var, val) || 0 != val;
+    if (ra)
+        liveness->add(cmp->op1.var);
+    if (rb)
+        liveness->add(cmp->op2.var);
+    if (ra)
+        r1 = getRegForRead(cmp->op1.var, 0, liveness);
+    if (rb)
+        r2 = getRegForRead(cmp->op2.var, r1, liveness);
+    spillDirtyRegs(b->LiveOut);
+
+    // branches to next[0] when the comparison does NOT hold
+    RiscvInstr::OpCode op = RiscvInstr::BNE;
+    RiscvReg *x = _reg[r1], *y = _reg[r2];
+    switch (cmp->op_code) {
+    case Tac::LES: // !(x < y) <=> x >= y
+        op = RiscvInstr::BGE;
+        break;
 
-    // uses "load immediate number" instruction
-    int r0 = getRegForWrite(t->op0.var, 0, 0, t->LiveOut);
-    addInstr(RiscvInstr::LI, _reg[r0], NULL, NULL, t->op1.ival, EMPTY_STR,
-             NULL);
-}
+    case Tac::GEQ: // !(x >= y) <=> x < y
+        op = RiscvInstr::BLT;
+        break;
 
-/* Translates a Unary TAC into Riscv instructions.
- *
- * PARAMETERS:
- *   t     - the Unary TAC
- */
-void RiscvDesc::emitUnaryTac(RiscvInstr::OpCode op, Tac *t) {
-    // eliminates useless assignments
-    if (!t->LiveOut->contains(t->op0.var))
-        return;
+    case Tac::LEQ: // !(x <= y) <=> y < x
+        op = RiscvInstr::BLT;
+        std::swap(x, y);
+        break;
 
-    int r1 = getRegForRead(t->op1.var, 0, t->LiveOut);
-    int r0 = getRegForWrite(t->op0.var, r1, 0, t->LiveOut);
+    case Tac::GTR: // !(x > y) <=> y >= x
+        op = RiscvInstr::BGE;
+        std::swap(x, y);
+        break;
 
-    addInstr(op, _reg[r0], _reg[r1], NULL, 0, EMPTY_STR, NULL);
-}
+    case Tac::EQU:
+        op = RiscvInstr::BNE;
+        break;
 
-/* Translates a Binary TAC into Riscv instructions.
- *
- * PARAMETERS:
- *   t     - the Binary TAC
- */
-void RiscvDesc::emitBinaryTac(RiscvInstr::OpCode op, Tac *t) {
-    // eliminates useless assignments
-    if (!t->LiveOut->contains(t->op0.var))
-        return;
+    case Tac::NEQ:
+        op = RiscvInstr::BEQ;
+        break;
 
-    Set<Temp>* liveness = t->LiveOut->clone();
-    liveness->add(t->op1.var);
-    liveness->add(t->op2.var);
-    int r1 = getRegForRead(t->op1.var, 0, liveness);
-    int r2 = getRegForRead(t->op2.var, r1, liveness);
-    int r0 = getRegForWrite(t->op0.var, r1, r2, liveness);
+    default:
+        mind_assert(false); // see findFusibleCompare
+    }
 
-    addInstr(op, _reg[r0], _reg[r1], _reg[r2], 0, EMPTY_STR, NULL);
+    addInstr(op, x, y, NULL, 0,
+             std::string(g->getBlock(b->next[0])->entry_label), NULL);
+    addInstr(RiscvInstr::J, NULL, NULL, NULL, 0,
+             std::string(g->getBlock(b->next[1])->entry_label), NULL);
+    ++fused_branches;
 }
 
 /* Outputs a single instruction line.
@@ -413,6 +525,502 @@ void RiscvDesc::getParamReg(Tac *t, int cnt) {
     _reg[RiscvReg::A0 + cnt]->dirty = true;
 }
 
+/* Gets the inverse of a conditional branch. (internal helper function)
+ *
+ * RETURNS:
+ *   the branch taken exactly when the given one is not
+ *   (RiscvInstr::J if the instruction is not a conditional branch)
+ */
+static RiscvInstr::OpCode invert_branch(RiscvInstr::OpCode op) {
+    switch (op) {
+    case RiscvInstr::BEQZ:
+        return RiscvInstr::BNEZ;
+    case RiscvInstr::BNEZ:
+        return RiscvInstr::BEQZ;
+    case RiscvInstr::BEQ:
+        return RiscvInstr::BNE;
+    case RiscvInstr::BNE:
+        return RiscvInstr::BEQ;
+    case RiscvInstr::BLT:
+        return RiscvInstr::BGE;
+    case RiscvInstr::BGE:
+        return RiscvInstr::BLT;
+    default:
+        return RiscvInstr::J;
+    }
+}
+
+/* Collects the basic blocks of a "trace". (internal helper function)
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph
+ *   b     - the leading basic block of this trace
+ *   order - the blocks collected so far (the trace is appended)
+ * NOTE:
+ *   we just do a simple depth-first search against the CFG
+ */
+static void trace_blocks(FlowGraph *g, BasicBlock *b, Vector<int> &order) {
+    // a trace is a series of consecutive basic blocks
+    while (0 == b->mark) {
+        b->mark = 1;
+        order.push_back(b->bb_num);
+
+        if (BasicBlock::BY_JUMP == b->end_kind)
+            b = g->getBlock(b->next[0]);
+        else if (BasicBlock::BY_JZERO == b->end_kind)
+            b = g->getBlock(b->next[1]);
+        else
+            break;
+    }
+}
+
+/* Marks the first block of every loop in the layout, unless the block
+ * emitted before it may fall through into it. (internal helper function)
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (after FlowGraph::findLoops)
+ *   order - the block numbers, in the order of emission
+ * NOTE:
+ *   the padding in front of a block is executed whenever the block is
+ *   entered by falling through, e.g. on every iteration of an outer loop.
+ */
+static void mark_loop_tops(FlowGraph *g, Vector<int> &order) {
+    Vector<int> pos;
+    pos.resize(g->size(), 0);
+    for (size_t k = 0; k < order.size(); ++k)
+        pos[order[k]] = (int)k;
+
+    for (size_t l = 0; l < g->numLoops(); ++l) {
+        Vector<int> &blocks = g->getLoop((int)l)->blocks;
+        int top = blocks[0];
+        for (size_t k = 1; k < blocks.size(); ++k)
+            if (pos[blocks[k]] < pos[top])
+                top = blocks[k];
+
+        if (pos[top] > 0) {
+            BasicBlock *prev = g->getBlock(order[pos[top] - 1]);
+            if ((BasicBlock::BY_JUMP == prev->end_kind &&
+                 prev->next[0] == top) ||
+                (BasicBlock::BY_JZERO == prev->end_kind &&
+                 (prev->next[0] == top || prev->next[1] == top)))
+                continue;
+        }
+        g->getBlock(top)->mark = 1;
+    }
+}
+
+/* Records that a variable is alive together with the ones in a set.
+ *
+ * PARAMETERS:
+ *   conflicts - the conflicting variables of every reserved variable
+ *   v         - the variable
+ *   live      - the variables alive at the same time
+ */
+static void add_conflicts(Vector<LiveSet *> &conflicts, Temp v,
+                          LiveSet *live) {
+    if ((size_t)v->id >= conflicts.size() || NULL == conflicts[v->id])
+        return;
+
+    for (LiveSet::iterator it = live->begin(); it != live->end(); ++it) {
+        Temp u = *it;
+        if (u != v && (size_t)u->id < conflicts.size() &&
+            NULL != conflicts[u->id]) {
+            conflicts[v->id]->add(u);
+            conflicts[u->id]->add(v);
+        }
+    }
+}
+
+/* Merges a constant definition into the state of a temporary. (internal
+ * helper function)
+ *
+ * RETURNS:
+ *   whether the state has changed
+ */
+static bool meet_remat(int &state, int &val, int def_val) {
+    if (REMAT_UNKNOWN == state) {
+        state = REMAT_YES;
+        val = def_val;
+        return true;
+    }
+    if (REMAT_YES == state && val != def_val) {
+        state = REMAT_NO;
+        return true;
+    }
+    return false;
+}
+
+/* Finds the temporaries which can be loaded again (by a "li") instead of
+ * being kept in the stack frame.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (after the liveness analysis and the
+ *           whole-function register allocation)
+ * NOTE:
+ *   such a temporary is only defined by LoadImm4s of the same value (or
+ *   by copies of such temporaries), it is not alive at the entry (so it
+ *   is defined wherever it is read), and it has no register of its own.
+ */
+void RiscvDesc::findRematerializable(FlowGraph *g) {
+    Vector<Tac *> copies;
+
+    _rematState.clear();
+    _rematVal.clear();
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+        for (Tac *t = (*it)->tac_chain; t != NULL; t = t->next) {
+            Temp v = t->getDef();
+            if (NULL == v)
+                continue;
+            int id = v->id;
+            if (Tac::ASSIGN == t->op_code && t->op1.var->id > id)
+                id = t->op1.var->id;
+            if ((size_t)id >= _rematState.size()) {
+                _rematState.resize(id + 1, REMAT_UNKNOWN);
+                _rematVal.resize(id + 1, 0);
+            }
+
+            if (Tac::LOAD_IMM4 == t->op_code)
+                meet_remat(_rematState[v->id], _rematVal[v->id], t->op1.ival);
+            else if (Tac::ASSIGN == t->op_code)
+                copies.push_back(t);
+            else
+                _rematState[v->id] = REMAT_NO;
+        }
+
+    LiveSet *entry = g->getBlock(0)->LiveIn;
+    for (LiveSet::iterator it = entry->begin(); it != entry->end(); ++it)
+        if ((size_t)(*it)->id < _rematState.size())
+            _rematState[(*it)->id] = REMAT_NO;
+
+    // a copy of a constant is the same constant (the copies in a cycle
+    // with no constant coming in are not)
+    for (int pass = 0; pass < 2; ++pass) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (size_t k = 0; k < copies.size(); ++k) {
+                int dst = copies[k]->op0.var->id, src = copies[k]->op1.var->id;
+                if (REMAT_YES == _rematState[src])
+                    changed = meet_remat(_rematState[dst], _rematVal[dst],
+                                         _rematVal[src]) ||
+                              changed;
+                else if (REMAT_NO == _rematState[src] &&
+                         REMAT_NO != _rematState[dst]) {
+                    _rematState[dst] = REMAT_NO;
+                    changed = true;
+                }
+            }
+        }
+        for (size_t k = 0; k < copies.size(); ++k)
+            if (REMAT_UNKNOWN == _rematState[copies[k]->op1.var->id])
+                _rematState[copies[k]->op1.var->id] = REMAT_NO;
+    }
+}
+
+/* Gets the value of a rematerializable temporary.
+ *
+ * PARAMETERS:
+ *   v     - the temporary
+ *   val   - receives the value
+ * RETURNS:
+ *   whether the temporary is rematerializable
+ */
+bool RiscvDesc::getRematValue(Temp v, int &val) {
+    if (NULL == v || (size_t)v->id >= _rematState.size() ||
+        REMAT_YES != _rematState[v->id] ||
+        (NULL != _ra && _ra->getReg(v) >= 0))
+        return false;
+
+    val = _rematVal[v->id];
+    return true;
+}
+
+/* Analyzes the liveness of the blocks and of every TAC. (internal helper
+ * function)
+ */
+static void analyze_all_liveness(FlowGraph *g) {
+    g->analyzeLiveness();
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+        (*it)->analyzeLiveness();
+}
+
+/* Splits the live ranges of the spilled variables around the innermost
+ * loops, so that the whole-function allocator may keep them in registers
+ * through the loops (see FlowGraph::splitAroundLoops).
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (after the register allocation)
+ * NOTE:
+ *   the registers are allocated again. A piece which is still spilled
+ *   only adds copies, so it is joined back and the registers are
+ *   allocated once more.
+ */
+void RiscvDesc::splitSpilledRanges(FlowGraph *g) {
+    LiveSet *spilled = new LiveSet();
+    Vector<Temp> orig, piece, join_orig, join_piece;
+    Temp uses[2];
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        BasicBlock *b = *it;
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            Temp v = t->getDef();
+            if (NULL != v && _ra->getReg(v) < 0)
+                spilled->add(v);
+            int n = t->getUses(uses);
+            for (int k = 0; k < n; ++k)
+                if (_ra->getReg(uses[k]) < 0)
+                    spilled->add(uses[k]);
+        }
+        if (BasicBlock::BY_JUMP != b->end_kind && _ra->getReg(b->var) < 0)
+            spilled->add(b->var);
+    }
+
+    if (spilled->empty() || 0 == g->splitAroundLoops(spilled, orig, piece))
+        return;
+    analyze_all_liveness(g);
+    _ra->allocate(g);
+
+    for (size_t k = 0; k < piece.size(); ++k)
+        if (_ra->getReg(piece[k]) < 0) {
+            join_orig.push_back(orig[k]);
+            join_piece.push_back(piece[k]);
+        }
+    if (join_piece.empty())
+        return;
+    g->joinRanges(join_orig, join_piece);
+    analyze_all_liveness(g);
+    _ra->allocate(g);
+
+    if (Option::showStats())
+        std::cerr << "live range splitting: " << join_piece.size()
+                  << " still spilled, joined back" << std::endl;
+}
+
+/* Chooses the variables which stay in registers through the loops made
+ * of a single block, when there is no whole-function allocator.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (after the liveness analysis)
+ * RETURNS:
+ *   whether some edge has been split (the liveness should be analyzed
+ *   again then)
+ * NOTE:
+ *   such a variable is alive around the back edge and used in the loop.
+ *   The preheader (split off the entering edge if the loop has none)
+ *   loads it into its register, the loop never spills it, and the block
+ *   on every exit edge (split if the target has other predecessors)
+ *   takes the register over, storing it when necessary.
+ *   So the live range is split at the loop boundary: in a register
+ *   inside, in the stack frame outside. The most referenced variables
+ *   are taken first, leaving enough registers for the others.
+ */
+bool RiscvDesc::pinLoopValues(FlowGraph *g) {
+    Vector<int> refs; // how many times a variable is referenced (by id)
+    Vector<Temp> cands;
+    Temp refd[3];
+    bool split = false;
+    int num_values = 0, num_loops = 0;
+
+    _pinned.resize(g->size());
+    g->findLoops();
+
+    for (size_t l = 0; l < g->numLoops(); ++l) {
+        Loop *loop = g->getLoop((int)l);
+        BasicBlock *b = g->getBlock(loop->header);
+        int entering = -1, num_entering = 0;
+        for (size_t k = 0; k < b->preds.size(); ++k)
+            if (b->preds[k] != b->bb_num) {
+                entering = b->preds[k];
+                ++num_entering;
+            }
+        if (loop->blocks.size() != 1 || 0 == b->bb_num ||
+            (loop->preheader < 0 && 1 != num_entering))
+            continue;
+
+        // the candidates: alive around the back edge, referenced inside
+        LiveSet *around = b->LiveIn->clone();
+        around->retainAll(b->LiveOut);
+        cands.clear();
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = t->getUses(refd);
+            refd[n++] = t->getDef();
+            for (int k = 0; k < n; ++k) {
+                Temp v = refd[k];
+                if (NULL == v || !around->contains(v))
+                    continue;
+                if ((size_t)v->id >= refs.size())
+                    refs.resize(v->id + 1, 0);
+                if (0 == refs[v->id]++)
+                    cands.push_back(v);
+            }
+        }
+        if (cands.empty())
+            continue;
+
+        // the registers wanted by the other variables
+        int pressure = 0;
+        LiveSet *cand_set = new LiveSet();
+        for (size_t k = 0; k < cands.size(); ++k)
+            cand_set->add(cands[k]);
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = 0;
+            for (LiveSet::iterator it = t->LiveOut->begin();
+                 it != t->LiveOut->end(); ++it)
+                if (!cand_set->contains(*it))
+                    ++n;
+            pressure = std::max(pressure, n);
+        }
+        int room = std::min((int)_pinRegs.size() - 3,
+                            (int)_pinRegs.size() - pressure - 2);
+
+        // the most referenced ones first
+        Vector<Temp> &pinned = _pinned[b->bb_num];
+        while ((int)pinned.size() < room) {
+            int best = -1;
+            for (size_t k = 0; k < cands.size(); ++k)
+                if (NULL != cands[k] &&
+                    (best < 0 || refs[cands[k]->id] > refs[cands[best]->id]))
+                    best = (int)k;
+            if (best < 0)
+                break;
+            pinned.push_back(cands[best]);
+            cands[best] = NULL;
+        }
+        for (size_t k = 0; k < cands.size(); ++k)
+            if (NULL != cands[k])
+                refs[cands[k]->id] = 0;
+        for (size_t k = 0; k < pinned.size(); ++k)
+            refs[pinned[k]->id] = 0;
+        if (pinned.empty())
+            continue;
+
+        // the preheader (split off the entering edge if there is none) and
+        // the blocks on the exit edges
+        int preheader = loop->preheader;
+        if (preheader < 0) {
+            preheader = g->splitEdge(entering, b->bb_num);
+            split = true;
+        }
+        _pinEnter.resize(g->size(), -1);
+        _pinEnter[preheader] = b->bb_num;
+        for (int k = 0; k < 2; ++k) {
+            int s = b->next[k];
+            if (s == b->bb_num || (1 == k && s == b->next[0]))
+                continue;
+            if (g->getBlock(s)->preds.size() > 1) {
+                s = g->splitEdge(b->bb_num, s);
+                split = true;
+            }
+            _pinLeave.resize(g->size(), -1);
+            _pinLeave[s] = b->bb_num;
+        }
+        num_values += (int)pinned.size();
+        ++num_loops;
+    }
+    _pinned.resize(g->size());
+
+    if (Option::showStats())
+        std::cerr << "loop registers: " << num_values << " values pinned in "
+                  << num_loops << " loops" << std::endl;
+    return split;
+}
+
+/* Records the registers in which some variables would like to live,
+ * for the register allocators: the value returned by the function is
+ * hinted to a0.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph
+ */
+void RiscvDesc::setRegHints(FlowGraph *g) {
+    _regHint.clear();
+    if (NULL != _ra)
+        _ra->clearHints();
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+        if (BasicBlock::BY_RETURN == (*it)->end_kind)
+            setRegHint((*it)->var, RiscvReg::A0);
+}
+
+/* Makes a variable prefer a register.
+ *
+ * PARAMETERS:
+ *   v     - the variable
+ *   reg   - number of the register
+ */
+void RiscvDesc::setRegHint(Temp v, int reg) {
+    if ((size_t)v->id >= _regHint.size())
+        _regHint.resize(v->id + 1, -1);
+    _regHint[v->id] = reg;
+
+    if (NULL != _ra)
+        _ra->setHint(v, reg);
+}
+
+/* Gets the register a variable prefers.
+ *
+ * RETURNS:
+ *   number of the register, or -1 if none
+ */
+int RiscvDesc::getRegHint(Temp v) {
+    if (NULL == v || (size_t)v->id >= _regHint.size())
+        return -1;
+
+    return _regHint[v->id];
+}
+
+/* Reserves the stack slots of the variables shared between basic blocks,
+ * so that the ones which are never alive at the same time share a slot.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (with the LiveOut set of every TAC)
+ * NOTE:
+ *   two variables conflict if one of them is defined where the other one
+ *   is alive (or both are alive at the entry). A variable only goes to
+ *   its slot, and comes back, while it is alive.
+ */
+void RiscvDesc::reserveSlots(FlowGraph *g) {
+    Vector<LiveSet *> conflicts;
+    Vector<Temp> order;
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        LiveSet *liveout = (*it)->LiveOut;
+        for (LiveSet::iterator sit = liveout->begin(); sit != liveout->end();
+             ++sit) {
+            Temp v = *sit;
+            int val;
+            if (v->is_offset_fixed || (NULL != _ra && _ra->getReg(v) >= 0) ||
+                getRematValue(v, val))
+                continue;
+            if ((size_t)v->id >= conflicts.size())
+                conflicts.resize(v->id + 1, NULL);
+            if (NULL == conflicts[v->id]) {
+                conflicts[v->id] = new LiveSet();
+                order.push_back(v);
+            }
+        }
+    }
+
+    LiveSet *entry = g->getBlock(0)->LiveIn;
+    for (LiveSet::iterator it = entry->begin(); it != entry->end(); ++it)
+        add_conflicts(conflicts, *it, entry);
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+        for (Tac *t = (*it)->tac_chain; t != NULL; t = t->next) {
+            Temp v = t->getDef();
+            if (NULL != v)
+                add_conflicts(conflicts, v, t->LiveOut);
+        }
+
+    for (size_t i = 0; i < order.size(); ++i)
+        _frame->reserve(order[i], conflicts[order[i]->id]);
+
+    if (Option::showStats())
+        std::cerr << "stack slots: " << order.size() << " shared variables in "
+                  << _frame->getStackFrameSize() / WORD_SIZE << " slots"
+                  << std::endl;
+}
+
 /* Translates a "Functy" object into assembly code and output.
  *
  * PARAMETERS:
@@ -424,20 +1032,63 @@ void RiscvDesc::emitFuncty(Functy f) {
     _frame = new RiscvStackFrameManager(-3 * WORD_SIZE);
     FlowGraph *g = FlowGraph::makeGraph(f);
     g->simplify();        // simple optimization
+    if (Option::doOptimize()) {
+        g->propagateConstants(); // folds constants and dead branches
+        if (Option::getUnrollFactor() > 1)
+            g->unrollLoops(Option::getUnrollFactor());
+        g->rotateLoops(); // tests the loops at the bottom
+        g->propagateConstants(); // (folds the guards of the rotated loops)
+        g->buildSSA();
+        g->hoistLoopInvariants(); // moves the invariants out of loops
+        g->reduceStrength();      // turns i * c into running additions
+        g->expandMulDiv();        // turns x * c, x / c into shifts and mulh
+        g->numberValues();        // removes the redundant computations
+        g->eliminatePartialRedundancies(); // ...and the partially redundant
+        g->eliminateDeadCode(); // removes the useless TACs and branches
+        g->destroySSA();
+        // the simplifier and the dead code elimination feed each other
+        do {
+            g->simplify(); // merges the blocks left behind
+        } while (g->eliminateDeadCode() > 0);
+    }
+    if (Option::doOptimize())
+        sinkCompares(g); // (so that they can be fused into the branches)
     g->analyzeLiveness(); // computes LiveOut set of the basic blocks
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+        (*it)->analyzeLiveness(); // computes LiveOut set of every TAC
+    _pinned.clear();
+    _pinEnter.clear();
+    _pinLeave.clear();
+    if (Option::doOptimize() && NULL == _ra && pinLoopValues(g))
+        analyze_all_liveness(g); // (some loop exits have been split)
+
+    setRegHints(g);
+    if (NULL != _ra) {
+        _ra->allocate(g);
+        // the spilled variables may get registers inside the loops
+        if (Option::doOptimize())
+            splitSpilledRanges(g);
+    }
 
+    // all variables shared between basic blocks should be reserved
+    // (unless they stay in a register across the whole function, or they
+    //  are constants which can be loaded again)
+    findRematerializable(g);
+    if (Option::doOptimize())
+        reserveSlots(g); // (the ones never alive together share a slot)
     for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
-        // all variables shared between basic blocks should be reserved
-        Set<Temp> *liveout = (*it)->LiveOut;
-        for (Set<Temp>::iterator sit = liveout->begin(); sit != liveout->end();
+        LiveSet *liveout = (*it)->LiveOut;
+        for (LiveSet::iterator sit = liveout->begin(); sit != liveout->end();
              ++sit) {
-            _frame->reserve(*sit);
+            int val;
+            if ((NULL == _ra || _ra->getReg(*sit) < 0) &&
+                !getRematValue(*sit, val))
+                _frame->reserve(*sit);
         }
         (*it)->entry_label = getNewLabel(); // adds entry label of a basic block
     }
     for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
         BasicBlock *b = *it;
-        b->analyzeLiveness(); // computes LiveOut set of every TAC
         _frame->reset();
         // translates the TAC sequences of this block
         b->instr_chain = prepareSingleChain(b, g);
@@ -465,8 +1116,22 @@ void RiscvDesc::emitFuncty(Functy f) {
     //   executed during the execution of the program. It can include
     //   conditional branches.''
     //           -- Modern Compiler Implementation in Java (the ``Tiger Book'')
-    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
-        emitTrace(*it, g);
+    Vector<int> order;
+    if (Option::doOptimize()) {
+        // the frequent edges fall through, and the loops which are only
+        // entered by branches start aligned
+        g->layoutBlocks(f->entry->str_form.c_str(), order);
+        mark_loop_tops(g, order);
+    } else {
+        for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+            trace_blocks(g, *it, order);
+        for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it)
+            (*it)->mark = 0;
+    }
+    for (size_t k = 0; k < order.size(); ++k)
+        emitTrace(g->getBlock(order[k]), k + 1 < order.size()
+                                             ? g->getBlock(order[k + 1])
+                                             : NULL);
 }
 
 /* Outputs the leading code of a function.
@@ -498,6 +1163,70 @@ void RiscvDesc::emitProlog(Label entry_label, int frame_size) {
     emit(EMPTY_STR, oss.str().c_str(), NULL);
 }
 
+/* How the operands of an instruction are printed.
+ */
+enum {
+    FMT_COMMENT, // (only the comment)
+    FMT_RRR,     // op r0, r1, r2
+    FMT_RRI,     // op r0, r1, i
+    FMT_RR,      // op r0, r1
+    FMT_RI,      // op r0, i
+    FMT_LOAD,    // op r0, i(r1)
+    FMT_STORE,   // op r0, i(r1)   (r0 is read)
+    FMT_BRANCH2, // op r0, r1, l
+    FMT_BRANCH1, // op r0, l
+    FMT_JUMP,    // op l
+    FMT_NONE     // op
+};
+
+/* The assembly form of every RiscvInstr::OpCode (in the same order).
+ */
+static const struct {
+    RiscvInstr::OpCode op; // (just for checking the order)
+    const char *name;      // the mnemonic
+    int fmt;               // how the operands are printed
+} riscv_opcodes[] = {
+    {RiscvInstr::COMMENT, NULL, FMT_COMMENT},
+    {RiscvInstr::ASSIGN, "mv", FMT_RR},
+    {RiscvInstr::ADD, "add", FMT_RRR},
+    {RiscvInstr::ADDI, "addi", FMT_RRI},
+    {RiscvInstr::MUL, "mul", FMT_RRR},
+    {RiscvInstr::SUB, "sub", FMT_RRR},
+    {RiscvInstr::DIV, "div", FMT_RRR},
+    {RiscvInstr::MOD, "rem", FMT_RRR},
+    {RiscvInstr::NEG, "neg", FMT_RR},
+    {RiscvInstr::J, "j", FMT_JUMP},
+    {RiscvInstr::BEQZ, "beqz", FMT_BRANCH1},
+    {RiscvInstr::BNEZ, "bnez", FMT_BRANCH1},
+    {RiscvInstr::BEQ, "beq", FMT_BRANCH2},
+    {RiscvInstr::BNE, "bne", FMT_BRANCH2},
+    {RiscvInstr::BLT, "blt", FMT_BRANCH2},
+    {RiscvInstr::BGE, "bge", FMT_BRANCH2},
+    {RiscvInstr::RET, "ret", FMT_NONE},
+    {RiscvInstr::LW, "lw", FMT_LOAD},
+    {RiscvInstr::LI, "li", FMT_RI},
+    {RiscvInstr::SW, "sw", FMT_STORE},
+    {RiscvInstr::MOVE, "mv", FMT_RR},
+    {RiscvInstr::NOT, "not", FMT_RR},
+    {RiscvInstr::SEQZ, "seqz", FMT_RR},
+    {RiscvInstr::SNEZ, "snez", FMT_RR},
+    {RiscvInstr::SLT, "slt", FMT_RRR},
+    {RiscvInstr::SLTI, "slti", FMT_RRI},
+    {RiscvInstr::AND, "and", FMT_RRR},
+    {RiscvInstr::OR, "or", FMT_RRR},
+    {RiscvInstr::XOR, "xor", FMT_RRR},
+    {RiscvInstr::XORI, "xori", FMT_RRI},
+    {RiscvInstr::SLL, "sll", FMT_RRR},
+    {RiscvInstr::SLLI, "slli", FMT_RRI},
+    {RiscvInstr::SRL, "srl", FMT_RRR},
+    {RiscvInstr::SRLI, "srli", FMT_RRI},
+    {RiscvInstr::SRA, "sra", FMT_RRR},
+    {RiscvInstr::SRAI, "srai", FMT_RRI},
+    {RiscvInstr::MULH, "mulh", FMT_RRR},
+    {RiscvInstr::CZERO_EQZ, "czero.eqz", FMT_RRR},
+    {RiscvInstr::CZERO_NEZ, "czero.nez", FMT_RRR},
+};
+
 /* Outputs a single instruction.
  *
  * PARAMETERS:
@@ -506,146 +1235,56 @@ void RiscvDesc::emitProlog(Label entry_label, int frame_size) {
 void RiscvDesc::emitInstr(RiscvInstr *i) {
     if (i->cancelled)
         return;
-    std::ostringstream oss;
-    oss << std::left << std::setw(6);
 
-    switch (i->op_code) {
-    case RiscvInstr::COMMENT:
+    mind_assert(sizeof(riscv_opcodes) / sizeof(riscv_opcodes[0]) ==
+                RiscvInstr::NUM_OPCODES);
+    mind_assert(riscv_opcodes[i->op_code].op == i->op_code);
+
+    if (FMT_COMMENT == riscv_opcodes[i->op_code].fmt) {
         emit(EMPTY_STR, NULL, i->comment);
         return;
+    }
 
-    case RiscvInstr::LI:
-        oss << "li" << i->r0->name << ", " << i->i;
-        break;
-
-    case RiscvInstr::NEG:
-        oss << "neg" << i->r0->name << ", " << i->r1->name;
-        break;
-
-    case RiscvInstr::NOT:
-        //oss << "xori" << i->r0->name << ", " << i->r1->name << ", " << -1;
-        oss << "and" << i->r0->name << ", " << i->r1->name << ", " << 1;
-        oss << std::endl;
-        oss << "add " << i->r0->name << ", " << i->r0->name << ", " << 1;
-        oss << std::endl;
-        oss << "and " << i->r0->name << ", " << i->r0->name << ", " << 1;
-        //oss << "NOT " << i->r0->name << ", " << i->r1->name;
-        break;
-
-    case RiscvInstr::BNOT:
-        //oss << "xori" << i->r0->name << ", " << i->r1->name << ", " << -1;
-        oss << "NOT" << i->r0->name << ", " << i->r1->name;
-        //oss << "li" << i->r0->name << ", " << 243;
-        break;
-    
-    case RiscvInstr::MOVE:
-        oss << "mv" << i->r0->name << ", " << i->r1->name;
-        break;
-
-    case RiscvInstr::LW:
-        oss << "lw" << i->r0->name << ", " << i->i << "(" << i->r1->name << ")";
-        break;
-
-    case RiscvInstr::SW:
-        oss << "sw" << i->r0->name << ", " << i->i << "(" << i->r1->name << ")";
-        break;
-    
-    case RiscvInstr::RET:
-        oss << "ret";
-        break;
-    
-    case RiscvInstr::ADD:
-        oss << "add" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
-    
-    case RiscvInstr::MUL:
-        oss << "mul" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
-
-    case RiscvInstr::SUB:
-        oss << "sub" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
-
-    case RiscvInstr::DIV:
-        oss << "div" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
-
-    case RiscvInstr::MOD:
-        oss << "rem" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
-
-    case RiscvInstr::LES:
-        oss << "slt" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        break;
+    std::ostringstream oss;
+    oss << std::left << std::setw(6) << riscv_opcodes[i->op_code].name;
+    if (std::strlen(riscv_opcodes[i->op_code].name) >= 6)
+        oss << " "; // (a long mnemonic like "czero.eqz")
 
-    case RiscvInstr::GTR:
-        oss << "slt" << i->r0->name << ", " << i->r2->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "bne " << i->r0->name<< ", "<<i->r0->name<<", "<<0;
+    switch (riscv_opcodes[i->op_code].fmt) {
+    case FMT_RRR:
+        oss << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
         break;
 
-    case RiscvInstr::LEQ:
-        oss << "slt" << i->r0->name << ", " << i->r2->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "seqz " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_RRI:
+        oss << i->r0->name << ", " << i->r1->name << ", " << i->i;
         break;
 
-    case RiscvInstr::GEQ:
-        oss << "slt" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        oss << std::endl;
-        oss << "seqz " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_RR:
+        oss << i->r0->name << ", " << i->r1->name;
         break;
 
-    case RiscvInstr::OR:
-        oss << "or" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        oss << std::endl;
-        oss << "snez " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_RI:
+        oss << i->r0->name << ", " << i->i;
         break;
 
-    case RiscvInstr::AND:
-        oss << "and" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        oss << std::endl;
-        oss << "snez " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_LOAD:
+    case FMT_STORE:
+        oss << i->r0->name << ", " << i->i << "(" << i->r1->name << ")";
         break;
 
-    case RiscvInstr::EQU:
-        oss << "slt" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        oss << std::endl;
-        oss << "slt " << i->r1->name << ", " << i->r2->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "seqz " << i->r0->name<< ", "<<i->r0->name;
-        oss << std::endl;
-        oss << "seqz " << i->r1->name<< ", "<<i->r1->name;
-        oss << std::endl;
-        oss << "and " << i->r0->name << ", " << i->r0->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "snez " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_BRANCH2:
+        oss << i->r0->name << ", " << i->r1->name << ", " << i->l;
         break;
 
-    case RiscvInstr::NEQ:
-        oss << "slt" << i->r0->name << ", " << i->r1->name << ", " << i->r2->name;
-        oss << std::endl;
-        oss << "slt " << i->r1->name << ", " << i->r2->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "seqz " << i->r0->name<< ", "<<i->r0->name;
-        oss << std::endl;
-        oss << "seqz " << i->r1->name<< ", "<<i->r1->name;
-        oss << std::endl;
-        oss << "and " << i->r0->name << ", " << i->r0->name << ", " << i->r1->name;
-        oss << std::endl;
-        oss << "seqz " << i->r0->name<< ", "<<i->r0->name;
+    case FMT_BRANCH1:
+        oss << i->r0->name << ", " << i->l;
         break;
 
-    case RiscvInstr::ASSIGN:
-        oss<<"mv"<<i->r0->name<<", "<<i->r1->name;
+    case FMT_JUMP:
+        oss << i->l;
         break;
 
-    case RiscvInstr::BEQZ:
-        oss << "beqz" << i->r0->name << ", " << i->l;
-        break;
-    
-    case RiscvInstr::J:
-        oss << "j" << i->l;
+    case FMT_NONE:
         break;
 
     default:
@@ -655,41 +1294,67 @@ void RiscvDesc::emitInstr(RiscvInstr *i) {
     emit(EMPTY_STR, oss.str().c_str(), i->comment);
 }
 
-/* Outputs a "trace" (see also: RiscvDesc::emitFuncty).
+/* Outputs a basic block of a trace (see also: RiscvDesc::emitFuncty).
  *
  * PARAMETERS:
- *   b     - the leading basic block of this trace
- *   g     - the control-flow graph
+ *   b        - the basic block
+ *   follower - the basic block emitted right after it (NULL if none)
  * NOTE:
- *   we just do a simple depth-first search against the CFG
+ *   under -O, the jump to the follower is removed (and the branch in
+ *   front of it is inverted, if that one goes to the follower). A marked
+ *   block is the top of a loop not fallen into, and gets aligned.
  */
-void RiscvDesc::emitTrace(BasicBlock *b, FlowGraph *g) {
-    // a trace is a series of consecutive basic blocks
-    if (b->mark > 0)
-        return;
-    b->mark = 1;
-    emit(std::string(b->entry_label), NULL, NULL);
+void RiscvDesc::emitTrace(BasicBlock *b, BasicBlock *follower) {
+    if (!Option::doOptimize()) {
+        emit(std::string(b->entry_label), NULL, NULL);
+    } else {
+        if (b->mark > 0)
+            emit(EMPTY_STR, ".p2align 4", NULL);
+        // the block numbers are the ones of the edge profile
+        std::ostringstream oss;
+        oss << "block " << b->bb_num;
+        emit(std::string(b->entry_label), NULL, oss.str().c_str());
+    }
+
+    if (Option::doOptimize() && NULL != follower) {
+        RiscvInstr *last = NULL, *branch = NULL;
+        for (RiscvInstr *i = (RiscvInstr *)b->instr_chain; i != NULL;
+             i = i->next)
+            if (!i->cancelled) {
+                branch = last;
+                last = i;
+            }
+
+        std::string target(follower->entry_label);
+        bool falls = false;
+        if (NULL != last && RiscvInstr::J == last->op_code) {
+            if (last->l == target) {
+                falls = true;
+                ++fall_through_jumps;
+            } else if (NULL != branch &&
+                       RiscvInstr::J != invert_branch(branch->op_code) &&
+                       branch->l == target) {
+                // "beqz x, follower; j other" => "bnez x, other"
+                branch->op_code = invert_branch(branch->op_code);
+                branch->l = last->l;
+                falls = true;
+                ++inverted_branches;
+            }
+        }
+
+        if (falls) {
+            last->cancelled = true;
+            // the follower may be entered only from here
+            if (1 == follower->preds.size())
+                peepholeAcross(b, follower);
+        }
+    }
 
     RiscvInstr *i = (RiscvInstr *)b->instr_chain;
     while (NULL != i) {
         emitInstr(i);
         i = i->next;
     }
-    switch (b->end_kind) {
-    case BasicBlock::BY_JUMP:
-        emitTrace(g->getBlock(b->next[0]), g);
-        break;
-
-    case BasicBlock::BY_JZERO:
-        emitTrace(g->getBlock(b->next[1]), g);
-        break;
-
-    case BasicBlock::BY_RETURN:
-        break;
-
-    default:
-        mind_assert(false); // unreachable
-    }
 }
 
 /* Appends an instruction line to "_tail". (internal helper function)
@@ -718,21 +1383,274 @@ void RiscvDesc::addInstr(RiscvInstr::OpCode op_code, RiscvReg *r0, RiscvReg *r1,
     _tail->r2 = r2;
     _tail->i = i;
     _tail->l = l;
-    _tail->comment = cmt;
+    // the comment is usually built in a temporary string: keeps a copy
+    _tail->comment = NULL;
+    if (NULL != cmt)
+        _tail->comment = strcpy(new char[strlen(cmt) + 1], cmt);
 }
 
 
 /******************** a simple peephole optimizer *********************/
 
+/* Gets the register written by an instruction.
+ *
+ * RETURNS:
+ *   the register, or NULL if the instruction writes none or has some
+ *   other effect (so that it could not be simply removed)
+ */
+static RiscvReg *instr_def(RiscvInstr *i) {
+    switch (riscv_opcodes[i->op_code].fmt) {
+    case FMT_RRR:
+    case FMT_RRI:
+    case FMT_RR:
+    case FMT_RI:
+    case FMT_LOAD:
+        return i->r0;
+
+    default:
+        return NULL;
+    }
+}
+
+/* Tests whether an instruction reads the given register.
+ *
+ * NOTE: control transfers are regarded as reading everything.
+ */
+static bool instr_reads(RiscvInstr *i, RiscvReg *r) {
+    switch (riscv_opcodes[i->op_code].fmt) {
+    case FMT_COMMENT:
+    case FMT_RI:
+        return false;
+
+    case FMT_RRR:
+        return i->r1 == r || i->r2 == r;
+
+    case FMT_RRI:
+    case FMT_RR:
+    case FMT_LOAD:
+        return i->r1 == r;
+
+    case FMT_STORE:
+        return i->r0 == r || i->r1 == r;
+
+    default:
+        return true;
+    }
+}
+
+static bool is_move(RiscvInstr *i) {
+    return RiscvInstr::MOVE == i->op_code || RiscvInstr::ASSIGN == i->op_code;
+}
+
+/* Tests whether an instruction between a memory access and a later load
+ * keeps the value of the slot in the register "a". (internal helper
+ * function)
+ *
+ * PARAMETERS:
+ *   i     - the instruction in between
+ *   a     - the register holding the value of the slot
+ *   m     - the first memory access (giving the slot, k(base))
+ * NOTE:
+ *   a store to another slot of the same base is harmless; a store through
+ *   another base register may alias the slot.
+ */
+static bool keeps_slot_value(RiscvInstr *i, RiscvReg *a, RiscvInstr *m) {
+    if (RiscvInstr::SW == i->op_code)
+        return i->r1 == m->r1 && i->i != m->i;
+
+    RiscvReg *d = instr_def(i);
+    return NULL != d && d != a && d != m->r1;
+}
+
+/* Turns the first load of the slot of w[0] in the window into a move from
+ * register "a". (internal helper function)
+ *
+ * PARAMETERS:
+ *   w     - the window (w[0] is the first memory access)
+ *   n     - the size of the window
+ *   a     - the register holding the value of the slot
+ * RETURNS:
+ *   whether such a load has been found before the value may change
+ */
+static bool forward_slot_value(RiscvInstr **w, int n, RiscvReg *a) {
+    for (int k = 1; k < n; ++k) {
+        if (RiscvInstr::LW == w[k]->op_code && w[0]->r1 == w[k]->r1 &&
+            w[0]->i == w[k]->i) {
+            w[k]->op_code = RiscvInstr::MOVE;
+            w[k]->r1 = a;
+            w[k]->comment = NULL;
+            return true;
+        }
+        if (!keeps_slot_value(w[k], a, w[0]))
+            return false;
+    }
+    return false;
+}
+
+/* sw a, k(fp); ...; lw b, k(fp)  =>  sw a, k(fp); ...; mv b, a
+ */
+static bool peephole_store_load(RiscvInstr **w, int n) {
+    if (RiscvInstr::SW != w[0]->op_code)
+        return false;
+
+    return forward_slot_value(w, n, w[0]->r0);
+}
+
+/* lw a, k(fp); ...; lw b, k(fp)  =>  lw a, k(fp); ...; mv b, a
+ */
+static bool peephole_load_load(RiscvInstr **w, int n) {
+    if (RiscvInstr::LW != w[0]->op_code || w[0]->r0 == w[0]->r1)
+        return false;
+
+    return forward_slot_value(w, n, w[0]->r0);
+}
+
+/* mv a, a  =>  (nothing)
+ */
+static bool peephole_self_move(RiscvInstr **w, int n) {
+    if (!is_move(w[0]) || w[0]->r0 != w[0]->r1)
+        return false;
+
+    w[0]->cancelled = true;
+    return true;
+}
+
+/* mv b, a; mv c, b  =>  mv b, a; mv c, a
+ */
+static bool peephole_move_chain(RiscvInstr **w, int n) {
+    if (!is_move(w[0]) || !is_move(w[1]) || w[1]->r1 != w[0]->r0 ||
+        w[0]->r0 == w[0]->r1)
+        return false;
+
+    w[1]->r1 = w[0]->r1;
+    return true;
+}
+
+/* x := ...; x := (something not reading x)  =>  x := ...
+ */
+static bool peephole_dead_write(RiscvInstr **w, int n) {
+    RiscvReg *r = instr_def(w[0]);
+    if (NULL == r || instr_def(w[1]) != r || instr_reads(w[1], r))
+        return false;
+
+    w[0]->cancelled = true;
+    return true;
+}
+
+/* The rules of the peephole optimizer.
+ *
+ * NOTE: every rule looks at a window of consecutive (alive) instructions
+ *       inside a basic block, and returns whether it has rewritten them.
+ *       The memory rules scan the whole window for a matching load.
+ *       The jumps to the following label are removed by emitTrace.
+ */
+static struct {
+    const char *name;              // name of the rule (for -s)
+    int window;                    // how many instructions it needs
+    bool (*apply)(RiscvInstr **, int); // the rewriting function
+    int hits;                      // how many times it has fired
+} peephole_rules[] = {
+    {"store-load", 2, peephole_store_load, 0},
+    {"load-load", 2, peephole_load_load, 0},
+    {"self-move", 1, peephole_self_move, 0},
+    {"move-chain", 2, peephole_move_chain, 0},
+    {"dead-write", 2, peephole_dead_write, 0},
+    {NULL, 0, NULL, 0}};
+
+// the longest window (scanned by the memory rules)
+#define PEEPHOLE_WINDOW 6
+
+/* Applies the peephole rules to a window.
+ *
+ * PARAMETERS:
+ *   w     - the window (of alive instructions)
+ *   n     - the size of the window
+ * RETURNS:
+ *   whether some rule has fired
+ */
+static bool apply_peephole_rules(RiscvInstr **w, int n) {
+    bool fired = false;
+
+    for (int r = 0; peephole_rules[r].name != NULL; ++r) {
+        if (n >= peephole_rules[r].window && peephole_rules[r].apply(w, n)) {
+            ++peephole_rules[r].hits;
+            fired = true;
+            if (w[0]->cancelled)
+                break;
+        }
+    }
+
+    return fired;
+}
+
 /* Performs a peephole optimization pass to the instruction sequence.
  *
  * PARAMETERS:
  *   iseq  - the instruction sequence to optimize
  */
 void RiscvDesc::simplePeephole(RiscvInstr *iseq) {
-    // if you are interested in peephole optimization, you can implement here
-    // of course, beyond our requirements
-    
+    RiscvInstr *w[PEEPHOLE_WINDOW];
+    bool changed;
+
+    do {
+        changed = false;
+        for (RiscvInstr *i = iseq; i != NULL; i = i->next) {
+            if (i->cancelled)
+                continue;
+
+            // fills the window with the following (alive) instructions
+            int n = 0;
+            for (RiscvInstr *j = i; j != NULL && n < PEEPHOLE_WINDOW;
+                 j = j->next)
+                if (!j->cancelled)
+                    w[n++] = j;
+
+            if (apply_peephole_rules(w, n))
+                changed = true;
+        }
+    } while (changed);
+}
+
+/* Applies the peephole rules across the boundary of two blocks, where
+ * the second one is only entered by falling through from the first one.
+ *
+ * PARAMETERS:
+ *   b     - the first block
+ *   c     - the second block (emitted right after b)
+ */
+void RiscvDesc::peepholeAcross(BasicBlock *b, BasicBlock *c) {
+    RiscvInstr *w[PEEPHOLE_WINDOW];
+    bool changed = false;
+
+    for (;;) {
+        w[0] = w[1] = NULL;
+        for (RiscvInstr *i = (RiscvInstr *)b->instr_chain; i != NULL;
+             i = i->next)
+            if (!i->cancelled)
+                w[0] = i;
+        for (RiscvInstr *i = (RiscvInstr *)c->instr_chain;
+             i != NULL && NULL == w[1]; i = i->next)
+            if (!i->cancelled)
+                w[1] = i;
+
+        if (NULL == w[0] || NULL == w[1] || !apply_peephole_rules(w, 2))
+            break;
+        changed = true;
+    }
+
+    if (changed)
+        simplePeephole((RiscvInstr *)c->instr_chain);
+}
+
+/* Prints how many rewrites each peephole rule has made (to stderr).
+ */
+void RiscvDesc::showPeepholeStats(void) {
+    std::cerr << "peephole:";
+    for (int r = 0; peephole_rules[r].name != NULL; ++r)
+        std::cerr << (r == 0 ? " " : ", ") << peephole_rules[r].name << " "
+                  << peephole_rules[r].hits;
+    std::cerr << ", fall-through " << fall_through_jumps << ", inverted "
+              << inverted_branches << std::endl;
 }
 
 /******************* REGISTER ALLOCATOR ***********************/
@@ -747,38 +1665,174 @@ void RiscvDesc::simplePeephole(RiscvInstr *iseq) {
  *   number of the register containing the content of v
  */
 int RiscvDesc::getRegForRead(Temp v, int avoid1, LiveSet *live) {
-    std::ostringstream oss;
+    // the variable may live in a register for the whole function
+    if (NULL != _ra && _ra->getReg(v) >= 0)
+        return _ra->getReg(v);
 
     int i = lookupReg(v);
 
     if (i < 0) {
         // we will load the content into some register
-        i = lookupReg(NULL);
+        i = lookupFreeReg(v);
 
         if (i < 0) {
             i = selectRegToSpill(avoid1, RiscvReg::ZERO, live);
             spillReg(i, live);
         }
 
-        _reg[i]->var = v;
+        loadReg(i, v);
+    }
 
-        if (v->is_offset_fixed) {
-            RiscvReg *base = _reg[RiscvReg::FP];
-            oss << "load " << v << " from (" << base->name
-                << (v->offset < 0 ? "" : "+") << v->offset << ") into "
-                << _reg[i]->name;
-            addInstr(RiscvInstr::LW, _reg[i], base, NULL, v->offset, EMPTY_STR,
-                     oss.str().c_str());
+    return i;
+}
 
-        } else {
-            oss << "initialize " << v << " with 0";
-            addInstr(RiscvInstr::MOVE, _reg[i], _reg[RiscvReg::ZERO], NULL, 0,
-                     EMPTY_STR, oss.str().c_str());
-        }
-        _reg[i]->dirty = false;
+/* Loads the value of a variable into a register.
+ *
+ * PARAMETERS:
+ *   i     - number of the register (which should be free)
+ *   v     - the variable
+ * NOTE:
+ *   the value comes from its stack slot, or from a "li" if it is a
+ *   rematerializable constant.
+ */
+void RiscvDesc::loadReg(int i, Temp v) {
+    std::ostringstream oss;
+    int val;
+
+    if (getRematValue(v, val)) {
+        oss << "rematerialize " << v;
+        addInstr(RiscvInstr::LI, _reg[i], NULL, NULL, val, EMPTY_STR,
+                 oss.str().c_str());
+        ++remat_loads;
+
+    } else if (v->is_offset_fixed) {
+        RiscvReg *base = _reg[RiscvReg::FP];
+        oss << "load " << v << " from (" << base->name
+            << (v->offset < 0 ? "" : "+") << v->offset << ") into "
+            << _reg[i]->name;
+        addInstr(RiscvInstr::LW, _reg[i], base, NULL, v->offset, EMPTY_STR,
+                 oss.str().c_str());
+        ++reloaded_regs;
+
+    } else {
+        oss << "initialize " << v << " with 0";
+        addInstr(RiscvInstr::MOVE, _reg[i], _reg[RiscvReg::ZERO], NULL, 0,
+                 EMPTY_STR, oss.str().c_str());
     }
+    _reg[i]->var = v;
+    _reg[i]->dirty = false;
+}
 
-    return i;
+/* Gets the single-block loop a block enters (or leaves), whose pinned
+ * values it loads (or takes over).
+ *
+ * PARAMETERS:
+ *   which - _pinEnter or _pinLeave
+ *   b     - the basic block
+ * RETURNS:
+ *   block number of the loop, or -1 if none
+ */
+int RiscvDesc::getPinnedLoop(Vector<int> &which, BasicBlock *b) {
+    if ((size_t)b->bb_num >= which.size())
+        return -1;
+
+    return which[b->bb_num];
+}
+
+/* Sets up the registers holding values at the entry of a block.
+ *
+ * PARAMETERS:
+ *   b     - the basic block
+ *   g     - the control-flow graph
+ * NOTE:
+ *   in a single-block loop, the pinned registers are never spilled; in
+ *   the block on an exit edge, the registers are taken over as they are.
+ *   A pinned value is "dirty" if the loop may have changed it.
+ */
+void RiscvDesc::takePinnedRegs(BasicBlock *b, FlowGraph *g) {
+    int h = getPinnedLoop(_pinLeave, b), val;
+    if (h < 0 && (size_t)b->bb_num < _pinned.size() &&
+        !_pinned[b->bb_num].empty())
+        h = b->bb_num;
+    if (h < 0)
+        return;
+
+    BasicBlock *loop = g->getBlock(h);
+    for (size_t k = 0; k < _pinned[h].size(); ++k) {
+        Temp v = _pinned[h][k];
+        RiscvReg *r = _reg[_pinRegs[k]];
+        if (h != b->bb_num && !b->LiveIn->contains(v))
+            continue;
+
+        r->var = v;
+        r->dirty = loop->Def->contains(v) && !getRematValue(v, val);
+        r->pinned = (h == b->bb_num);
+    }
+}
+
+/* Moves the values pinned in a loop into their registers, at the end of
+ * its preheader.
+ *
+ * PARAMETERS:
+ *   b     - the preheader
+ *   loop  - the loop (made of a single block)
+ * NOTE:
+ *   a value already in a register is moved from there (the registers
+ *   keep their contents after spillDirtyRegs), and it is not stored if
+ *   the loop changes it (the exits store it then). The moves read every
+ *   source before it is overwritten; a cycle of moves goes through a
+ *   pin register left over.
+ */
+void RiscvDesc::loadPinnedRegs(BasicBlock *b, BasicBlock *loop) {
+    Vector<Temp> &pinned = _pinned[loop->bb_num];
+    Vector<int> src;
+    Vector<bool> done;
+
+    for (size_t k = 0; k < pinned.size(); ++k) {
+        int i = lookupReg(pinned[k]);
+        src.push_back(i);
+        if (i >= 0 && loop->Def->contains(pinned[k]))
+            _reg[i]->dirty = false;
+    }
+    spillDirtyRegs(b->LiveOut);
+
+    done.resize(pinned.size(), false);
+    size_t left = pinned.size();
+    while (left > 0) {
+        bool moved = false;
+        for (size_t k = 0; k < pinned.size(); ++k) {
+            int d = _pinRegs[k];
+            bool busy = done[k];
+            for (size_t j = 0; j < pinned.size() && !busy; ++j)
+                busy = (!done[j] && j != k && src[j] == d);
+            if (busy)
+                continue;
+
+            if (src[k] < 0) {
+                loadReg(d, pinned[k]);
+            } else {
+                if (src[k] != d)
+                    addInstr(RiscvInstr::MOVE, _reg[d], _reg[src[k]], NULL, 0,
+                             EMPTY_STR, NULL);
+                _reg[d]->var = pinned[k];
+                _reg[d]->dirty = false;
+            }
+            done[k] = true;
+            moved = true;
+            --left;
+        }
+
+        if (!moved) {
+            // only cycles are left: breaks one of them
+            int spare = _pinRegs[pinned.size()];
+            size_t k = 0;
+            while (done[k])
+                ++k;
+            addInstr(RiscvInstr::MOVE, _reg[spare], _reg[src[k]], NULL, 0,
+                     EMPTY_STR, NULL);
+            src[k] = spare;
+        }
+    }
 }
 
 /* Acquires a register to write some variable.
@@ -795,10 +1849,13 @@ int RiscvDesc::getRegForWrite(Temp v, int avoid1, int avoid2, LiveSet *live) {
     if (NULL == v || !live->contains(v))
         return RiscvReg::ZERO;
 
+    if (NULL != _ra && _ra->getReg(v) >= 0)
+        return _ra->getReg(v);
+
     int i = lookupReg(v);
 
     if (i < 0) {
-        i = lookupReg(NULL);
+        i = lookupFreeReg(v);
 
         if (i < 0) {
             i = selectRegToSpill(avoid1, avoid2, live);
@@ -837,6 +1894,7 @@ void RiscvDesc::spillReg(int i, LiveSet *live) {
             << base->name << (v->offset < 0 ? "" : "+") << v->offset << ")";
         addInstr(RiscvInstr::SW, _reg[i], base, NULL, v->offset, EMPTY_STR,
                  oss.str().c_str());
+        ++spilled_regs;
     }
 
     _reg[i]->var = NULL;
@@ -847,11 +1905,15 @@ void RiscvDesc::spillReg(int i, LiveSet *live) {
  *
  * PARAMETERS:
  *   live  - the current liveness set
+ * NOTE:
+ *   the pinned registers keep their values (see pinLoopValues).
  */
 void RiscvDesc::spillDirtyRegs(LiveSet *live) {
     int i;
     // determines whether we should spill the registers
     for (i = 0; i < RiscvReg::TOTAL_NUM; ++i) {
+        if (_reg[i]->pinned)
+            continue;
         if ((NULL != _reg[i]->var) && _reg[i]->dirty &&
             live->contains(_reg[i]->var))
             break;
@@ -865,7 +1927,8 @@ void RiscvDesc::spillDirtyRegs(LiveSet *live) {
                  "(save modified registers before control flow changes)");
 
         for (; i < RiscvReg::TOTAL_NUM; ++i)
-            spillReg(i, live);
+            if (!_reg[i]->pinned)
+                spillReg(i, live);
     }
 }
 
@@ -884,6 +1947,119 @@ int RiscvDesc::lookupReg(tac::Temp v) {
     return -1;
 }
 
+/* Looks up a free register for a variable.
+ *
+ * PARAMETERS:
+ *   v     - the variable
+ * RETURNS:
+ *   number of the register (its hinted register if that one is free);
+ *   -1 if all the registers are occupied
+ */
+int RiscvDesc::lookupFreeReg(Temp v) {
+    int h = getRegHint(v);
+    if (h >= 0 && _reg[h]->general && NULL == _reg[h]->var)
+        return h;
+
+    return lookupReg(NULL);
+}
+
+/* Lets the destination of a copy take over the register of its source.
+ *
+ * PARAMETERS:
+ *   i     - number of the register holding the source
+ *   v     - the destination of the copy
+ *   live  - the liveness set after the copy
+ * RETURNS:
+ *   true if done (then no instruction is needed)
+ * NOTE:
+ *   the source should be dead after the copy, and neither of them may
+ *   be pinned to its register.
+ */
+bool RiscvDesc::takeOverReg(int i, Temp v, LiveSet *live) {
+    RiscvReg *r = _reg[i];
+    if (!r->general || r->pinned || NULL == r->var || live->contains(r->var))
+        return false;
+    if (NULL != _ra && _ra->getReg(v) >= 0)
+        return false;
+
+    int j = lookupReg(v);
+    if (j >= 0 && _reg[j]->pinned)
+        return false;
+    if (j >= 0) {
+        // the old value of v is overwritten anyway
+        _reg[j]->var = NULL;
+        _reg[j]->dirty = false;
+    }
+
+    r->var = v;
+    r->dirty = true;
+    return true;
+}
+
+/* Records the positions of the uses in a basic block (for nextUse).
+ *
+ * PARAMETERS:
+ *   b     - the basic block
+ * NOTE:
+ *   the TACs are numbered from 0, and the final branch or return comes
+ *   after all of them.
+ */
+void RiscvDesc::computeNextUses(BasicBlock *b) {
+    Temp uses[2];
+    int pos = 0;
+
+    for (size_t k = 0; k < _usedTemps.size(); ++k)
+        _usePos[_usedTemps[k]->id].clear();
+    _usedTemps.clear();
+
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next, ++pos) {
+        int n = t->getUses(uses);
+        for (int k = 0; k < n; ++k)
+            addUse(uses[k], pos);
+    }
+    if (BasicBlock::BY_JUMP != b->end_kind)
+        addUse(b->var, pos);
+}
+
+/* Records a use of a variable at some position of the current block.
+ */
+void RiscvDesc::addUse(Temp v, int pos) {
+    if (NULL == v)
+        return;
+
+    if ((size_t)v->id >= _usePos.size())
+        _usePos.resize(v->id + 1);
+    Vector<int> &p = _usePos[v->id];
+    if (p.empty())
+        _usedTemps.push_back(v);
+    if (p.empty() || p.back() != pos)
+        p.push_back(pos);
+}
+
+/* Gets how far the next use of a variable is.
+ *
+ * PARAMETERS:
+ *   v     - the variable
+ *   live  - the current liveness set
+ * RETURNS:
+ *   the number of TACs before the next use in the current block (counted
+ *   from the current one), FAR_AWAY if it is only used by the following
+ *   blocks, or INT_MAX if it is dead
+ */
+int RiscvDesc::nextUse(Temp v, LiveSet *live) {
+    if (NULL == v || !live->contains(v))
+        return INT_MAX;
+
+    if ((size_t)v->id < _usePos.size()) {
+        Vector<int> &p = _usePos[v->id];
+        Vector<int>::iterator it = std::lower_bound(p.begin(), p.end(), _curPos);
+        if (it != p.end())
+            return *it - _curPos;
+    }
+
+    return FAR_AWAY;
+}
+
 /* Selects a register to spill into memory (so that it can be released).
  *
  * PARAMETERS:
@@ -892,33 +2068,34 @@ int RiscvDesc::lookupReg(tac::Temp v) {
  *   live   - the current liveness set
  * RETURNS:
  *   number of the selected register
+ * NOTE:
+ *   a dead value is dropped first; otherwise the value used again the
+ *   latest is evicted (Belady's MIN), and a clean one (which needs no
+ *   "store") is preferred among the equally far ones.
  */
 int RiscvDesc::selectRegToSpill(int avoid1, int avoid2, LiveSet *live) {
-    // looks for a "ready" one
-    for (int i = 0; i < RiscvReg::TOTAL_NUM; ++i) {
-        if (!_reg[i]->general)
-            continue;
-
-        if ((i != avoid1) && (i != avoid2) && !live->contains(_reg[i]->var))
-            return i;
-    }
+    int best = -1, best_dist = -1;
 
-    // looks for a clean one (so that we could save a "store")
     for (int i = 0; i < RiscvReg::TOTAL_NUM; ++i) {
-        if (!_reg[i]->general)
+        if (!_reg[i]->general || _reg[i]->pinned || (i == avoid1) ||
+            (i == avoid2))
             continue;
 
-        if ((i != avoid1) && (i != avoid2) && !_reg[i]->dirty)
-            return i;
-    }
+        int d = nextUse(_reg[i]->var, live);
+        if (INT_MAX == d)
+            return i; // it is "ready"
 
-    // the worst case: all are live and all are dirty.
-    // chooses one register w.r.t a policy similar to the LRU algorithm (random
-    // choice)
-    do {
-        _lastUsedReg = (_lastUsedReg + 1) % RiscvReg::TOTAL_NUM;
-    } while ((_lastUsedReg == avoid1) || (_lastUsedReg == avoid2) ||
-             !_reg[_lastUsedReg]->general);
+        if (d > best_dist ||
+            (d == best_dist && _reg[best]->dirty && !_reg[i]->dirty)) {
+            best = i;
+            best_dist = d;
+        }
+    }
+    if (best >= 0)
+        return best;
 
-    return _lastUsedReg;
+    // only the avoided ones are left (it happens when the whole-function
+    // allocator keeps just two scratch registers). the sources are read
+    // before the destination is written, so "avoid1" can be reused.
+    return avoid1;
 }
@@ -6,7 +6,7 @@
 #ifndef __MIND_RISCVMD__
 #define __MIND_RISCVMD__
 
-#include "3rdparty/set.hpp"
+#include "3rdparty/bitset.hpp"
 #include "asm/mach_desc.hpp"
 #include "asm/riscv_frame_manager.hpp"
 #include "define.hpp"
@@ -15,7 +15,7 @@ namespace mind {
 #define RISCV_COMPONENTS_DEFINED
 namespace assembly {
 // for convinience
-typedef util::Set<tac::Temp> LiveSet;
+typedef util::BitSet<tac::Temp> LiveSet;
 
 /**
  * RISC-V register.
@@ -64,6 +64,8 @@ struct RiscvReg {
     tac::Temp var;    // associated variable
     bool dirty;       // whether it is out of sychronized with the memory
     bool general;     // whether it is a generl-purpose register
+    bool pinned;      // whether it keeps "var" through the block (see
+                      // RiscvDesc::pinLoopValues)
 
     // two constructors for convenience
     RiscvReg(const char *reg_name, bool is_general);
@@ -84,8 +86,11 @@ struct RiscvInstr : public Instr {
         // assembler directives
         COMMENT,
         // instructions/pseudo instructions
+        // (each one stands for a single machine instruction; see
+        //  riscv_opcodes in riscv_md.cpp for how they are printed)
         ASSIGN,
         ADD,
+        ADDI,
         MUL,
         SUB,
         DIV,
@@ -93,28 +98,41 @@ struct RiscvInstr : public Instr {
         NEG,
         J,
         BEQZ,
+        BNEZ,
+        BEQ,
+        BNE,
+        BLT,
+        BGE,
         RET,
         LW,
         LI,
         SW,
         MOVE,
         NOT,
-        BNOT,
-        LNOT,
-        LES,
-        LEQ,
-        GTR,
-        GEQ,
+        SEQZ,
+        SNEZ,
+        SLT,
+        SLTI,
         AND,
         OR,
-        EQU,
-        NEQ,
+        XOR,
+        XORI,
+        SLL,
+        SLLI,
+        SRL,
+        SRLI,
+        SRA,
+        SRAI,
+        MULH,
+        CZERO_EQZ,
+        CZERO_NEZ,
         // You could add other instructions/pseudo instructions here
+        NUM_OPCODES // (keep it the last one)
     } op_code; // operation code
 
     RiscvReg *r0, *r1, *r2; // 3 register operands
     int i;                  // offset or immediate number
-    std::string l;          // target label. for LA, B, BEQZ or JAL
+    std::string l;          // target label. for LA, B, BEQZ, BEQ, etc or JAL
     const char *comment;    // comment in this line
 
     RiscvInstr *next; // next instruction
@@ -153,15 +171,49 @@ class RiscvDesc : public MachineDesc {
     const char *getNewLabel(void);
     // translates the tac_chain of a basic block into the instr_chain
     RiscvInstr *prepareSingleChain(tac::BasicBlock *, tac::FlowGraph *);
+    // reserves the stack slots of the variables shared between blocks
+    void reserveSlots(tac::FlowGraph *);
+    // finds the temps which can be loaded again instead of being spilled
+    void findRematerializable(tac::FlowGraph *);
+    // records the registers preferred by some variables
+    void setRegHints(tac::FlowGraph *);
+    // makes a variable prefer a register
+    void setRegHint(tac::Temp, int);
+    // gets the register preferred by a variable (-1 if none)
+    int getRegHint(tac::Temp);
+    // splits the spilled live ranges around the innermost loops
+    void splitSpilledRanges(tac::FlowGraph *);
+    // chooses the values kept in registers through single-block loops
+    bool pinLoopValues(tac::FlowGraph *);
+    // gets the value of a rematerializable temp (false if it is not)
+    bool getRematValue(tac::Temp, int &);
+    // moves the comparisons feeding the final branches to the block ends
+    void sinkCompares(tac::FlowGraph *);
+    // finds the comparison which could be fused into the final branch
+    tac::Tac *findFusibleCompare(tac::BasicBlock *);
+    // translates a comparison and the final branch into one instruction
+    void emitFusedBranch(tac::Tac *, tac::BasicBlock *, tac::FlowGraph *);
 
+    /*** the instruction selector (see asm/riscv_isel.cpp) ***/
+    util::Vector<int> _constVal;        // known value of every temp (by id)
+    util::Vector<int> _constGen;        // when the value became known
+    util::Vector<tac::Tac *> _constDef; // the TAC giving the value
+    int _curGen;                        // current "generation" of values
+
+    // forgets all the known constants (at the beginning of a block)
+    void resetConsts(void);
+    // gets the constant held by a temp at the current point (if known)
+    bool getConst(tac::Temp, int &);
+    // gets the TAC giving the constant of a temp in the current block
+    tac::Tac *getConstDef(tac::Temp);
+    // records the value of the temp defined by a TAC
+    void updateConsts(tac::Tac *);
+    // selects the instruction patterns for the TACs of a basic block
+    void selectInstructions(tac::BasicBlock *, tac::Tac *);
+    // chooses the cheapest rule covering a TAC
+    int selectRule(tac::Tac *);
     // translates a TAC into assembly instructions
     void emitTac(tac::Tac *);
-    // translates a LoadImm4 TAC into assembly instructions
-    void emitLoadImm4Tac(tac::Tac *);
-    // translates a Unary TAC into assembly instructions
-    void emitUnaryTac(RiscvInstr::OpCode, tac::Tac *);
-    // translates a Binary TAC into assembly instructions
-    void emitBinaryTac(RiscvInstr::OpCode, tac::Tac *);
 
     // outputs an instruction
     void emit(std::string, const char *, const char *);
@@ -169,8 +221,8 @@ class RiscvDesc : public MachineDesc {
     void emitFuncty(tac::Functy);
     // prints the leading code of a function
     void emitProlog(tac::Label, int);
-    // prints the assembly code of a single trace
-    void emitTrace(tac::BasicBlock *, tac::FlowGraph *);
+    // prints the assembly code of a basic block (given the one after it)
+    void emitTrace(tac::BasicBlock *, tac::BasicBlock *);
     // prints a single RISC-V instruction
     void emitInstr(RiscvInstr *);
     // appends a new instruction to "_tail"
@@ -180,11 +232,26 @@ class RiscvDesc : public MachineDesc {
 
     /*** sketch for peephole optimizer (inside a basic block) ***/
     void simplePeephole(RiscvInstr *);
+    // performs peephole optimization between two consecutive blocks
+    void peepholeAcross(tac::BasicBlock *, tac::BasicBlock *);
+    // prints how many rewrites each peephole rule has made
+    void showPeepholeStats(void);
 
 
     /*** the register allocator ***/
     RiscvReg *_reg[RiscvReg::TOTAL_NUM]; // registers of a machine
-    int _lastUsedReg;                    // which register was used last?
+    util::Vector<util::Vector<int> > _usePos; // positions of the uses (by id)
+    util::Vector<tac::Temp> _usedTemps; // the temps used in the block
+    int _curPos; // position of the current TAC in the block
+    util::Vector<int> _rematState; // whether a temp is rematerializable
+    util::Vector<int> _rematVal;   // the value it is loaded with
+    RegAllocator *_ra; // whole-function allocator (NULL: block-local only)
+    util::Vector<int> _regHint; // the preferred register of a temp (by id)
+    util::Vector<int> _pinRegs; // the registers which can be pinned
+    util::Vector<util::Vector<tac::Temp> > _pinned; // the values pinned in
+                                                    // a loop (by block)
+    util::Vector<int> _pinEnter; // the loop a preheader enters (or -1)
+    util::Vector<int> _pinLeave; // the loop an exit block leaves (or -1)
 
     // acquires a register to read the value of a variable
     int getRegForRead(tac::Temp, int, LiveSet *);
@@ -196,6 +263,24 @@ class RiscvDesc : public MachineDesc {
     void spillDirtyRegs(LiveSet *);
     // looks up a register holding the specified variable
     int lookupReg(tac::Temp);
+    // looks up a free register (the hinted one if possible)
+    int lookupFreeReg(tac::Temp);
+    // lets the destination of a copy take over the source register
+    bool takeOverReg(int, tac::Temp, LiveSet *);
+    // loads the value of a variable into a register
+    void loadReg(int, tac::Temp);
+    // gets the loop a block enters (or leaves) whose values are pinned
+    int getPinnedLoop(util::Vector<int> &, tac::BasicBlock *);
+    // sets up the registers pinned (or taken over) at the block entry
+    void takePinnedRegs(tac::BasicBlock *, tac::FlowGraph *);
+    // moves the values pinned in a loop into their registers (preheader)
+    void loadPinnedRegs(tac::BasicBlock *, tac::BasicBlock *);
+    // records the positions of the uses in a basic block
+    void computeNextUses(tac::BasicBlock *);
+    // records a use of a variable in the current block
+    void addUse(tac::Temp, int);
+    // gets how far the next use of a variable is (from the current TAC)
+    int nextUse(tac::Temp, LiveSet *);
     // selects a register to spill into memory
     int selectRegToSpill(int, int, LiveSet *);
 
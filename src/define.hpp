@@ -134,6 +134,7 @@ class TransHelper;
 namespace tac {
 struct BasicBlock;
 class FlowGraph;
+struct Loop;
 } // namespace tac
 #endif
 
@@ -150,6 +151,14 @@ class OffsetCounter;
 }
 #endif
 
+#ifndef MIND_REGALLOC_DEFINED
+namespace assembly {
+class RegAllocator;
+class LinearScanAllocator;
+class GraphColorAllocator;
+} // namespace assembly
+#endif
+
 #ifndef RISCV_COMPONENTS_DEFINED
 namespace assembly {
 struct RiscvReg;
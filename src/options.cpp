@@ -10,6 +10,7 @@
 #include "options.hpp"
 #include "config.hpp"
 
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 
@@ -30,6 +31,21 @@ const char *Option::output = NULL;
 // Whether to do extra optimization
 bool Option::optimize = false;
 
+// Whether to print optimization statistics
+bool Option::stats = false;
+
+// The register allocator
+Option::ra_t Option::regalloc = LOCAL_RA;
+
+// How many times the counted loops are unrolled
+int Option::unroll = 4;
+
+// The edge profile guiding the block layout
+const char *Option::profile = NULL;
+
+// Whether the conditional-zero instructions (Zicond) are available
+bool Option::zicond = false;
+
 /* Gets the current developing level.
  *
  * RETURNS:
@@ -51,6 +67,47 @@ Option::opt_t Option::getArch(void) { return arch; }
  */
 bool Option::doOptimize(void) { return optimize; }
 
+/* Gets whether optimization statistics will be printed.
+ *
+ * RETURNS:
+ *   whether the passes should report their statistics (to stderr)
+ */
+bool Option::showStats(void) { return stats; }
+
+/* Gets the register allocator.
+ *
+ * RETURNS:
+ *   LOCAL_RA (allocates registers block by block, the default),
+ *   LINEAR_SCAN_RA or GRAPH_COLOR_RA (allocates registers for the whole
+ *   function)
+ * NOTE:
+ *   -O1 and -O2 choose an allocator unless -r is given.
+ */
+Option::ra_t Option::getRegAlloc(void) { return regalloc; }
+
+/* Gets the loop unrolling factor.
+ *
+ * RETURNS:
+ *   how many copies of the body an iteration of an unrolled loop runs
+ *   (1 means that no loop is unrolled)
+ */
+int Option::getUnrollFactor(void) { return unroll; }
+
+/* Gets the edge-profile file name.
+ *
+ * RETURNS:
+ *   the file holding the edge counts for the block layout
+ *   (NULL if the static heuristics should be used)
+ */
+const char *Option::getProfile(void) { return profile; }
+
+/* Gets whether the Zicond extension may be used.
+ *
+ * RETURNS:
+ *   whether the target has czero.eqz and czero.nez
+ */
+bool Option::useZicond(void) { return zicond; }
+
 /* Gets the input file name.
  *
  * RETURNS:
@@ -71,7 +128,10 @@ const char *Option::getOutput(void) { return output; }
 static void showUsage(void) {
     std::cout
         << std::endl
-        << "Usage: mdc [-l LEVEL] [-m ARCH] [-o OUTPUT] [-O] SOURCE"
+        << "Usage: mdc [-l LEVEL] [-m ARCH] [-o OUTPUT] [-O|-O1|-O2] "
+           "[-r ALLOC] [-u FACTOR]"
+        << std::endl
+        << "           [-p PROFILE] [-z] [-s] SOURCE"
         << std::endl
         << "Options:" << std::endl
         << "  -l  Specifying the developing level, where LEVEL is one of:"
@@ -87,6 +147,31 @@ static void showUsage(void) {
         << "  -o  Specifying the name of the output file (DEFAULT: stdout)."
         << std::endl
         << "  -O  Turn on compiler optimization (DEFAULT: off)." << std::endl
+        << "  -O1 Like -O, but allocates registers for the whole function"
+        << std::endl
+        << "      with a linear-scan allocator." << std::endl
+        << "  -O2 Like -O1, but uses a graph-coloring allocator which"
+        << std::endl
+        << "      also coalesces copies (slower to compile)." << std::endl
+        << "  -r  Specifying the register allocator, where ALLOC is one of:"
+        << std::endl
+        << "      local (block by block. DEFAULT), linear (linear scan, as"
+        << std::endl
+        << "      with -O1), color (graph coloring, as with -O2)"
+        << std::endl
+        << "  -u  Under -O, unroll the counted loops FACTOR times "
+           "(DEFAULT: 4;"
+        << std::endl
+        << "      1 turns it off)." << std::endl
+        << "  -p  Under -O, lay out the blocks by the edge counts in PROFILE,"
+        << std::endl
+        << "      whose lines are \"FUNCTION FROM TO COUNT\" (FROM and TO are"
+        << std::endl
+        << "      the block numbers in the label comments)." << std::endl
+        << "  -z  The target has the Zicond extension (czero.eqz/czero.nez)."
+        << std::endl
+        << "  -s  Print optimization statistics to stderr (DEFAULT: off)."
+        << std::endl
         << "" << std::endl;
 }
 
@@ -99,6 +184,8 @@ void Option::parse(int argc, char **argv) {
     int i = 1;
     const char *str[] = {"?", "1",    "2",     "3",   "4",
                          "5", "mips", "riscv", "x86", "ppc"};
+    const char *ra_str[] = {"local", "linear", "color"};
+    bool ra_given = false;
 
     while (i < argc) {
         if (strcmp(argv[i], "-l") == 0) {
@@ -142,6 +229,52 @@ void Option::parse(int argc, char **argv) {
         } else if (strcmp(argv[i], "-O") == 0) {
             optimize = true;
 
+        } else if (strcmp(argv[i], "-O1") == 0) {
+            optimize = true;
+            if (!ra_given)
+                regalloc = LINEAR_SCAN_RA;
+
+        } else if (strcmp(argv[i], "-O2") == 0) {
+            optimize = true;
+            if (!ra_given)
+                regalloc = GRAPH_COLOR_RA;
+
+        } else if (strcmp(argv[i], "-r") == 0) {
+            if (i + 1 >= argc)
+                goto bad_option;
+            else if (ra_given)
+                goto dup_option;
+
+            ++i;
+            for (int j = LOCAL_RA; j <= GRAPH_COLOR_RA && !ra_given; ++j)
+                if (strcmp(argv[i], ra_str[j]) == 0) {
+                    regalloc = (Option::ra_t)j;
+                    ra_given = true;
+                }
+
+            if (!ra_given)
+                goto bad_option;
+
+        } else if (strcmp(argv[i], "-u") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) < 1)
+                goto bad_option;
+
+            ++i;
+            unroll = atoi(argv[i]);
+
+        } else if (strcmp(argv[i], "-p") == 0) {
+            if (i + 1 >= argc)
+                goto bad_option;
+
+            ++i;
+            profile = argv[i];
+
+        } else if (strcmp(argv[i], "-z") == 0) {
+            zicond = true;
+
+        } else if (strcmp(argv[i], "-s") == 0) {
+            stats = true;
+
         } else if (argv[i][0] == '-') {
             std::cerr << "Unknown option: '" << argv[0] << "'" << std::endl;
             showUsage();
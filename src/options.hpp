@@ -30,9 +30,21 @@ class Option {
         PPC
     } opt_t;
 
+    /* Register allocators */
+    typedef enum {
+        LOCAL_RA,       // block-local register allocation
+        LINEAR_SCAN_RA, // whole-function linear-scan register allocation
+        GRAPH_COLOR_RA  // whole-function graph-coloring register allocation
+    } ra_t;
+
     static opt_t getLevel(void);  // Gets the current developing level
     static opt_t getArch(void);   // Gets the target architecture
     static bool doOptimize(void); // Gets whether optimization will be done
+    static bool showStats(void);  // Gets whether statistics will be printed
+    static ra_t getRegAlloc(void); // Gets the register allocator
+    static int getUnrollFactor(void); // Gets the loop unrolling factor
+    static const char *getProfile(void); // Gets the edge-profile file name
+    static bool useZicond(void); // Gets whether Zicond may be used
     static const char *getInput(void);
     static const char *getOutput(void);
     static void parse(int argc, char **argv); // Parses the command line
@@ -41,6 +53,11 @@ class Option {
     static opt_t level;        // Current developing level
     static opt_t arch;         // Target architecture
     static bool optimize;      // Whether optimization will be done
+    static bool stats;         // Whether statistics will be printed
+    static ra_t regalloc;      // Register allocator
+    static int unroll;         // Loop unrolling factor
+    static const char *profile; // Edge-profile file name (NULL: none)
+    static bool zicond;        // Whether the target has Zicond
     static const char *input;  // Input file name
     static const char *output; // Output file name
 
@@ -3,7 +3,7 @@
  *
  *  This file contains the implementation of the following 3 functions:
  *  1. BasicBlock::computeDefAndLiveUse
- *  2. FlowGraph::analyzeLiveness
+ *  2. FlowGraph::analyzeLiveness (a worklist solver)
  *  3. BasicBlock::analysisLiveness
  * 
  *  Of course, if you add some new Tacs, 
@@ -12,6 +12,7 @@
  */
 
 #include "config.hpp"
+#include "options.hpp"
 #include "tac/flow_graph.hpp"
 #include "tac/tac.hpp"
 
@@ -39,6 +40,8 @@ void BasicBlock::updateDEF(Temp v) {
  * HINT: this subroutine is quite simple, so please don't go into extreme.
  */
 void BasicBlock::computeDefAndLiveUse(void) {
+    Def->clear();
+    LiveUse->clear();
 
     for (Tac *t = tac_chain; t != NULL; t = t->next) {
         switch (t->op_code) {
@@ -56,6 +59,10 @@ void BasicBlock::computeDefAndLiveUse(void) {
         case Tac::MUL:
         case Tac::DIV:
         case Tac::MOD:
+        case Tac::SHL:
+        case Tac::SHR:
+        case Tac::SAR:
+        case Tac::MULH:
         case Tac::EQU:
         case Tac::NEQ:
         case Tac::LES:
@@ -64,6 +71,8 @@ void BasicBlock::computeDefAndLiveUse(void) {
         case Tac::GEQ:
         case Tac::LAND:
         case Tac::LOR:
+        case Tac::SEL_NZ:
+        case Tac::SEL_Z:
             updateLU(t->op1.var);
             updateLU(t->op2.var);
             updateDEF(t->op0.var);
@@ -101,40 +110,61 @@ void BasicBlock::computeDefAndLiveUse(void) {
 }
 
 /* Computes the LiveIn set and LiveOut set of every basic block.
+ *
+ * NOTE:
+ *   we use a worklist solver. The blocks are visited in the reverse
+ *   postorder of the CFG walked backwards (so that the successors of a
+ *   block are usually visited before it), and after the first sweep only
+ *   the predecessors of the blocks whose LiveIn changed are visited again.
+ *   The number of sweeps is then bounded by the loop nesting depth
+ *   (plus 2), instead of by the length of the longest acyclic path.
  *
  * HINT: please make sure that you understand this algorithm (and how it is
  * performed), or you might regret in your final exam...
  */
 void FlowGraph::analyzeLiveness(void) {
-    bool changed = false;
-    BasicBlock *b1 = NULL, *b2 = NULL, *b = NULL;
-    Set<Temp> *newin = NULL;
+    BasicBlock *b = NULL;
+    BitSet<Temp> *newin = new BitSet<Temp>(), *tmp = NULL;
+    Vector<int> order;   // reverse postorder of the blocks
+    Vector<bool> queued; // whether a block is on the worklist
+    int pending = _n;    // how many blocks are on the worklist
+    int sweeps = 0, visits = 0;
 
     // Step 1. computes Def and LiveUse
     for (int i = 0; i < _n; ++i) {
-        getBlock(i)->computeDefAndLiveUse();
+        b = getBlock(i);
+        b->computeDefAndLiveUse();
+        b->LiveIn->clear();
+        b->LiveOut->clear();
     }
 
-    // Step 2. iterates
+    computePredecessors();
+    computeReversePostorder(order);
+    queued.resize(_n, true);
+
+    // Step 2. iterates (the sets are updated in place, so that no set
+    //         is allocated inside the loop)
+    while (pending > 0) {
+        ++sweeps;
 
-    changed = true;
-    while (changed) {
-        changed = false;
+        for (int k = _n - 1; k >= 0; --k) {
+            if (!queued[order[k]])
+                continue;
 
-        for (reverse_iterator rit = rbegin(); rit != rend(); ++rit) {
-            b = *rit;
+            b = getBlock(order[k]);
+            queued[b->bb_num] = false;
+            --pending;
+            ++visits;
 
             // updates LiveOut
             switch (b->end_kind) {
             case BasicBlock::BY_JUMP:
-                b1 = getBlock(b->next[0]);
-                b->LiveOut = b1->LiveIn;
+                b->LiveOut->assign(getBlock(b->next[0])->LiveIn);
                 break;
 
             case BasicBlock::BY_JZERO:
-                b1 = getBlock(b->next[0]);
-                b2 = getBlock(b->next[1]);
-                b->LiveOut = b1->LiveIn->unionWith(b2->LiveIn);
+                b->LiveOut->assign(getBlock(b->next[0])->LiveIn);
+                b->LiveOut->addAll(getBlock(b->next[1])->LiveIn);
                 break;
 
             case BasicBlock::BY_RETURN:
@@ -145,13 +175,28 @@ void FlowGraph::analyzeLiveness(void) {
             }
 
             // updates LiveIn
-            newin = b->LiveOut->differenceFrom(b->Def)->unionWith(b->LiveUse);
+            newin->assign(b->LiveOut);
+            newin->removeAll(b->Def);
+            newin->addAll(b->LiveUse);
             if (!newin->equal(b->LiveIn)) {
-                changed = true;
+                tmp = b->LiveIn;
                 b->LiveIn = newin;
+                newin = tmp;
+
+                // the predecessors have to be visited (again)
+                for (size_t j = 0; j < b->preds.size(); ++j) {
+                    if (!queued[b->preds[j]]) {
+                        queued[b->preds[j]] = true;
+                        ++pending;
+                    }
+                }
             }
         }
     }
+
+    if (Option::showStats())
+        std::cerr << "liveness: " << _n << " blocks, " << sweeps
+                  << " sweeps, " << visits << " visits" << std::endl;
 }
 
 /* Computes the LiveOut set of every contained TAC.
@@ -205,6 +250,10 @@ void BasicBlock::analyzeLiveness(void) {
         case Tac::MUL:
         case Tac::DIV:
         case Tac::MOD:
+        case Tac::SHL:
+        case Tac::SHR:
+        case Tac::SAR:
+        case Tac::MULH:
         case Tac::EQU:
         case Tac::NEQ:
         case Tac::LES:
@@ -213,6 +262,8 @@ void BasicBlock::analyzeLiveness(void) {
         case Tac::GEQ:
         case Tac::LAND:
         case Tac::LOR:
+        case Tac::SEL_NZ:
+        case Tac::SEL_Z:
             if (NULL != t_next->op0.var)
                 t->LiveOut->remove(t_next->op0.var);
             t->LiveOut->add(t_next->op1.var);
@@ -0,0 +1,478 @@
+/*****************************************************
+ *  Aggressive Dead Code Elimination.
+ *
+ *  This file contains the implementation of FlowGraph::eliminateDeadCode.
+ *
+ *  Nothing is assumed to be useful at first. A TAC becomes useful when
+ *  it has a side effect, when the value returned by the function needs
+ *  it, or when a useful TAC uses what it defines. A branch becomes
+ *  useful when a useful block (one holding a useful TAC or branch) is
+ *  control dependent on it, i.e. is in its reverse dominance frontier.
+ *  Everything else is swept away: the TACs are removed, and a useless
+ *  branch jumps straight to its nearest useful postdominator, so that
+ *  a dead chain such as "t1 = a * b; t2 = t1 + 1" disappears together
+ *  with the branches computing nothing but it.
+ *
+ *  The empty blocks left behind are then bypassed, which may turn more
+ *  branches into jumps, so the whole process is repeated until nothing
+ *  changes. (FlowGraph::simplify cannot do that part, as it does not
+ *  keep the PHIs.) Once out of SSA form, the pass alternates with
+ *  FlowGraph::simplify until neither of them changes anything, since
+ *  a merged block or a folded branch may make more code dead.
+ *
+ *  Reference: R. Cytron et al. Efficiently Computing Static Single
+ *             Assignment Form and the Control Dependence Graph.
+ *             ACM TOPLAS 13(4), 1991. Section 7.1.
+ *             K. D. Cooper and L. Torczon. Engineering a Compiler
+ *             (2nd Edition). Section 10.2.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* State of the dead code elimination.
+ */
+struct Sweep {
+    FlowGraph *g;
+    int exit;                      // the virtual exit node (= the size)
+    Vector<Vector<Tac *> > defs;   // the definitions of every temp
+    Vector<Tac *> worklist;        // the useful TACs not processed yet
+    Vector<bool> useful;           // whether a block is useful
+    Vector<bool> branch;           // whether the branch of a block is useful
+    Vector<int> ipdom;             // the immediate postdominators
+    Vector<Vector<int> > rdf;      // the reverse dominance frontiers
+};
+
+/* Gets the successors of a block.
+ *
+ * RETURNS:
+ *   the number of successors
+ */
+static int successors(BasicBlock *b, int succ[2]) {
+    switch (b->end_kind) {
+    case BasicBlock::BY_JZERO:
+        succ[0] = b->next[0];
+        succ[1] = b->next[1];
+        return (succ[0] == succ[1]) ? 1 : 2;
+
+    case BasicBlock::BY_JUMP:
+        succ[0] = b->next[0];
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* Computes the postdominator tree and the reverse dominance frontiers.
+ *
+ * NOTE: the RETURN blocks go to a virtual exit node, which is the root
+ *       of the tree. The predecessors should have been computed.
+ * RETURNS:
+ *   false if some block cannot reach the exit (an infinite loop)
+ */
+static bool compute_postdominators(Sweep &s) {
+    FlowGraph *g = s.g;
+    int n = s.exit, succ[2];
+
+    // a postorder of the reverse graph, from the exit
+    Vector<int> post, num, stack, edge;
+    num.resize(n + 1, -1);
+    Vector<bool> visited;
+    visited.resize(n + 1, false);
+    visited[n] = true;
+    stack.push_back(n);
+    edge.push_back(0);
+    while (!stack.empty()) {
+        int x = stack.back();
+        int k = edge.back()++;
+        int y = -1;
+
+        if (x == n) {
+            // the exit goes back to the RETURN blocks
+            while (k < n && BasicBlock::BY_RETURN != g->getBlock(k)->end_kind)
+                ++k;
+            edge.back() = k + 1;
+            if (k < n)
+                y = k;
+        } else if (k < (int)g->getBlock(x)->preds.size()) {
+            y = g->getBlock(x)->preds[k];
+        }
+
+        if (y < 0) {
+            num[x] = post.size();
+            post.push_back(x);
+            stack.pop_back();
+            edge.pop_back();
+        } else if (!visited[y]) {
+            visited[y] = true;
+            stack.push_back(y);
+            edge.push_back(0);
+        }
+    }
+    if ((int)post.size() != n + 1)
+        return false;
+
+    // the immediate postdominators (Cooper, Harvey and Kennedy)
+    s.ipdom.assign(n + 1, -1);
+    s.ipdom[n] = n;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int k = n - 1; k >= 0; --k) {
+            int x = post[k];
+            BasicBlock *b = g->getBlock(x);
+            int m = successors(b, succ);
+            int p = -1;
+            if (0 == m)
+                p = n;
+            for (int j = 0; j < m; ++j) {
+                int y = succ[j];
+                if (s.ipdom[y] < 0)
+                    continue;
+                if (p < 0) {
+                    p = y;
+                    continue;
+                }
+                while (p != y) {
+                    while (num[p] < num[y])
+                        p = s.ipdom[p];
+                    while (num[y] < num[p])
+                        y = s.ipdom[y];
+                }
+            }
+            if (s.ipdom[x] != p) {
+                s.ipdom[x] = p;
+                changed = true;
+            }
+        }
+    }
+
+    // the reverse dominance frontiers (the branches every block is
+    // control dependent on)
+    s.rdf.assign(n, Vector<int>());
+    for (int x = 0; x < n; ++x) {
+        if (successors(g->getBlock(x), succ) < 2)
+            continue;
+        for (int j = 0; j < 2; ++j) {
+            for (int r = succ[j]; r != s.ipdom[x]; r = s.ipdom[r]) {
+                Vector<int> &f = s.rdf[r];
+                if (f.empty() || f.back() != x)
+                    f.push_back(x);
+            }
+        }
+    }
+
+    return true;
+}
+
+static void mark_branch(Sweep &s, int b);
+
+/* Marks a TAC useful.
+ */
+static void mark_tac(Sweep &s, Tac *t) {
+    if (0 != t->mark)
+        return;
+
+    t->mark = 1;
+    s.worklist.push_back(t);
+}
+
+/* Marks the definitions of a temporary useful.
+ */
+static void mark_defs(Sweep &s, Temp v) {
+    if (NULL == v || (size_t)v->id >= s.defs.size())
+        return; // (the value from the entry of the function)
+
+    Vector<Tac *> &d = s.defs[v->id];
+    for (size_t k = 0; k < d.size(); ++k)
+        mark_tac(s, d[k]);
+}
+
+/* Marks a block useful, together with the branches it depends on.
+ */
+static void mark_block(Sweep &s, int b) {
+    if (s.useful[b])
+        return;
+
+    s.useful[b] = true;
+    for (size_t k = 0; k < s.rdf[b].size(); ++k)
+        mark_branch(s, s.rdf[b][k]);
+}
+
+/* Marks the branch ending a block useful.
+ */
+static void mark_branch(Sweep &s, int b) {
+    if (s.branch[b])
+        return;
+
+    s.branch[b] = true;
+    mark_block(s, b);
+    mark_defs(s, s.g->getBlock(b)->var);
+}
+
+/* Tests whether a TAC has a side effect.
+ */
+static bool is_critical(Tac *t) {
+    switch (t->op_code) {
+    case Tac::PUSH:
+    case Tac::POP:
+    case Tac::MEMO:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/* Removes a TAC from its block.
+ */
+static void unlink(BasicBlock *b, Tac *t) {
+    if (NULL == t->prev)
+        b->tac_chain = t->next;
+    else
+        t->prev->next = t->next;
+    if (NULL != t->next)
+        t->next->prev = t->prev;
+}
+
+/* Tests whether a block begins with a PHI.
+ */
+static bool has_phi(BasicBlock *b) {
+    return NULL != b->tac_chain && Tac::PHI == b->tac_chain->op_code;
+}
+
+/* Marks the useful TACs and branches, and sweeps the others.
+ *
+ * PARAMETERS:
+ *   s        - the state of the dead code elimination
+ *   removed  - incremented by the number of TACs removed
+ * RETURNS:
+ *   number of branches removed
+ */
+static int mark_and_sweep(Sweep &s, int &removed) {
+    FlowGraph *g = s.g;
+    int n = (int)g->size();
+    Temp uses[2];
+
+    s.exit = n;
+    s.defs.clear();
+    s.useful.assign(n, false);
+    s.branch.assign(n, false);
+    for (int i = 0; i < n; ++i) {
+        for (Tac *t = g->getBlock(i)->tac_chain; t != NULL; t = t->next) {
+            t->bb_num = i;
+            t->mark = 0;
+            Temp v = t->getDef();
+            if (NULL == v)
+                continue;
+            if ((size_t)v->id >= s.defs.size())
+                s.defs.resize(v->id + 1);
+            s.defs[v->id].push_back(t);
+        }
+    }
+
+    // without postdominators, every branch stays
+    bool aggressive = compute_postdominators(s);
+    if (!aggressive)
+        s.rdf.assign(n, Vector<int>());
+
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = g->getBlock(i);
+        if (BasicBlock::BY_RETURN == b->end_kind) {
+            mark_block(s, i);
+            mark_defs(s, b->var);
+        } else if (BasicBlock::BY_JZERO == b->end_kind && !aggressive) {
+            mark_branch(s, i);
+        }
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next)
+            if (is_critical(t))
+                mark_tac(s, t);
+    }
+
+    while (!s.worklist.empty()) {
+        Tac *t = s.worklist.back();
+        s.worklist.pop_back();
+        mark_block(s, t->bb_num);
+
+        if (Tac::PHI == t->op_code) {
+            // the branches choosing the argument are useful as well
+            BasicBlock *b = g->getBlock(t->bb_num);
+            for (size_t k = 0; k < b->preds.size(); ++k) {
+                mark_defs(s, (*t->phi_args)[k]);
+                mark_block(s, b->preds[k]);
+                if (BasicBlock::BY_JZERO == g->getBlock(b->preds[k])->end_kind)
+                    mark_branch(s, b->preds[k]);
+            }
+            continue;
+        }
+
+        int k = t->getUses(uses);
+        for (int j = 0; j < k; ++j)
+            mark_defs(s, uses[j]);
+    }
+
+    // sweeps the useless TACs
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = g->getBlock(i);
+        Tac *next = NULL;
+        for (Tac *t = b->tac_chain; t != NULL; t = next) {
+            next = t->next;
+            if (0 == t->mark) {
+                unlink(b, t);
+                ++removed;
+            }
+        }
+    }
+
+    // ...and the useless branches
+    int folded = 0;
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = g->getBlock(i);
+        if (BasicBlock::BY_JZERO != b->end_kind || s.branch[i])
+            continue;
+
+        int x = s.ipdom[i];
+        while (!s.useful[x])
+            x = s.ipdom[x]; // (the RETURN blocks are all useful)
+        mind_assert(x != n && !has_phi(g->getBlock(x)));
+
+        b->end_kind = BasicBlock::BY_JUMP;
+        b->next[0] = b->next[1] = x;
+        ++folded;
+    }
+
+    return folded;
+}
+
+/* Cancels the blocks unreachable from the entry.
+ */
+static void cancel_unreachable(FlowGraph *g) {
+    int n = (int)g->size(), succ[2];
+    Vector<int> stack;
+
+    for (int i = 0; i < n; ++i)
+        g->getBlock(i)->cancelled = true;
+    g->getBlock(0)->cancelled = false;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        int m = successors(g->getBlock(stack.back()), succ);
+        stack.pop_back();
+        for (int j = 0; j < m; ++j) {
+            BasicBlock *b = g->getBlock(succ[j]);
+            if (b->cancelled) {
+                b->cancelled = false;
+                stack.push_back(succ[j]);
+            }
+        }
+    }
+}
+
+/* Bypasses the empty blocks.
+ *
+ * NOTE: an empty block in front of some PHIs is bypassed only if it
+ *       has a single predecessor, which takes its place.
+ * RETURNS:
+ *   number of blocks removed
+ */
+static int remove_empty_blocks(FlowGraph *g) {
+    int n = (int)g->size(), removed = 0;
+
+    for (int i = 1; i < n; ++i) {
+        BasicBlock *e = g->getBlock(i);
+        if (BasicBlock::BY_JUMP != e->end_kind || NULL != e->tac_chain ||
+            e->next[0] == i)
+            continue;
+
+        BasicBlock *s = g->getBlock(e->next[0]);
+
+        bool phi = has_phi(s);
+        if (phi) {
+            if (1 != e->preds.size())
+                continue;
+            bool already = false;
+            for (size_t k = 0; k < s->preds.size(); ++k)
+                if (s->preds[k] == e->preds[0])
+                    already = true;
+            if (already)
+                continue;
+        }
+
+        // s takes over the predecessors of e
+        size_t at = 0;
+        while (s->preds[at] != i)
+            ++at;
+        if (phi) {
+            s->preds[at] = e->preds[0];
+        } else {
+            s->preds.erase(s->preds.begin() + at);
+            for (size_t k = 0; k < e->preds.size(); ++k) {
+                bool found = false;
+                for (size_t j = 0; j < s->preds.size(); ++j)
+                    if (s->preds[j] == e->preds[k])
+                        found = true;
+                if (!found)
+                    s->preds.push_back(e->preds[k]);
+            }
+        }
+
+        for (size_t k = 0; k < e->preds.size(); ++k) {
+            BasicBlock *p = g->getBlock(e->preds[k]);
+            for (int j = 0; j < 2; ++j)
+                if (p->next[j] == i)
+                    p->next[j] = s->bb_num;
+            if (BasicBlock::BY_JZERO == p->end_kind && p->next[0] == p->next[1])
+                p->end_kind = BasicBlock::BY_JUMP;
+        }
+        e->preds.clear();
+        e->cancelled = true;
+        ++removed;
+    }
+
+    return removed;
+}
+
+/* Removes the useless TACs and branches, and the empty blocks.
+ *
+ * RETURNS:
+ *   number of TACs, branches and blocks removed
+ * NOTE: the TACs are usually in SSA form. Out of it, a temporary used
+ *       keeps all its definitions, so some dead ones may stay.
+ */
+int FlowGraph::eliminateDeadCode(void) {
+    Sweep s;
+    int removed = 0, folded = 0, bypassed = 0, changed = 0;
+
+    s.g = this;
+    do {
+        cancel_unreachable(this);
+        removeCancelledBlocks();
+        computePredecessors();
+
+        changed = mark_and_sweep(s, removed);
+        folded += changed;
+
+        cancel_unreachable(this);
+        removeCancelledBlocks();
+        computePredecessors();
+        int k = remove_empty_blocks(this);
+        bypassed += k;
+        changed += k;
+        removeCancelledBlocks();
+    } while (changed > 0);
+
+    if (Option::showStats())
+        std::cerr << "dce: " << removed << " TACs removed, " << folded
+                  << " branches removed, " << bypassed
+                  << " empty blocks removed" << std::endl;
+
+    return removed + folded + bypassed;
+}
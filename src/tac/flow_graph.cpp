@@ -7,17 +7,12 @@
 #include "3rdparty/map.hpp"
 #include "config.hpp"
 #include "tac/tac.hpp"
-#include <unordered_map>
+#include <algorithm>
 
 using namespace mind;
 using namespace mind::tac;
 using namespace mind::util;
 
-// temp variable comparator
-struct temp_less {
-    bool operator()(Temp t1, Temp t2) { return (t1->id < t2->id); }
-};
-
 /* Auxilliary function for printing variable sets.
  *
  * PARAMETERS:
@@ -25,18 +20,18 @@ struct temp_less {
  *   s     - the variable set
  * RETURNS:
  *   the output stream
+ * NOTE:
+ *   a BitSet is iterated in ascending id order, so no sorting is needed
  */
-std::ostream &mind::operator<<(std::ostream &os, Set<Temp> *s) {
+std::ostream &mind::operator<<(std::ostream &os, BitSet<Temp> *s) {
     os << "[";
 
-    if (NULL != s && !s->empty()) {
-        size_t sz = s->size();
-        Temp *buf = new Temp[sz];
-        std::copy(s->begin(), s->end(), buf);
-        std::sort(buf, buf + sz, temp_less());
-        os << buf[0];
-        for (size_t i = 1; i < sz; ++i)
-            os << " " << buf[i];
+    if (NULL != s) {
+        const char *sep = "";
+        for (BitSet<Temp>::iterator it = s->begin(); it != s->end(); ++it) {
+            os << sep << *it;
+            sep = " ";
+        }
     }
     os << "]";
 
@@ -55,12 +50,16 @@ BasicBlock::BasicBlock(void) {
     end_kind = BY_JUMP;
     var = NULL;
     next[0] = next[1] = -1;
+    loop_depth = 0;
+    loop = -1;
+    idom = -1;
+    dom_pre = dom_post = -1;
     cancelled = false;
 
-    Def = new Set<Temp>();     // empty set
-    LiveUse = new Set<Temp>(); // empty set
-    LiveIn = new Set<Temp>();  // empty set
-    LiveOut = new Set<Temp>(); // empty set
+    Def = new BitSet<Temp>();     // empty set
+    LiveUse = new BitSet<Temp>(); // empty set
+    LiveIn = new BitSet<Temp>();  // empty set
+    LiveOut = new BitSet<Temp>(); // empty set
 }
 
 /* Prints the basic block.
@@ -272,85 +271,370 @@ FlowGraph *FlowGraph::makeGraph(Functy f) {
     g->_n = markBasicBlocks(f->code);
     g->_bbs.resize(g->_n);
 
+    // new temporaries (see newTemp) must not clash with the old ones
+    Temp vars[3];
+    g->_tempCount = 0;
+    for (Tac *t = f->code; t != NULL; t = t->next) {
+        int n = t->getUses(vars);
+        if (NULL != t->getDef())
+            vars[n++] = t->getDef();
+        for (int i = 0; i < n; ++i)
+            if (NULL != vars[i] && vars[i]->id >= g->_tempCount)
+                g->_tempCount = vars[i]->id + 1;
+    }
+
     gatherBasicBlocks(f->code, g->_bbs);
 
     return g;
 }
 
-/* Simplifies (optimizes) a control-flow graph.
+/* Creates a new temporary variable for this function.
  *
- * NOTE:
- *   the optimizations include:
- *   1. eliminates empty END-BY-JUMP blocks
- *   2. reduces END-BY-JZERO blocks into END-BY-JUMP blocks
- *   3. eliminates all unreachable blocks
- *   the above steps are performed only once.
+ * RETURNS:
+ *   a 4-byte temporary whose id is used nowhere else in the function
  */
-void FlowGraph::simplify(void) {
-    BasicBlock *b = NULL;
-    BasicBlock *trace = NULL;
+Temp FlowGraph::newTemp(void) {
+    Temp v = new TempObject();
+    v->id = _tempCount++;
+    v->size = 4;
+    v->offset = 0;
+    v->is_offset_fixed = false;
+
+    return v;
+}
 
-    // computes in degrees
-    _bbs[0]->in_degree = 1; // entrance has an in degree of at least 1
+// the most TACs a block may have to be copied by jump threading
+#define THREAD_MAX_TACS 4
 
-    for (int i = 0; i < _n; ++i) {
-        switch (_bbs[i]->end_kind) {
-        case BasicBlock::BY_JZERO:
-            ++_bbs[_bbs[i]->next[1]]->in_degree;
-            // falls through
+/* Counts the edges into every block, and cancels the blocks which are
+ * unreachable from the entry.
+ *
+ * RETURNS:
+ *   true if some block was cancelled
+ */
+static bool count_edges(Vector<BasicBlock *> &bbs, int n) {
+    Vector<int> stack;
+    bool cancelled = false;
 
-        case BasicBlock::BY_JUMP:
-            ++_bbs[_bbs[i]->next[0]]->in_degree;
-            break;
+    for (int i = 0; i < n; ++i) {
+        bbs[i]->in_degree = 0;
+        bbs[i]->mark = 0;
+    }
+    bbs[0]->mark = 1;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        BasicBlock *b = bbs[stack.back()];
+        stack.pop_back();
+        if (BasicBlock::BY_RETURN == b->end_kind)
+            continue;
 
-        default:
-            break;
+        int m = (BasicBlock::BY_JZERO == b->end_kind) ? 2 : 1;
+        for (int k = 0; k < m; ++k) {
+            BasicBlock *s = bbs[b->next[k]];
+            ++s->in_degree;
+            if (0 == s->mark) {
+                s->mark = 1;
+                stack.push_back(s->bb_num);
+            }
         }
     }
 
-    // cancels all unreachable blocks and all empty END-BY-JUMP blocks
-    for (int i = 0; i < _n; ++i) {
-        b = _bbs[i];
-        if (b->in_degree <= 0 ||
-            (b->end_kind == BasicBlock::BY_JUMP && NULL == b->tac_chain)) {
-            b->cancelled = true;
+    for (int i = 0; i < n; ++i) {
+        if (0 == bbs[i]->mark && !bbs[i]->cancelled) {
+            bbs[i]->cancelled = true;
+            cancelled = true;
         }
+        bbs[i]->mark = 0;
     }
 
-    // tries to optimize all traces
-    for (int i = 0; i < _n; ++i) {
-        b = _bbs[i];
+    return cancelled;
+}
 
-        if (b->cancelled || b->end_kind == BasicBlock::BY_RETURN)
+/* Redirects an edge.
+ *
+ * PARAMETERS:
+ *   bbs   - the basic blocks
+ *   b     - the source of the edge
+ *   k     - which successor (0 or 1) of an END-BY-JZERO block
+ *   to    - the new target
+ */
+static void redirect(Vector<BasicBlock *> &bbs, BasicBlock *b, int k, int to) {
+    if (BasicBlock::BY_JUMP == b->end_kind) {
+        --bbs[b->next[0]]->in_degree;
+        b->next[0] = b->next[1] = to;
+    } else {
+        --bbs[b->next[k]]->in_degree;
+        b->next[k] = to;
+    }
+    ++bbs[to]->in_degree;
+}
+
+/* Gets the last TAC of a block defining a temporary.
+ *
+ * RETURNS:
+ *   the definition, or NULL if there is none in the block
+ */
+static Tac *last_def(BasicBlock *b, Temp v) {
+    Tac *d = NULL;
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next)
+        if (t->getDef() == v)
+            d = t;
+
+    return d;
+}
+
+/* Turns the END-BY-JZERO blocks with a known condition into jumps.
+ *
+ * RETURNS:
+ *   true if some branch was folded
+ */
+static bool fold_branches(Vector<BasicBlock *> &bbs, int n) {
+    bool changed = false;
+
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = bbs[i];
+        if (b->cancelled || BasicBlock::BY_JZERO != b->end_kind)
+            continue;
+
+        int k = -1;
+        Tac *d = last_def(b, b->var);
+        if (b->next[0] == b->next[1])
+            k = 0;
+        else if (NULL != d && Tac::LOAD_IMM4 == d->op_code)
+            k = (0 != d->op1.ival) ? 1 : 0;
+        if (k < 0)
             continue;
 
-        // forwards all the empty jumps
-        trace = _bbs[b->next[0]];
-        while (trace->cancelled)
-            trace = _bbs[trace->next[0]]; // "trace" must be a BY_JUMP block
-                                          // (why? :-)
-        b->next[0] = trace->bb_num;
-
-        if (b->end_kind == BasicBlock::BY_JZERO) {
-            trace = _bbs[b->next[1]];
-            while (trace->cancelled)
-                trace = _bbs[trace->next[0]];
-            b->next[1] = trace->bb_num;
-
-            if (b->next[0] == b->next[1]) {
-                b->end_kind =
-                    BasicBlock::BY_JUMP; // reduce END-BY-JZERO into END-BY-JUMP
+        --bbs[b->next[1 - k]]->in_degree;
+        b->end_kind = BasicBlock::BY_JUMP;
+        b->next[1 - k] = b->next[k];
+        changed = true;
+    }
+
+    return changed;
+}
+
+/* Gets whether a temporary is zero at the end of an edge.
+ *
+ * PARAMETERS:
+ *   b     - the source of the edge
+ *   k     - which successor (0 or 1) of an END-BY-JZERO block
+ *   v     - the temporary
+ * RETURNS:
+ *   0 if it is zero, 1 if it is not, -1 if unknown
+ */
+static int known_on_edge(BasicBlock *b, int k, Temp v) {
+    if (BasicBlock::BY_JZERO == b->end_kind && b->var == v)
+        return k;
+
+    Tac *d = last_def(b, v);
+    if (NULL != d && Tac::LOAD_IMM4 == d->op_code)
+        return (0 != d->op1.ival) ? 1 : 0;
+
+    return -1;
+}
+
+/* Threads the edges into an END-BY-JZERO block whose condition is
+ * known on the edge straight to the successor it leads to (through a
+ * copy of the block, unless it is empty or entered by this edge alone).
+ *
+ * PARAMETERS:
+ *   bbs    - the basic blocks
+ *   n      - the number of blocks (the copies are appended)
+ *   budget - how many more blocks may be copied
+ * RETURNS:
+ *   true if some edge was threaded
+ */
+static bool thread_jumps(Vector<BasicBlock *> &bbs, int &n, int &budget) {
+    bool changed = false;
+    int size = n;
+
+    for (int i = 0; i < size; ++i) {
+        BasicBlock *b = bbs[i];
+        if (b->cancelled || BasicBlock::BY_RETURN == b->end_kind)
+            continue;
+
+        int m = (BasicBlock::BY_JZERO == b->end_kind) ? 2 : 1;
+        for (int k = 0; k < m; ++k) {
+            BasicBlock *s = bbs[b->next[k]];
+            if (s == b || 0 == s->bb_num ||
+                BasicBlock::BY_JZERO != s->end_kind ||
+                s->next[0] == s->next[1] || NULL != last_def(s, s->var))
+                continue;
+
+            int v = known_on_edge(b, k, s->var);
+            if (v < 0 || s->next[v] == s->bb_num)
+                continue;
+
+            int len = 0;
+            for (Tac *t = s->tac_chain; t != NULL; t = t->next)
+                ++len;
+
+            if (1 == s->in_degree) {
+                // s becomes a jump
+                --bbs[s->next[1 - v]]->in_degree;
+                s->end_kind = BasicBlock::BY_JUMP;
+                s->next[1 - v] = s->next[v];
+            } else if (0 == len) {
+                redirect(bbs, b, k, s->next[v]);
+            } else if (len <= THREAD_MAX_TACS && budget > 0) {
+                // b goes to a copy of s, which jumps
+                BasicBlock *c = new BasicBlock();
+                c->bb_num = n++;
+                c->end_kind = BasicBlock::BY_JUMP;
+                c->next[0] = c->next[1] = s->next[v];
+                c->loop_depth = s->loop_depth;
+                c->loop = s->loop;
+                bbs.push_back(c);
+                ++bbs[s->next[v]]->in_degree;
+
+                Tac *last = NULL;
+                for (Tac *t = s->tac_chain; t != NULL; t = t->next) {
+                    Tac *x = new Tac(*t);
+                    x->bb_num = c->bb_num;
+                    x->LiveOut = NULL;
+                    x->prev = last;
+                    x->next = NULL;
+                    if (NULL == last)
+                        c->tac_chain = x;
+                    else
+                        last->next = x;
+                    last = x;
+                }
+                redirect(bbs, b, k, c->bb_num);
+                --budget;
+            } else {
+                continue;
+            }
+            changed = true;
+            break; // (b may have changed its kind)
+        }
+    }
+
+    return changed;
+}
+
+/* Forwards the edges into the empty END-BY-JUMP blocks to the blocks
+ * they jump to.
+ *
+ * RETURNS:
+ *   true if some edge was forwarded
+ */
+static bool forward_jumps(Vector<BasicBlock *> &bbs, int n) {
+    bool changed = false;
+
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = bbs[i];
+        if (b->cancelled || BasicBlock::BY_RETURN == b->end_kind)
+            continue;
+
+        int m = (BasicBlock::BY_JZERO == b->end_kind) ? 2 : 1;
+        for (int k = 0; k < m; ++k) {
+            // (at most n steps, in case of an empty infinite loop)
+            int to = b->next[k], steps = 0;
+            while (0 != to && BasicBlock::BY_JUMP == bbs[to]->end_kind &&
+                   NULL == bbs[to]->tac_chain && bbs[to]->next[0] != to &&
+                   steps++ < n)
+                to = bbs[to]->next[0];
+
+            if (to != b->next[k]) {
+                redirect(bbs, b, k, to);
+                changed = true;
             }
-        } else
-            b->next[1] = b->next[0];
+        }
+    }
+
+    return changed;
+}
+
+/* Merges every END-BY-JUMP block with the block it jumps to, if it is
+ * the only way into that block.
+ *
+ * RETURNS:
+ *   true if some blocks were merged
+ */
+static bool merge_blocks(Vector<BasicBlock *> &bbs, int n) {
+    bool changed = false;
+
+    for (int i = 0; i < n; ++i) {
+        BasicBlock *b = bbs[i];
+        if (b->cancelled)
+            continue;
+
+        while (BasicBlock::BY_JUMP == b->end_kind) {
+            BasicBlock *s = bbs[b->next[0]];
+            if (s == b || 0 == s->bb_num || 1 != s->in_degree)
+                break;
+
+            // appends s to b
+            Tac *last = b->tac_chain;
+            while (NULL != last && NULL != last->next)
+                last = last->next;
+            for (Tac *t = s->tac_chain; t != NULL; t = t->next)
+                t->bb_num = b->bb_num;
+            if (NULL == last)
+                b->tac_chain = s->tac_chain;
+            else if (NULL != s->tac_chain) {
+                last->next = s->tac_chain;
+                s->tac_chain->prev = last;
+            }
+
+            b->end_kind = s->end_kind;
+            b->var = s->var;
+            b->next[0] = s->next[0];
+            b->next[1] = s->next[1];
+            s->tac_chain = NULL;
+            s->in_degree = 0;
+            s->cancelled = true;
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+/* Simplifies (optimizes) a control-flow graph.
+ *
+ * NOTE:
+ *   the optimizations include:
+ *   1. eliminates all unreachable blocks
+ *   2. reduces END-BY-JZERO blocks with a known condition (or a single
+ *      successor) into END-BY-JUMP blocks
+ *   3. threads the jumps into END-BY-JZERO blocks whose condition is
+ *      known on the way in
+ *   4. eliminates empty END-BY-JUMP blocks
+ *   5. merges a block into its only predecessor, if that jumps to it
+ *   the above steps are repeated until nothing changes. The TACs should
+ *   not be in SSA form.
+ */
+void FlowGraph::simplify(void) {
+    bool changed = true;
+    int budget = _n; // (the copies made by jump threading)
+
+    for (int i = 0; i < _n; ++i)
+        _bbs[i]->cancelled = false;
+
+    while (changed) {
+        changed = count_edges(_bbs, _n);
+        changed = fold_branches(_bbs, _n) || changed;
+        changed = thread_jumps(_bbs, _n, budget) || changed;
+        changed = forward_jumps(_bbs, _n) || changed;
+        changed = merge_blocks(_bbs, _n) || changed;
     }
 
-    // this is a demo, so we don't do the above steps iteratively
+    removeCancelledBlocks();
+}
 
-    // shrinks the flow graph (and adjusts the block numbers)
-    std::unordered_map<int, int> new_num; // old bb_num -> new bb_num
-    int sz = 0;                           // new size
+/* Removes the cancelled blocks (and adjusts the block numbers).
+ *
+ * NOTE: the remaining blocks must not refer to the cancelled ones.
+ */
+void FlowGraph::removeCancelledBlocks(void) {
+    // shrinks the flow graph
+    Vector<int> new_num; // old bb_num -> new bb_num (-1: cancelled)
+    int sz = 0;          // new size
 
+    new_num.resize(_n, -1);
     for (int i = 0; i < _n; ++i) {
         if (!_bbs[i]->cancelled) {
             new_num[i] = sz;
@@ -370,9 +654,246 @@ void FlowGraph::simplify(void) {
             _bbs[i]->next[0] = new_num[_bbs[i]->next[0]];
             _bbs[i]->next[1] = new_num[_bbs[i]->next[1]];
         }
+
+        // the PHI arguments keep following the surviving predecessors
+        Vector<int> &preds = _bbs[i]->preds;
+        Tac *phis = _bbs[i]->tac_chain;
+        size_t k = 0;
+        for (size_t j = 0; j < preds.size(); ++j) {
+            if (preds[j] >= (int)new_num.size() || new_num[preds[j]] < 0)
+                continue;
+            for (Tac *t = phis; t != NULL && Tac::PHI == t->op_code;
+                 t = t->next)
+                (*t->phi_args)[k] = (*t->phi_args)[j];
+            preds[k++] = new_num[preds[j]];
+        }
+        preds.resize(k);
+        for (Tac *t = phis; t != NULL && Tac::PHI == t->op_code; t = t->next)
+            t->phi_args->resize(k);
     }
 }
 
+/* Computes the predecessor list of every basic block.
+ *
+ * NOTE:
+ *   a BY_JZERO block whose two successors are the same block is
+ *   recorded only once in that block's list. the predecessors are
+ *   listed in the order of the block numbers, and the arguments of
+ *   the PHIs are reordered accordingly (the set of predecessors of a
+ *   block with PHIs should not have changed).
+ */
+void FlowGraph::computePredecessors(void) {
+    Vector<Vector<int> > old_preds;
+    old_preds.resize(_n);
+    for (int i = 0; i < _n; ++i) {
+        old_preds[i] = _bbs[i]->preds;
+        _bbs[i]->preds.clear();
+    }
+
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+
+        switch (b->end_kind) {
+        case BasicBlock::BY_JZERO:
+            if (b->next[1] != b->next[0])
+                _bbs[b->next[1]]->preds.push_back(i);
+            // falls through
+
+        case BasicBlock::BY_JUMP:
+            _bbs[b->next[0]]->preds.push_back(i);
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    // the PHI arguments follow the new order of the predecessors
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        if (NULL == b->tac_chain || Tac::PHI != b->tac_chain->op_code ||
+            b->preds == old_preds[i])
+            continue;
+
+        Vector<int> &old = old_preds[i];
+        mind_assert(old.size() == b->preds.size());
+        for (Tac *t = b->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next) {
+            Vector<Temp> args;
+            for (size_t k = 0; k < b->preds.size(); ++k) {
+                size_t j = 0;
+                while (j < old.size() && old[j] != b->preds[k])
+                    ++j;
+                mind_assert(j < old.size());
+                args.push_back((*t->phi_args)[j]);
+            }
+            *t->phi_args = args;
+        }
+    }
+}
+
+/* Computes a reverse postorder of the basic blocks.
+ *
+ * PARAMETERS:
+ *   order - receives the block numbers
+ * NOTE:
+ *   the depth-first search starts from the entry block (block 0);
+ *   blocks unreachable from the entry are appended at the end, so
+ *   that every block appears in the order exactly once.
+ */
+void FlowGraph::computeReversePostorder(Vector<int> &order) {
+    Vector<int> post;      // postorder
+    Vector<int> stack;     // DFS stack of block numbers
+    Vector<int> edge;      // next successor to visit, per stack entry
+    Vector<bool> visited;
+
+    order.clear();
+    visited.resize(_n, false);
+
+    for (int root = 0; root < _n; ++root) {
+        if (visited[root])
+            continue;
+
+        // the entry goes first; the others are the unreachable leftovers
+        visited[root] = true;
+        stack.push_back(root);
+        edge.push_back(0);
+
+        while (!stack.empty()) {
+            BasicBlock *b = _bbs[stack.back()];
+            int k = edge.back()++;
+            int nsucc = 2;
+
+            if (b->end_kind == BasicBlock::BY_RETURN)
+                nsucc = 0;
+            else if (b->end_kind == BasicBlock::BY_JUMP)
+                nsucc = 1;
+
+            if (k < nsucc) {
+                // visits the fall-through (next[1]) of BY_JZERO blocks first
+                int succ = b->next[nsucc - 1 - k];
+                if (!visited[succ]) {
+                    visited[succ] = true;
+                    stack.push_back(succ);
+                    edge.push_back(0);
+                }
+            } else {
+                post.push_back(stack.back());
+                stack.pop_back();
+                edge.pop_back();
+            }
+        }
+
+        order.insert(order.end(), post.rbegin(), post.rend());
+        post.clear();
+    }
+}
+
+/* Finds the natural loops and the loop nesting depth of every block.
+ *
+ * NOTE: an edge is a back edge if its target dominates its source, so
+ *       the retreating edges of an irreducible region make no loop.
+ *       The loops are numbered so that an outer loop comes before the
+ *       loops nested in it (its header dominates theirs). The dominator
+ *       tree and the predecessors are recomputed as well.
+ */
+void FlowGraph::findLoops(void) {
+    Vector<int> by_pre, stack;
+    Vector<int> visited; // the header whose loop a block was last found in
+
+    computeDominators();
+    _loops.clear();
+    by_pre.resize(_n, -1);
+    visited.resize(_n, -1);
+    for (int i = 0; i < _n; ++i) {
+        _bbs[i]->loop_depth = 0;
+        _bbs[i]->loop = -1;
+        if (_bbs[i]->dom_pre >= 0)
+            by_pre[_bbs[i]->dom_pre] = i;
+    }
+
+    for (int k = 0; k < _n && by_pre[k] >= 0; ++k) {
+        int h = by_pre[k];
+        BasicBlock *header = _bbs[h];
+        Loop *l = NULL;
+
+        for (size_t i = 0; i < header->preds.size(); ++i) {
+            int p = header->preds[i];
+            if (!dominates(h, p))
+                continue;
+
+            if (NULL == l) {
+                l = new Loop();
+                l->header = h;
+                l->blocks.push_back(h);
+                visited[h] = h;
+            }
+            l->latches.push_back(p);
+            if (visited[p] != h) {
+                visited[p] = h;
+                stack.push_back(p);
+            }
+        }
+        if (NULL == l)
+            continue;
+
+        // walks backwards from the back edges until reaching the header
+        while (!stack.empty()) {
+            BasicBlock *b = _bbs[stack.back()];
+            stack.pop_back();
+            l->blocks.push_back(b->bb_num);
+
+            for (size_t i = 0; i < b->preds.size(); ++i) {
+                int p = b->preds[i];
+                if (visited[p] != h && _bbs[p]->dom_pre >= 0) {
+                    visited[p] = h;
+                    stack.push_back(p);
+                }
+            }
+        }
+
+        // the loops containing the header have been found already
+        l->parent = header->loop;
+        l->depth = (l->parent < 0) ? 1 : _loops[l->parent]->depth + 1;
+        for (size_t i = 0; i < l->blocks.size(); ++i) {
+            _bbs[l->blocks[i]]->loop = (int)_loops.size();
+            _bbs[l->blocks[i]]->loop_depth = l->depth;
+        }
+
+        l->preheader = -1;
+        if (header->preds.size() == l->latches.size() + 1) {
+            for (size_t i = 0; i < header->preds.size(); ++i) {
+                BasicBlock *p = _bbs[header->preds[i]];
+                if (!dominates(h, p->bb_num) && p->dom_pre >= 0 &&
+                    BasicBlock::BY_JUMP == p->end_kind)
+                    l->preheader = p->bb_num;
+            }
+        }
+
+        _loops.push_back(l);
+    }
+}
+
+/* Gets the number of natural loops.
+ *
+ * NOTE: findLoops should have been called.
+ */
+size_t FlowGraph::numLoops(void) { return _loops.size(); }
+
+/* Gets a specified natural loop.
+ *
+ * NOTE: findLoops should have been called.
+ * PARAMETERS:
+ *   i     - loop number
+ * RETURNS:
+ *   the loop identified by that number
+ */
+Loop *FlowGraph::getLoop(int i) {
+    mind_assert(i >= 0 && (size_t)i < _loops.size());
+
+    return _loops[i];
+}
+
 /* Gets a specified basic block.
  *
  * PARAMETERS:
@@ -432,3 +953,275 @@ void FlowGraph::dump(std::ostream &os) {
         os << std::endl;
     }
 }
+
+/* Computes the dominator tree.
+ *
+ * NOTE: we use the iterative algorithm of Cooper, Harvey and Kennedy
+ *       ("A Simple, Fast Dominance Algorithm", 2001) over the reverse
+ *       postorder; the tree is then numbered so that dominates() takes
+ *       constant time. The predecessors are recomputed as well.
+ */
+void FlowGraph::computeDominators(void) {
+    Vector<int> order, rpo_num, stack;
+
+    computePredecessors();
+    computeReversePostorder(order);
+
+    // only the blocks reachable from the entry take part
+    Vector<bool> reachable;
+    reachable.resize(_n, false);
+    reachable[0] = true;
+    stack.push_back(0);
+    while (!stack.empty()) {
+        BasicBlock *b = _bbs[stack.back()];
+        stack.pop_back();
+        if (BasicBlock::BY_RETURN == b->end_kind)
+            continue;
+        for (int k = 0; k < 2; ++k) {
+            if (!reachable[b->next[k]]) {
+                reachable[b->next[k]] = true;
+                stack.push_back(b->next[k]);
+            }
+        }
+    }
+
+    rpo_num.resize(_n, -1);
+    for (size_t k = 0; k < order.size(); ++k) {
+        rpo_num[order[k]] = k;
+        _bbs[order[k]]->idom = -1;
+        _bbs[order[k]]->dom_children.clear();
+        _bbs[order[k]]->dom_pre = _bbs[order[k]]->dom_post = -1;
+    }
+
+    _bbs[0]->idom = 0; // (temporarily)
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (size_t k = 1; k < order.size(); ++k) {
+            BasicBlock *b = _bbs[order[k]];
+            if (!reachable[b->bb_num])
+                continue;
+
+            int new_idom = -1;
+            for (size_t i = 0; i < b->preds.size(); ++i) {
+                int p = b->preds[i];
+                if (_bbs[p]->idom < 0)
+                    continue; // not processed yet (or unreachable)
+
+                if (new_idom < 0) {
+                    new_idom = p;
+                    continue;
+                }
+
+                // walks up to the nearest common dominator
+                int x = p, y = new_idom;
+                while (x != y) {
+                    while (rpo_num[x] > rpo_num[y])
+                        x = _bbs[x]->idom;
+                    while (rpo_num[y] > rpo_num[x])
+                        y = _bbs[y]->idom;
+                }
+                new_idom = x;
+            }
+
+            if (b->idom != new_idom) {
+                b->idom = new_idom;
+                changed = true;
+            }
+        }
+    }
+    _bbs[0]->idom = -1;
+
+    for (int i = 1; i < _n; ++i)
+        if (_bbs[i]->idom >= 0)
+            _bbs[_bbs[i]->idom]->dom_children.push_back(i);
+
+    // numbers the tree
+    Vector<int> edge;
+    int pre = 0, post = 0;
+    stack.push_back(0);
+    edge.push_back(0);
+    _bbs[0]->dom_pre = pre++;
+    while (!stack.empty()) {
+        BasicBlock *b = _bbs[stack.back()];
+        int k = edge.back()++;
+
+        if (k < (int)b->dom_children.size()) {
+            int c = b->dom_children[k];
+            _bbs[c]->dom_pre = pre++;
+            stack.push_back(c);
+            edge.push_back(0);
+        } else {
+            b->dom_post = post++;
+            stack.pop_back();
+            edge.pop_back();
+        }
+    }
+}
+
+/* Computes the dominance frontier of every basic block.
+ *
+ * NOTE: computeDominators should have been called.
+ */
+void FlowGraph::computeDominanceFrontiers(void) {
+    for (int i = 0; i < _n; ++i)
+        _bbs[i]->frontier.clear();
+
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        if (b->preds.size() < 2 || b->dom_pre < 0)
+            continue;
+
+        for (size_t k = 0; k < b->preds.size(); ++k) {
+            int runner = b->preds[k];
+            if (_bbs[runner]->dom_pre < 0)
+                continue; // unreachable predecessor
+
+            while (runner != b->idom) {
+                Vector<int> &df = _bbs[runner]->frontier;
+                if (df.empty() || df.back() != i)
+                    df.push_back(i);
+                runner = _bbs[runner]->idom;
+            }
+        }
+    }
+}
+
+/* Tests whether a block dominates another one.
+ *
+ * NOTE: computeDominators should have been called.
+ * PARAMETERS:
+ *   a     - number of the dominator
+ *   b     - number of the dominated block
+ * RETURNS:
+ *   true if every path from the entry to "b" goes through "a"
+ *   (every reachable block dominates itself)
+ */
+bool FlowGraph::dominates(int a, int b) {
+    BasicBlock *x = _bbs[a], *y = _bbs[b];
+
+    return x->dom_pre >= 0 && y->dom_pre >= 0 && x->dom_pre <= y->dom_pre &&
+           y->dom_post <= x->dom_post;
+}
+
+/* Inserts an empty block on an edge.
+ *
+ * NOTE: the predecessors of the blocks are kept up to date, but the
+ *       dominator tree and the loops are not.
+ * PARAMETERS:
+ *   from  - the source of the edge
+ *   to    - the target of the edge
+ * RETURNS:
+ *   number of the new block (an END-BY-JUMP one, going to "to")
+ */
+int FlowGraph::splitEdge(int from, int to) {
+    BasicBlock *b = new BasicBlock();
+    BasicBlock *src = _bbs[from], *dst = _bbs[to];
+
+    b->bb_num = _n++;
+    b->end_kind = BasicBlock::BY_JUMP;
+    b->next[0] = b->next[1] = to;
+    b->loop_depth = std::min(src->loop_depth, dst->loop_depth);
+    b->loop = (src->loop_depth <= dst->loop_depth) ? src->loop : dst->loop;
+    b->preds.push_back(from);
+    _bbs.push_back(b);
+
+    mind_assert(BasicBlock::BY_RETURN != src->end_kind);
+    if (BasicBlock::BY_JUMP == src->end_kind) {
+        src->next[0] = src->next[1] = b->bb_num;
+    } else {
+        for (int k = 0; k < 2; ++k)
+            if (src->next[k] == to)
+                src->next[k] = b->bb_num;
+    }
+
+    for (size_t k = 0; k < dst->preds.size(); ++k)
+        if (dst->preds[k] == from)
+            dst->preds[k] = b->bb_num;
+
+    return b->bb_num;
+}
+
+/* Gives every natural loop a preheader.
+ *
+ * NOTE: a new END-BY-JUMP block is inserted before the header of a loop
+ *       which has no preheader, and the edges entering the loop are
+ *       redirected to it. If several edges enter the loop, the PHIs of
+ *       the header are split: the new block gets a PHI merging the
+ *       entering values, and the header keeps the values of the back
+ *       edges. The loops are found again afterwards (a loop headed by
+ *       the entry block is left alone).
+ */
+void FlowGraph::insertPreheaders(void) {
+    bool inserted = false;
+
+    findLoops();
+    for (size_t i = 0; i < _loops.size(); ++i) {
+        Loop *l = _loops[i];
+        if (l->preheader >= 0 || 0 == l->header)
+            continue;
+
+        BasicBlock *h = _bbs[l->header];
+        BasicBlock *p = new BasicBlock();
+        p->bb_num = _n++;
+        p->end_kind = BasicBlock::BY_JUMP;
+        p->next[0] = p->next[1] = h->bb_num;
+        p->loop_depth = l->depth - 1;
+        p->loop = l->parent;
+        _bbs.push_back(p);
+
+        // the positions of the entering edges and of the back edges
+        Vector<int> entering, back, preds;
+        for (size_t k = 0; k < h->preds.size(); ++k) {
+            if (dominates(h->bb_num, h->preds[k]))
+                back.push_back(k);
+            else
+                entering.push_back(k);
+        }
+
+        preds.push_back(p->bb_num);
+        for (size_t k = 0; k < back.size(); ++k)
+            preds.push_back(h->preds[back[k]]);
+
+        for (size_t k = 0; k < entering.size(); ++k) {
+            BasicBlock *e = _bbs[h->preds[entering[k]]];
+            for (int j = 0; j < 2; ++j)
+                if (e->next[j] == h->bb_num)
+                    e->next[j] = p->bb_num;
+            p->preds.push_back(e->bb_num);
+        }
+
+        for (Tac *t = h->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next) {
+            Vector<Temp> &args = *t->phi_args;
+            Temp v = args[entering[0]];
+
+            if (entering.size() > 1) {
+                v = newTemp();
+                Tac *phi = Tac::Phi(v, entering.size());
+                for (size_t k = 0; k < entering.size(); ++k)
+                    (*phi->phi_args)[k] = args[entering[k]];
+                phi->mark = t->mark;
+                phi->bb_num = p->bb_num;
+                phi->prev = NULL;
+                phi->next = p->tac_chain;
+                if (NULL != p->tac_chain)
+                    p->tac_chain->prev = phi;
+                p->tac_chain = phi;
+            }
+
+            Vector<Temp> new_args;
+            new_args.push_back(v);
+            for (size_t k = 0; k < back.size(); ++k)
+                new_args.push_back(args[back[k]]);
+            args = new_args;
+        }
+
+        h->preds = preds;
+        inserted = true;
+    }
+
+    if (inserted)
+        findLoops();
+}
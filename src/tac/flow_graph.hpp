@@ -10,7 +10,7 @@
 #ifndef __MIND_FLOWGRAPH__
 #define __MIND_FLOWGRAPH__
 
-#include "3rdparty/set.hpp"
+#include "3rdparty/bitset.hpp"
 #include "3rdparty/vector.hpp"
 #include "asm/mach_desc.hpp"
 #include "define.hpp"
@@ -48,6 +48,22 @@ struct BasicBlock {
                  //  of condition = 1;
                  // for END-BY-JUMP blocks, next[0]=next[1]=successor
 
+    util::Vector<int> preds; // the block numbers of the predecessors
+                             // (see FlowGraph::computePredecessors)
+
+    int loop_depth; // how many loops contain this block
+                    // (see FlowGraph::findLoops)
+    int loop;       // the innermost loop containing this block
+                    // (-1 if none, see FlowGraph::findLoops)
+
+    int idom; // the immediate dominator (-1 for the entry block and the
+              // unreachable blocks, see FlowGraph::computeDominators)
+    util::Vector<int> dom_children; // the children in the dominator tree
+    int dom_pre, dom_post; // numbering of the dominator tree (preorder and
+                           // postorder, -1 if unreachable)
+    util::Vector<int> frontier; // the dominance frontier
+                                // (see FlowGraph::computeDominanceFrontiers)
+
     bool cancelled; // internal flag for FlowGraph
     int mark;       // internal flag for MachDesc
 
@@ -56,10 +72,10 @@ struct BasicBlock {
     assembly::Instr *instr_chain; // for ASM code generation: the associated assembly code sequence
     const char *entry_label; // for ASM code generation: the associated entry label in assembly code
 
-    util::Set<Temp> *Def; // the DEF set: ALL variables defined in this block
-    util::Set<Temp> *LiveUse; // the LiveUSE set: all used-before-defined variables
-    util::Set<Temp> *LiveIn; // the LiveIn set: all variables alive at the entry
-    util::Set<Temp> *LiveOut; // the LiveOut set: all variables alive at the exit
+    util::BitSet<Temp> *Def; // the DEF set: ALL variables defined in this block
+    util::BitSet<Temp> *LiveUse; // the LiveUSE set: all used-before-defined variables
+    util::BitSet<Temp> *LiveIn; // the LiveIn set: all variables alive at the entry
+    util::BitSet<Temp> *LiveOut; // the LiveOut set: all variables alive at the exit
 
     // constructor
     BasicBlock();
@@ -75,6 +91,24 @@ struct BasicBlock {
     void updateDEF(Temp);
 };
 
+/**
+ * Natural Loop.
+ *
+ * A natural loop is made of a header and all the blocks which can reach
+ * one of its back edges (an edge whose target dominates its source)
+ * without going through the header. Back edges sharing a header make a
+ * single loop.
+ */
+struct Loop {
+    int header;               // block number of the header
+    util::Vector<int> blocks; // block numbers of the loop (header first)
+    util::Vector<int> latches; // sources of the back edges
+    int preheader;            // the only block entering the loop, which
+                              // jumps to the header alone (-1 if none)
+    int parent;               // the innermost enclosing loop (-1 if none)
+    int depth;                // nesting depth (1 for an outermost loop)
+};
+
 /**
  * Control-flow Graph (CFG).
  *
@@ -85,6 +119,11 @@ class FlowGraph {
   private:
     util::Vector<BasicBlock *> _bbs; // basic blocks
     int _n;                          // number of basic blocks
+    int _tempCount;                  // id of the next new temporary
+    util::Vector<Loop *> _loops;     // natural loops (see findLoops)
+
+    // removes the cancelled blocks (and adjusts the block numbers)
+    void removeCancelledBlocks(void);
 
     FlowGraph() { /* don't invoke me */
     }
@@ -97,6 +136,10 @@ class FlowGraph {
     static FlowGraph *makeGraph(Functy);
     // simplifies (optimizes) a control-flow graph
     void simplify(void);
+    // sparse conditional constant propagation
+    void propagateConstants(void); // in tac/sccp.cpp
+    // creates a new temporary variable for this function
+    Temp newTemp(void);
     // gets the specified basic block
     BasicBlock *getBlock(int);
     // gets the size of this control-flow graph
@@ -109,6 +152,54 @@ class FlowGraph {
     reverse_iterator rbegin(void);
     // gets the end reverse iterator (pointing beyond the first block)
     reverse_iterator rend(void);
+    // computes the predecessors of every basic block
+    void computePredecessors(void);
+    // computes a reverse postorder of the basic blocks
+    void computeReversePostorder(util::Vector<int> &);
+    // finds the natural loops and the loop nesting depth of every block
+    void findLoops(void);
+    // gets the number of natural loops (after findLoops)
+    size_t numLoops(void);
+    // gets the specified natural loop (after findLoops)
+    Loop *getLoop(int);
+    // gives every natural loop a preheader
+    void insertPreheaders(void);
+    // splits live ranges at the boundaries of the innermost loops
+    int splitAroundLoops(util::BitSet<Temp> *, util::Vector<Temp> &,
+                         util::Vector<Temp> &); // in tac/split.cpp
+    // joins the pieces of live ranges back (undoes splitAroundLoops)
+    void joinRanges(util::Vector<Temp> &,
+                    util::Vector<Temp> &); // in tac/split.cpp
+    // hoists the loop-invariant TACs into the preheaders (in SSA form)
+    void hoistLoopInvariants(void); // in tac/licm.cpp
+    // unrolls the counted loops (not in SSA form)
+    void unrollLoops(int); // in tac/unroll.cpp
+    // moves the tests of the loops to their latches (not in SSA form)
+    void rotateLoops(void); // in tac/rotate.cpp
+    // reduces multiplications by induction variables (in SSA form)
+    void reduceStrength(void); // in tac/strength.cpp
+    // expands the multiplications and divisions by constants (in SSA form)
+    void expandMulDiv(void); // in tac/muldiv.cpp
+    // removes the redundant computations (in SSA form)
+    void numberValues(void); // in tac/gvn.cpp
+    // moves the partially redundant computations (in SSA form)
+    void eliminatePartialRedundancies(void); // in tac/pre.cpp
+    // removes the useless TACs, branches and empty blocks (in SSA form)
+    int eliminateDeadCode(void); // in tac/dce.cpp
+    // orders the basic blocks so that the frequent edges fall through
+    void layoutBlocks(const char *, util::Vector<int> &); // in tac/layout.cpp
+    // computes the dominator tree
+    void computeDominators(void);
+    // computes the dominance frontier of every basic block
+    void computeDominanceFrontiers(void);
+    // tests whether a block dominates another one (after computeDominators)
+    bool dominates(int, int);
+    // inserts an empty block on an edge (returns its block number)
+    int splitEdge(int, int);
+    // converts the TACs into (pruned) SSA form
+    void buildSSA(void); // in tac/ssa.cpp
+    // converts the TACs out of SSA form
+    void destroySSA(void); // in tac/ssa.cpp
     // computes the LiveIn set and the LiveOut set of every basic block
     void analyzeLiveness(void); // in tac/dataflow.cpp
     // prints this graph
@@ -118,7 +209,7 @@ class FlowGraph {
 } // namespace tac
 
 // an auxilliary function for printing variable set
-std::ostream &operator<<(std::ostream &, util::Set<tac::Temp> *);
+std::ostream &operator<<(std::ostream &, util::BitSet<tac::Temp> *);
 } // namespace mind
 
 #endif // __MIND_FLOWGRAPH__
@@ -0,0 +1,314 @@
+/*****************************************************
+ *  Global Value Numbering.
+ *
+ *  This file contains the implementation of FlowGraph::numberValues.
+ *
+ *  The blocks are visited in a preorder of the dominator tree. Every
+ *  computation is hashed by its operator and the value numbers of its
+ *  operands; if the same key is found in a dominating block, the
+ *  computation is redundant and becomes a copy of the earlier temp.
+ *  The copies (the ones in the source as well) are propagated into
+ *  all their uses and removed. Since the TACs are in SSA form, the
+ *  earlier definition dominates all those uses.
+ *
+ *  The hash table is a single open-addressing array, sized once for the
+ *  whole function. Leaving a subtree of the dominator tree undoes its
+ *  insertions in reverse order, which keeps the probe sequences intact.
+ *
+ *  A constant is only reused inside its own block, so that the
+ *  instruction selector still sees it, but equal constants get the same
+ *  value number everywhere.
+ *
+ *  Reference: P. Briggs, K. D. Cooper and L. T. Simpson. Value
+ *             Numbering. Software: Practice and Experience 27(6), 1997.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// the key of a constant value number (not a Tac::Kind)
+#define CONST_KEY (-2)
+// an empty slot of the hash table
+#define EMPTY_KEY (-1)
+
+/* An entry of the hash table.
+ */
+struct Entry {
+    int op;   // the operator (EMPTY_KEY: a free slot)
+    int a, b; // the operands (value numbers, or constant and block)
+    Temp val; // the temp holding the value
+};
+
+/* State of the value numbering.
+ */
+struct Numbering {
+    FlowGraph *g;
+    Vector<Entry> table; // the hash table (its size is a power of 2)
+    Vector<int> undo;    // the slots filled, in order
+    Vector<Temp> num;    // value number of every temp (NULL: itself)
+    Vector<Temp> repl;   // replacement of every temp (NULL: none)
+    int eliminated;      // how many redundant computations were removed
+    int copies;          // how many copies were propagated
+};
+
+/* Gets the value number of a temporary.
+ */
+static Temp number_of(Numbering &n, Temp v) {
+    if ((size_t)v->id < n.num.size() && NULL != n.num[v->id])
+        return n.num[v->id];
+
+    return v;
+}
+
+/* Gets the replacement of a temporary.
+ */
+static Temp replace(Numbering &n, Temp v) {
+    if ((size_t)v->id < n.repl.size() && NULL != n.repl[v->id])
+        return n.repl[v->id];
+
+    return v;
+}
+
+/* Records the value number and the replacement of a temporary.
+ */
+static void set_number(Numbering &n, Temp v, Temp num, Temp repl) {
+    if ((size_t)v->id >= n.num.size()) {
+        n.num.resize(v->id + 1, NULL);
+        n.repl.resize(v->id + 1, NULL);
+    }
+    n.num[v->id] = num;
+    n.repl[v->id] = repl;
+}
+
+/* Finds the slot of a key in the hash table.
+ *
+ * RETURNS:
+ *   the slot holding the key, or the free slot where it would go
+ */
+static int find_slot(Numbering &n, int op, int a, int b) {
+    unsigned h = (unsigned)op * 0x9e3779b1u;
+    h = (h ^ (unsigned)a) * 0x85ebca6bu;
+    h = (h ^ (unsigned)b) * 0xc2b2ae35u;
+    h ^= h >> 15;
+
+    size_t mask = n.table.size() - 1;
+    size_t i = h & mask;
+    while (EMPTY_KEY != n.table[i].op &&
+           (n.table[i].op != op || n.table[i].a != a || n.table[i].b != b))
+        i = (i + 1) & mask;
+
+    return (int)i;
+}
+
+/* Looks up a key, and inserts it if absent.
+ *
+ * PARAMETERS:
+ *   n     - the state of the value numbering
+ *   op    - the operator
+ *   a, b  - the operands
+ *   val   - the temp holding the value (if the key is absent)
+ * RETURNS:
+ *   the temp holding the value of the key
+ */
+static Temp lookup(Numbering &n, int op, int a, int b, Temp val) {
+    int i = find_slot(n, op, a, b);
+    if (EMPTY_KEY != n.table[i].op)
+        return n.table[i].val;
+
+    n.table[i].op = op;
+    n.table[i].a = a;
+    n.table[i].b = b;
+    n.table[i].val = val;
+    n.undo.push_back(i);
+    return val;
+}
+
+/* Tests whether an operator is commutative.
+ */
+static bool is_commutative(Tac::Kind k) {
+    switch (k) {
+    case Tac::ADD:
+    case Tac::MUL:
+    case Tac::MULH:
+    case Tac::EQU:
+    case Tac::NEQ:
+    case Tac::LAND:
+    case Tac::LOR:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/* Removes a TAC from its block.
+ */
+static void unlink(BasicBlock *b, Tac *t) {
+    if (NULL == t->prev)
+        b->tac_chain = t->next;
+    else
+        t->prev->next = t->next;
+    if (NULL != t->next)
+        t->next->prev = t->prev;
+}
+
+/* Numbers the values computed in a block.
+ *
+ * NOTE: a redundant TAC, and a copy, is removed at once: its uses in
+ *       the dominated blocks get the replacement when visited.
+ */
+static void number_block(Numbering &n, BasicBlock *b) {
+    Temp *slots[2];
+    Tac *next;
+
+    for (Tac *t = b->tac_chain; t != NULL; t = next) {
+        next = t->next;
+
+        int k = t->getUseSlots(slots);
+        for (int i = 0; i < k; ++i)
+            *slots[i] = replace(n, *slots[i]);
+
+        Temp v = t->getDef();
+        if (NULL == v)
+            continue;
+
+        Temp same = v;
+        switch (t->op_code) {
+        case Tac::LOAD_IMM4:
+            // equal constants get the same number everywhere...
+            set_number(n, v, lookup(n, CONST_KEY, t->op1.ival, 0, v), NULL);
+            // ...but are only reused in the same block
+            same = lookup(n, Tac::LOAD_IMM4, t->op1.ival, b->bb_num, v);
+            if (same == v)
+                continue;
+            break;
+
+        case Tac::ASSIGN:
+            set_number(n, v, number_of(n, t->op1.var), t->op1.var);
+            unlink(b, t);
+            ++n.copies;
+            continue;
+
+        case Tac::PHI: {
+            // a PHI whose arguments are all the same value is a copy
+            Vector<Temp> &args = *t->phi_args;
+            Temp x = NULL;
+            bool all_same = true;
+            for (size_t i = 0; i < args.size(); ++i) {
+                Temp y = replace(n, args[i]);
+                if (y == v)
+                    continue;
+                if (NULL == x)
+                    x = y;
+                else if (x != y)
+                    all_same = false;
+            }
+            if (all_same && NULL != x) {
+                set_number(n, v, number_of(n, x), x);
+                unlink(b, t);
+                ++n.copies;
+            }
+            continue;
+        }
+
+        case Tac::POP:
+            continue;
+
+        default: {
+            int op = t->op_code;
+            int x = number_of(n, t->op1.var)->id;
+            int y = (NULL == t->op2.var) ? 0 : number_of(n, t->op2.var)->id;
+            if (Tac::GTR == op || Tac::GEQ == op ||
+                (is_commutative(t->op_code) && x > y)) {
+                // (a > b) is (b < a), and so on
+                if (Tac::GTR == op)
+                    op = Tac::LES;
+                else if (Tac::GEQ == op)
+                    op = Tac::LEQ;
+                int z = x;
+                x = y;
+                y = z;
+            }
+            same = lookup(n, op, x, y, v);
+            if (same == v)
+                continue;
+            break;
+        }
+        }
+
+        // the computation is redundant
+        set_number(n, v, number_of(n, same), same);
+        unlink(b, t);
+        ++n.eliminated;
+    }
+
+    if (BasicBlock::BY_JUMP != b->end_kind)
+        b->var = replace(n, b->var);
+}
+
+/* Visits a subtree of the dominator tree.
+ */
+static void number_tree(Numbering &n, BasicBlock *b) {
+    size_t mark = n.undo.size();
+
+    number_block(n, b);
+    for (size_t i = 0; i < b->dom_children.size(); ++i)
+        number_tree(n, n.g->getBlock(b->dom_children[i]));
+
+    while (n.undo.size() > mark) {
+        n.table[n.undo.back()].op = EMPTY_KEY;
+        n.undo.pop_back();
+    }
+}
+
+/* Removes the redundant computations (global value numbering).
+ *
+ * NOTE: the TACs should be in SSA form. A PHI whose arguments are all
+ *       the same value becomes a copy as well. Every TAC adds at most
+ *       2 keys, so the hash table is kept at most half full.
+ */
+void FlowGraph::numberValues(void) {
+    Numbering n;
+    int count = 0;
+
+    computeDominators();
+    for (int i = 0; i < _n; ++i)
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next)
+            ++count;
+
+    size_t size = 16;
+    while (size < 4 * (size_t)count + 16)
+        size *= 2;
+    Entry empty;
+    empty.op = EMPTY_KEY;
+    empty.a = empty.b = 0;
+    empty.val = NULL;
+    n.table.resize(size, empty);
+    n.undo.reserve(size);
+    n.g = this;
+    n.eliminated = n.copies = 0;
+
+    number_tree(n, _bbs[0]);
+
+    // the PHI arguments from the back edges were not visited yet
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next) {
+            Vector<Temp> &args = *t->phi_args;
+            for (size_t k = 0; k < args.size(); ++k)
+                args[k] = replace(n, args[k]);
+        }
+    }
+
+    if (Option::showStats())
+        std::cerr << "gvn: " << n.eliminated << " redundant computations, "
+                  << n.copies << " copies propagated" << std::endl;
+}
@@ -0,0 +1,291 @@
+/*****************************************************
+ *  Basic Block Layout.
+ *
+ *  This file contains the implementation of FlowGraph::layoutBlocks.
+ *
+ *  The blocks are chained up bottom-up (Pettis and Hansen): the edges
+ *  are visited from the heaviest one, and an edge joins two chains when
+ *  it leaves the tail of one and enters the head of the other, so that
+ *  it becomes a fall-through. The chains are then placed from the one
+ *  holding the entry, each time choosing the chain entered by the
+ *  heaviest edge from the blocks already placed.
+ *
+ *  The weight of an edge is its count in the edge profile (see
+ *  Option::getProfile), if the profile mentions the function at all.
+ *  Otherwise it is estimated: a block runs LOOP_WEIGHT times as often as
+ *  the code around its innermost loop, and a branch is split by the
+ *  loop-branch, loop-exit and return heuristics of Ball and Larus.
+ *
+ *  References: K. Pettis and R. C. Hansen. Profile Guided Code
+ *              Positioning. PLDI 1990.
+ *              T. Ball and J. R. Larus. Branch Prediction for Free.
+ *              PLDI 1993.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// how many times a loop body runs for each entry (estimated)
+#define LOOP_WEIGHT 8.0
+// probability of taking a back edge
+#define TAKEN_BACK 0.88
+// probability of taking an edge out of the innermost loop
+#define TAKEN_EXIT 0.12
+// probability of taking an edge to a returning block
+#define TAKEN_RETURN 0.28
+
+/* An edge of the control-flow graph.
+ */
+struct Edge {
+    int from, to;  // block numbers
+    double weight; // execution count (profiled or estimated)
+};
+
+/* A line of the edge profile.
+ */
+struct ProfileEntry {
+    std::string func; // the function name
+    int from, to;     // block numbers
+    double count;     // how many times the edge was taken
+};
+
+// the edge profile (see load_profile)
+static Vector<ProfileEntry> *profile = NULL;
+
+/* Loads the edge profile given on the command line (once).
+ *
+ * NOTE: every line is "FUNCTION FROM TO COUNT"; the empty lines and the
+ *       ones starting with '#' are skipped.
+ */
+static void load_profile(void) {
+    if (NULL != profile)
+        return;
+
+    profile = new Vector<ProfileEntry>();
+    std::ifstream fin(Option::getProfile());
+    if (!fin) {
+        std::cerr << "Cannot open the edge profile '" << Option::getProfile()
+                  << "'." << std::endl;
+        std::exit(1);
+    }
+
+    std::string line;
+    while (std::getline(fin, line)) {
+        std::istringstream iss(line);
+        ProfileEntry e;
+        if (!(iss >> e.func) || '#' == e.func[0])
+            continue;
+        if (!(iss >> e.from >> e.to >> e.count)) {
+            std::cerr << "Bad line in the edge profile: " << line << std::endl;
+            std::exit(1);
+        }
+        profile->push_back(e);
+    }
+}
+
+/* Tests whether a block is inside the specified loop.
+ */
+static bool in_loop(FlowGraph *g, BasicBlock *b, int loop) {
+    for (int l = b->loop; l >= 0; l = g->getLoop(l)->parent)
+        if (l == loop)
+            return true;
+
+    return false;
+}
+
+/* Tests whether an edge is a back edge of some loop.
+ */
+static bool is_back_edge(FlowGraph *g, BasicBlock *b, int to) {
+    for (int l = b->loop; l >= 0; l = g->getLoop(l)->parent)
+        if (g->getLoop(l)->header == to)
+            return true;
+
+    return false;
+}
+
+/* Estimates how often a conditional branch takes its "true" successor.
+ *
+ * PARAMETERS:
+ *   g     - the control-flow graph (after findLoops)
+ *   b     - the block ending with the branch
+ * RETURNS:
+ *   the probability of going to b->next[1]
+ */
+static double estimate_taken(FlowGraph *g, BasicBlock *b) {
+    BasicBlock *s0 = g->getBlock(b->next[0]);
+    BasicBlock *s1 = g->getBlock(b->next[1]);
+
+    // loop-branch heuristic
+    bool back0 = is_back_edge(g, b, s0->bb_num);
+    bool back1 = is_back_edge(g, b, s1->bb_num);
+    if (back0 != back1)
+        return back1 ? TAKEN_BACK : 1.0 - TAKEN_BACK;
+
+    // loop-exit heuristic
+    if (b->loop >= 0) {
+        bool exit0 = !in_loop(g, s0, b->loop);
+        bool exit1 = !in_loop(g, s1, b->loop);
+        if (exit0 != exit1)
+            return exit1 ? TAKEN_EXIT : 1.0 - TAKEN_EXIT;
+    }
+
+    // return heuristic
+    bool ret0 = BasicBlock::BY_RETURN == s0->end_kind;
+    bool ret1 = BasicBlock::BY_RETURN == s1->end_kind;
+    if (ret0 != ret1)
+        return ret1 ? TAKEN_RETURN : 1.0 - TAKEN_RETURN;
+
+    return 0.5;
+}
+
+/* Orders the edges from the heaviest one (ties by block numbers).
+ */
+static bool heavier(const Edge &x, const Edge &y) {
+    if (x.weight != y.weight)
+        return x.weight > y.weight;
+    if (x.from != y.from)
+        return x.from < y.from;
+    return x.to < y.to;
+}
+
+/* Lays out the basic blocks so that the frequent edges fall through.
+ *
+ * PARAMETERS:
+ *   func  - name of the function (to look up the edge profile)
+ *   order - the block numbers, in the order of emission (output)
+ * NOTE:
+ *   the entry block comes first. The loops are found again, so the
+ *   loop information is valid afterwards.
+ */
+void FlowGraph::layoutBlocks(const char *func, Vector<int> &order) {
+    Vector<Edge> edges;
+    Vector<double> freq;
+    bool profiled = false;
+
+    findLoops();
+    freq.resize(_n, 1.0);
+    if (NULL != Option::getProfile()) {
+        load_profile();
+        for (size_t i = 0; i < profile->size() && !profiled; ++i)
+            profiled = ((*profile)[i].func == func);
+    }
+
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        for (int d = 0; d < b->loop_depth; ++d)
+            freq[i] *= LOOP_WEIGHT;
+
+        Edge e;
+        e.from = i;
+        switch (b->end_kind) {
+        case BasicBlock::BY_JUMP:
+            e.to = b->next[0];
+            e.weight = freq[i];
+            edges.push_back(e);
+            break;
+
+        case BasicBlock::BY_JZERO:
+            if (b->next[0] == b->next[1]) {
+                e.to = b->next[0];
+                e.weight = freq[i];
+                edges.push_back(e);
+            } else {
+                double p = estimate_taken(this, b);
+                e.to = b->next[1];
+                e.weight = freq[i] * p;
+                edges.push_back(e);
+                e.to = b->next[0];
+                e.weight = freq[i] * (1.0 - p);
+                edges.push_back(e);
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    if (profiled) {
+        // the counts replace the estimates (an edge not listed never ran)
+        for (size_t k = 0; k < edges.size(); ++k) {
+            edges[k].weight = 0;
+            for (size_t i = 0; i < profile->size(); ++i) {
+                ProfileEntry &p = (*profile)[i];
+                if (p.from == edges[k].from && p.to == edges[k].to &&
+                    p.func == func)
+                    edges[k].weight += p.count;
+            }
+        }
+    }
+    std::sort(edges.begin(), edges.end(), heavier);
+
+    // every block starts as a chain of its own (named by its number)
+    Vector<int> chain, head, tail, link;
+    chain.resize(_n);
+    head.resize(_n);
+    tail.resize(_n);
+    link.resize(_n, -1);
+    for (int i = 0; i < _n; ++i)
+        chain[i] = head[i] = tail[i] = i;
+
+    int num_chains = _n;
+    for (size_t k = 0; k < edges.size(); ++k) {
+        int u = edges[k].from, v = edges[k].to;
+        int c = chain[u], d = chain[v];
+        if (c == d || tail[c] != u || head[d] != v || 0 == v)
+            continue;
+
+        link[u] = v;
+        tail[c] = tail[d];
+        for (int x = v; x >= 0; x = link[x])
+            chain[x] = c;
+        --num_chains;
+    }
+
+    // places the chains, starting from the entry
+    Vector<int> placed;
+    placed.resize(_n, 0);
+    order.clear();
+    int next = chain[0];
+    while (next >= 0) {
+        for (int x = head[next]; x >= 0; x = link[x]) {
+            order.push_back(x);
+            placed[x] = 1;
+        }
+
+        next = -1;
+        for (size_t k = 0; k < edges.size() && next < 0; ++k)
+            if (placed[edges[k].from] && !placed[edges[k].to])
+                next = chain[edges[k].to];
+        for (int i = 0; i < _n && next < 0; ++i)
+            if (!placed[i])
+                next = chain[i];
+    }
+
+    if (Option::showStats()) {
+        int fall = 0;
+        for (size_t k = 0; k + 1 < order.size(); ++k) {
+            BasicBlock *b = _bbs[order[k]];
+            if (BasicBlock::BY_RETURN != b->end_kind &&
+                (b->next[0] == order[k + 1] || b->next[1] == order[k + 1]))
+                ++fall;
+        }
+        std::cerr << "layout: " << num_chains << " chains, " << fall
+                  << " fall-through edges ("
+                  << (profiled ? "profiled" : "estimated") << ")" << std::endl;
+    }
+}
@@ -0,0 +1,244 @@
+/*****************************************************
+ *  Loop-Invariant Code Motion.
+ *
+ *  This file contains the implementation of FlowGraph::hoistLoopInvariants.
+ *
+ *  A TAC is invariant in a loop if each of its operands is defined
+ *  outside the loop, or by a TAC which is invariant itself. Since the
+ *  TACs are in SSA form, moving such a TAC into the preheader of the
+ *  loop never overwrites another value, and its definition still
+ *  dominates all its uses. The loops are processed from the inside
+ *  out, so that a TAC hoisted out of an inner loop may go on moving
+ *  out of the enclosing one.
+ *
+ *  Reference: S. S. Muchnick. Advanced Compiler Design and
+ *             Implementation. Section 13.2.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* State of the code motion.
+ */
+struct Motion {
+    FlowGraph *g;
+    Vector<Tac *> def;    // the TAC defining every temp (NULL: the entry)
+    Vector<bool> in_loop; // whether a block is in the current loop
+    Vector<Temp> copy;    // the copy of a constant in the preheader
+    Vector<int> copy_in;  // ... made in which block
+};
+
+/* Records the definition of a temporary.
+ */
+static void set_def(Motion &m, Temp v, Tac *t) {
+    if ((size_t)v->id >= m.def.size()) {
+        m.def.resize(v->id + 1, NULL);
+        m.copy.resize(v->id + 1, NULL);
+        m.copy_in.resize(v->id + 1, -1);
+    }
+    m.def[v->id] = t;
+}
+
+/* Gets the TAC defining a temporary in the current loop.
+ *
+ * RETURNS:
+ *   the definition, or NULL if the temporary is defined outside the loop
+ */
+static Tac *def_in_loop(Motion &m, Temp v) {
+    if ((size_t)v->id >= m.def.size() || NULL == m.def[v->id])
+        return NULL;
+
+    Tac *d = m.def[v->id];
+    return m.in_loop[d->bb_num] ? d : NULL;
+}
+
+/* Tests whether a TAC may be executed on every path into the loop.
+ *
+ * NOTE: a division is only moved when its divisor is a constant which
+ *       can neither trap nor overflow; the PHIs, stack operations and
+ *       constants stay where they are (a constant is copied instead,
+ *       so that the instruction selector still sees it in the loop).
+ */
+static bool is_movable(Motion &m, Tac *t) {
+    switch (t->op_code) {
+    case Tac::ASSIGN:
+    case Tac::ADD:
+    case Tac::SUB:
+    case Tac::MUL:
+    case Tac::SHL:
+    case Tac::SHR:
+    case Tac::SAR:
+    case Tac::MULH:
+    case Tac::EQU:
+    case Tac::NEQ:
+    case Tac::LES:
+    case Tac::LEQ:
+    case Tac::GTR:
+    case Tac::GEQ:
+    case Tac::NEG:
+    case Tac::NOT:
+    case Tac::LAND:
+    case Tac::LOR:
+    case Tac::SEL_NZ:
+    case Tac::SEL_Z:
+    case Tac::LNOT:
+    case Tac::BNOT:
+        return true;
+
+    case Tac::DIV:
+    case Tac::MOD: {
+        Tac *d = ((size_t)t->op2.var->id < m.def.size()) ? m.def[t->op2.var->id]
+                                                          : NULL;
+        return NULL != d && Tac::LOAD_IMM4 == d->op_code && 0 != d->op1.ival &&
+               -1 != d->op1.ival;
+    }
+
+    default:
+        return false;
+    }
+}
+
+/* Tests whether a TAC is invariant in the current loop.
+ */
+static bool is_invariant(Motion &m, Tac *t) {
+    Temp *slots[2];
+
+    if (!is_movable(m, t))
+        return false;
+
+    int n = t->getUseSlots(slots);
+    for (int i = 0; i < n; ++i) {
+        Tac *d = def_in_loop(m, *slots[i]);
+        if (NULL != d && Tac::LOAD_IMM4 != d->op_code)
+            return false;
+    }
+
+    return true;
+}
+
+/* Inserts a TAC at the end of a block.
+ */
+static void append(BasicBlock *b, Tac *t) {
+    Tac *last = b->tac_chain;
+    while (NULL != last && NULL != last->next)
+        last = last->next;
+
+    t->bb_num = b->bb_num;
+    t->prev = last;
+    t->next = NULL;
+    if (NULL == last)
+        b->tac_chain = t;
+    else
+        last->next = t;
+}
+
+/* Removes a TAC from its block.
+ */
+static void unlink(BasicBlock *b, Tac *t) {
+    if (NULL == t->prev)
+        b->tac_chain = t->next;
+    else
+        t->prev->next = t->next;
+    if (NULL != t->next)
+        t->next->prev = t->prev;
+}
+
+/* Moves an invariant TAC into the preheader.
+ *
+ * PARAMETERS:
+ *   m     - the state of the code motion
+ *   t     - the invariant TAC
+ *   p     - the preheader
+ */
+static void hoist(Motion &m, Tac *t, BasicBlock *p) {
+    Temp *slots[2];
+
+    unlink(m.g->getBlock(t->bb_num), t);
+
+    // the constants of the loop are copied into the preheader
+    int n = t->getUseSlots(slots);
+    for (int i = 0; i < n; ++i) {
+        Tac *d = def_in_loop(m, *slots[i]);
+        if (NULL == d)
+            continue;
+
+        int id = (*slots[i])->id;
+        if (m.copy_in[id] != p->bb_num) {
+            Tac *c = Tac::LoadImm4(m.g->newTemp(), d->op1.ival);
+            append(p, c);
+            set_def(m, c->op0.var, c);
+            m.copy[id] = c->op0.var;
+            m.copy_in[id] = p->bb_num;
+        }
+        *slots[i] = m.copy[id];
+    }
+
+    append(p, t);
+}
+
+/* Hoists the loop-invariant TACs into the preheaders of the loops.
+ *
+ * NOTE: the TACs should be in SSA form. Every loop is given a preheader
+ *       first (see FlowGraph::insertPreheaders).
+ */
+void FlowGraph::hoistLoopInvariants(void) {
+    Motion m;
+    int blocks = _n, hoisted = 0;
+
+    insertPreheaders();
+
+    m.g = this;
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            t->bb_num = i; // (the blocks may have been renumbered)
+            if (NULL != t->getDef())
+                set_def(m, t->getDef(), t);
+        }
+    }
+
+    for (int i = (int)_loops.size() - 1; i >= 0; --i) {
+        Loop *l = _loops[i];
+        if (l->preheader < 0)
+            continue; // (a loop headed by the entry block)
+
+        BasicBlock *p = _bbs[l->preheader];
+        m.in_loop.assign(_n, false);
+        for (size_t k = 0; k < l->blocks.size(); ++k)
+            m.in_loop[l->blocks[k]] = true;
+
+        // visits the blocks in a preorder of the dominator tree, so that
+        // the definitions are seen before their uses
+        Vector<int> stack;
+        stack.push_back(l->header);
+        while (!stack.empty()) {
+            BasicBlock *b = _bbs[stack.back()];
+            stack.pop_back();
+            for (size_t k = 0; k < b->dom_children.size(); ++k)
+                if (m.in_loop[b->dom_children[k]])
+                    stack.push_back(b->dom_children[k]);
+
+            Tac *t = b->tac_chain;
+            while (NULL != t) {
+                Tac *next = t->next;
+                if (is_invariant(m, t)) {
+                    hoist(m, t, p);
+                    ++hoisted;
+                }
+                t = next;
+            }
+        }
+    }
+
+    if (Option::showStats())
+        std::cerr << "licm: " << _loops.size() << " loops, " << (_n - blocks)
+                  << " preheaders inserted, " << hoisted << " hoisted"
+                  << std::endl;
+}
@@ -0,0 +1,355 @@
+/*****************************************************
+ *  Multiplication and Division by Constants.
+ *
+ *  This file contains the implementation of FlowGraph::expandMulDiv.
+ *
+ *  A multiplication by a constant c becomes shifts and additions when
+ *  c has few nonzero digits in its signed-digit (non-adjacent) form:
+ *
+ *      x * 10  =>  (x << 3) + (x << 1)
+ *      x * -7  =>  x - (x << 3)
+ *
+ *  A signed division by a power of two 2^k rounds towards zero by
+ *  adding 2^k - 1 to a negative dividend before the arithmetic shift:
+ *
+ *      q <- (x + ((x >> 31) >>> (32 - k))) >> k
+ *
+ *  and a division by any other constant d multiplies by a "magic"
+ *  number M close to 2^(32 + s) / d, keeping the high word:
+ *
+ *      q <- mulh(x, M)    (+ x if d > 0 > M, - x if d < 0 < M)
+ *      q <- q >> s
+ *      q <- q + (q >>> 31)
+ *
+ *  The remainder is x - q * d. The TACs should be in SSA form, so that
+ *  the constant divisor is the one LoadImm4 defining it; the new
+ *  constants are loaded just before their uses, so that the instruction
+ *  selector takes them as immediate numbers.
+ *
+ *  References: T. Granlund and P. L. Montgomery. Division by Invariant
+ *              Integers using Multiplication. PLDI 1994.
+ *              H. S. Warren, Jr. Hacker's Delight, 2nd ed. Chapter 10.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <climits>
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// the most TACs replacing a multiplication
+#define MUL_MAX_OPS 2
+
+/* State of the expansion.
+ */
+struct Expansion {
+    FlowGraph *g;
+    Vector<Tac *> def; // the LoadImm4 defining every temp (NULL: other)
+    BasicBlock *b;     // the current block
+    Tac *at;           // the new TACs go before it
+    int muls, divs;    // how many multiplications / divisions expanded
+};
+
+/* Inserts a new TAC before the current one.
+ *
+ * RETURNS:
+ *   the temporary it defines
+ */
+static Temp emit(Expansion &e, Tac *t) {
+    t->bb_num = e.b->bb_num;
+    t->prev = e.at->prev;
+    t->next = e.at;
+    if (NULL == e.at->prev)
+        e.b->tac_chain = t;
+    else
+        e.at->prev->next = t;
+    e.at->prev = t;
+
+    return t->op0.var;
+}
+
+/* Loads a constant just before the current TAC.
+ */
+static Temp constant(Expansion &e, int val) {
+    return emit(e, Tac::LoadImm4(e.g->newTemp(), val));
+}
+
+/* Gets the constant held by a temporary.
+ *
+ * RETURNS:
+ *   true if the temporary is defined by a LoadImm4
+ */
+static bool get_const(Expansion &e, Temp v, int &val) {
+    if ((size_t)v->id >= e.def.size() || NULL == e.def[v->id])
+        return false;
+
+    val = e.def[v->id]->op1.ival;
+    return true;
+}
+
+/* Gets k if u is 2^k (-1 otherwise).
+ */
+static int log2_of(unsigned u) {
+    if (0 == u || 0 != (u & (u - 1)))
+        return -1;
+
+    int k = 0;
+    while (u > 1) {
+        u >>= 1;
+        ++k;
+    }
+    return k;
+}
+
+/* Shifts a temporary by a constant amount.
+ */
+static Temp shift(Expansion &e, Tac::Kind kind, Temp x, int k) {
+    if (0 == k)
+        return x;
+
+    Temp n = constant(e, k);
+    Temp r = e.g->newTemp();
+    switch (kind) {
+    case Tac::SHL:
+        return emit(e, Tac::Shl(r, x, n));
+
+    case Tac::SHR:
+        return emit(e, Tac::Shr(r, x, n));
+
+    default:
+        return emit(e, Tac::Sar(r, x, n));
+    }
+}
+
+/* Expands a multiplication by a constant.
+ *
+ * PARAMETERS:
+ *   e     - the state of the expansion
+ *   x     - the other factor
+ *   c     - the constant
+ * RETURNS:
+ *   the temporary holding x * c, or NULL if a "mul" is cheaper
+ */
+static Temp multiply(Expansion &e, Temp x, int c) {
+    // the signed digits of c: c = sum of sign[i] * 2^pos[i]
+    int pos[33], sign[33], n = 0;
+    long long v = c;
+    for (int i = 0; 0 != v; ++i, v /= 2) {
+        if (0 == (v & 1))
+            continue;
+        int z = (1 == (v & 3)) ? 1 : -1;
+        pos[n] = i;
+        sign[n] = z;
+        ++n;
+        v -= z;
+    }
+    if (0 == n)
+        return constant(e, 0);
+
+    // starts from a positive digit if any (or negates at the end)
+    int first = 0;
+    while (first < n && sign[first] < 0)
+        ++first;
+    bool negate = (first == n);
+    if (negate)
+        first = 0;
+
+    int ops = n - 1 + (negate ? 1 : 0);
+    for (int i = 0; i < n; ++i)
+        if (pos[i] > 0)
+            ++ops;
+    if (ops > MUL_MAX_OPS)
+        return NULL;
+
+    Temp r = shift(e, Tac::SHL, x, pos[first]);
+    for (int i = 0; i < n; ++i) {
+        if (i == first)
+            continue;
+        Temp y = shift(e, Tac::SHL, x, pos[i]);
+        if (sign[i] == sign[first])
+            r = emit(e, Tac::Add(e.g->newTemp(), r, y));
+        else
+            r = emit(e, Tac::Sub(e.g->newTemp(), r, y));
+    }
+    if (negate)
+        r = emit(e, Tac::Neg(e.g->newTemp(), r));
+
+    return r;
+}
+
+/* Computes the magic number of a signed division.
+ *
+ * PARAMETERS:
+ *   d     - the divisor (neither 0, 1, -1 nor a power of two)
+ *   m     - receives the multiplier
+ *   s     - receives the shift amount
+ * NOTE: Hacker's Delight, figure 10-1
+ */
+static void magic(int d, int &m, int &s) {
+    const unsigned two31 = 0x80000000u;
+    unsigned ad = (d < 0) ? 0u - d : d;
+    unsigned t = two31 + ((unsigned)d >> 31);
+    unsigned anc = t - 1 - t % ad; // the absolute value of nc
+    unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+    unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+    unsigned delta;
+    int p = 31;
+
+    do {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && 0 == r1));
+
+    m = (int)(q2 + 1);
+    if (d < 0)
+        m = (int)(0u - (unsigned)m);
+    s = p - 32;
+}
+
+/* Expands a signed division by a constant.
+ *
+ * PARAMETERS:
+ *   e     - the state of the expansion
+ *   x     - the dividend
+ *   d     - the divisor (not 0)
+ * RETURNS:
+ *   the temporary holding x / d (rounded towards zero)
+ */
+static Temp divide(Expansion &e, Temp x, int d) {
+    if (1 == d)
+        return x;
+    if (-1 == d)
+        return emit(e, Tac::Neg(e.g->newTemp(), x));
+
+    unsigned ad = (d < 0) ? 0u - d : d;
+    int k = log2_of(ad);
+    Temp q;
+    if (k > 0) {
+        Temp sign = (1 == k) ? x : shift(e, Tac::SAR, x, 31);
+        Temp bias = shift(e, Tac::SHR, sign, 32 - k);
+        q = emit(e, Tac::Add(e.g->newTemp(), x, bias));
+        q = shift(e, Tac::SAR, q, k);
+        if (d < 0)
+            q = emit(e, Tac::Neg(e.g->newTemp(), q));
+        return q;
+    }
+
+    int m, s;
+    magic(d, m, s);
+    q = emit(e, Tac::MulH(e.g->newTemp(), x, constant(e, m)));
+    if (d > 0 && m < 0)
+        q = emit(e, Tac::Add(e.g->newTemp(), q, x));
+    else if (d < 0 && m > 0)
+        q = emit(e, Tac::Sub(e.g->newTemp(), q, x));
+    q = shift(e, Tac::SAR, q, s);
+    Temp t = shift(e, Tac::SHR, q, 31);
+    return emit(e, Tac::Add(e.g->newTemp(), q, t));
+}
+
+/* Expands a signed remainder by a constant.
+ *
+ * PARAMETERS:
+ *   e     - the state of the expansion
+ *   x     - the dividend
+ *   d     - the divisor (not 0)
+ * RETURNS:
+ *   the temporary holding x % d (with the sign of x)
+ */
+static Temp remainder(Expansion &e, Temp x, int d) {
+    if (1 == d || -1 == d)
+        return constant(e, 0);
+
+    // x - x / d * d, where the sign of d does not matter
+    if (d < 0 && INT_MIN != d)
+        d = -d;
+    Temp q = divide(e, x, d);
+    Temp p = multiply(e, q, d);
+    if (NULL == p)
+        p = emit(e, Tac::Mul(e.g->newTemp(), q, constant(e, d)));
+    return emit(e, Tac::Sub(e.g->newTemp(), x, p));
+}
+
+/* Expands the multiplications, divisions and remainders by constants.
+ *
+ * NOTE: the TACs should be in SSA form. An expanded TAC becomes a copy
+ *       of its value (to be propagated by FlowGraph::numberValues).
+ */
+void FlowGraph::expandMulDiv(void) {
+    Expansion e;
+    e.g = this;
+    e.muls = e.divs = 0;
+
+    for (int i = 0; i < _n; ++i)
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next)
+            if (Tac::LOAD_IMM4 == t->op_code) {
+                Temp v = t->op0.var;
+                if ((size_t)v->id >= e.def.size())
+                    e.def.resize(v->id + 1, NULL);
+                e.def[v->id] = t;
+            }
+
+    for (int i = 0; i < _n; ++i) {
+        e.b = _bbs[i];
+        for (Tac *t = e.b->tac_chain; t != NULL; t = t->next) {
+            int c;
+            Temp r = NULL;
+            e.at = t;
+
+            switch (t->op_code) {
+            case Tac::MUL:
+                if (get_const(e, t->op2.var, c))
+                    r = multiply(e, t->op1.var, c);
+                else if (get_const(e, t->op1.var, c))
+                    r = multiply(e, t->op2.var, c);
+                if (NULL != r)
+                    ++e.muls;
+                break;
+
+            case Tac::DIV:
+                if (get_const(e, t->op2.var, c) && 0 != c) {
+                    r = divide(e, t->op1.var, c);
+                    ++e.divs;
+                }
+                break;
+
+            case Tac::MOD:
+                if (get_const(e, t->op2.var, c) && 0 != c) {
+                    r = remainder(e, t->op1.var, c);
+                    ++e.divs;
+                }
+                break;
+
+            default:
+                break;
+            }
+
+            if (NULL != r) {
+                t->op_code = Tac::ASSIGN;
+                t->op1.var = r;
+                t->op2.var = NULL;
+            }
+        }
+    }
+
+    if (Option::showStats())
+        std::cerr << "muldiv: " << e.muls << " multiplications, " << e.divs
+                  << " divisions expanded" << std::endl;
+}
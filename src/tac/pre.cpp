@@ -0,0 +1,672 @@
+/*****************************************************
+ *  Partial Redundancy Elimination (Lazy Code Motion).
+ *
+ *  This file contains the implementation of
+ *  FlowGraph::eliminatePartialRedundancies.
+ *
+ *  An expression is an operator applied to temporaries and constants.
+ *  Since the TACs are in SSA form, it has the same value wherever it is
+ *  computed, and only the definitions of its operands kill it. Every
+ *  expression gets a new temporary, computed at the entry of some
+ *  blocks, and its first computation in a block is replaced by it when
+ *  that is redundant. The blocks are chosen by 4 bit-vector problems:
+ *
+ *    ANTICIPATED  computed on every path from the entry of a block,
+ *                 before a kill (backwards)
+ *    AVAILABLE    anticipated in a block on every path to its entry
+ *                 (forwards); EARLIEST = ANTICIPATED - AVAILABLE
+ *    POSTPONABLE  EARLIEST in a block on every path to its entry, and
+ *                 not computed since (forwards)
+ *    USED         computed after the exit of a block, before a LATEST
+ *                 block (backwards)
+ *
+ *  LATEST are the blocks where the expression can be placed, but not
+ *  postponed any further. It is inserted into those where it is USED.
+ *  The placement is only optimal if every edge into a join has a block
+ *  of its own, so these edges (the critical ones among them) are split
+ *  first, and the split blocks which stay empty are removed at the end.
+ *
+ *  Reference: J. Knoop, O. Ruthing and B. Steffen. Lazy Code Motion.
+ *             PLDI 1992.
+ *             A. V. Aho et al. Compilers: Principles, Techniques, and
+ *             Tools (2nd Edition). Section 9.5.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* An expression.
+ */
+struct Expr {
+    int id;        // index of the expression (for BitSet)
+    int op;        // the operator (GTR and GEQ are turned into LES and LEQ)
+    bool c1, c2;   // whether the operands are constants
+    int v1, v2;    // the operands (temp ids or constant values)
+    Tac *sample;   // a TAC computing this expression
+    Temp holder;   // the temp holding the value (NULL until needed)
+};
+
+typedef BitSet<Expr *> ExprSet;
+
+/* State of the partial redundancy elimination.
+ */
+struct Placement {
+    FlowGraph *g;
+    Vector<Expr *> exprs;       // all the expressions
+    Vector<int> table;          // hash table of the expressions (-1: free)
+    Vector<Tac *> def;          // the TAC defining every temp (NULL: entry)
+    Vector<int> num_defs;       // number of definitions of every temp
+    Vector<Vector<int> > users; // the expressions using every temp
+};
+
+/* Records the definition of a temporary.
+ */
+static void set_def(Placement &p, Temp v, Tac *t) {
+    if ((size_t)v->id >= p.def.size()) {
+        p.def.resize(v->id + 1, NULL);
+        p.num_defs.resize(v->id + 1, 0);
+        p.users.resize(v->id + 1);
+    }
+    p.def[v->id] = t;
+    ++p.num_defs[v->id];
+}
+
+/* Gets the number of definitions of a temporary.
+ */
+static int defs_of(Placement &p, Temp v) {
+    return ((size_t)v->id < p.num_defs.size()) ? p.num_defs[v->id] : 0;
+}
+
+/* Gets the constant held by a temporary.
+ *
+ * RETURNS:
+ *   true if the temporary is defined by a LoadImm4 alone
+ */
+static bool get_const(Placement &p, Temp v, int &val) {
+    if (1 != defs_of(p, v) || Tac::LOAD_IMM4 != p.def[v->id]->op_code)
+        return false;
+
+    val = p.def[v->id]->op1.ival;
+    return true;
+}
+
+/* Tests whether a TAC computes an expression which may be moved.
+ *
+ * NOTE: a division is only moved when its divisor is a constant which
+ *       can neither trap nor overflow (see also tac/licm.cpp).
+ */
+static bool is_movable(Placement &p, Tac *t) {
+    int c;
+
+    switch (t->op_code) {
+    case Tac::ADD:
+    case Tac::SUB:
+    case Tac::MUL:
+    case Tac::SHL:
+    case Tac::SHR:
+    case Tac::SAR:
+    case Tac::MULH:
+    case Tac::EQU:
+    case Tac::NEQ:
+    case Tac::LES:
+    case Tac::LEQ:
+    case Tac::GTR:
+    case Tac::GEQ:
+    case Tac::LAND:
+    case Tac::LOR:
+    case Tac::SEL_NZ:
+    case Tac::SEL_Z:
+    case Tac::NEG:
+    case Tac::NOT:
+    case Tac::LNOT:
+    case Tac::BNOT:
+        return true;
+
+    case Tac::DIV:
+    case Tac::MOD:
+        return get_const(p, t->op2.var, c) && 0 != c && -1 != c;
+
+    default:
+        return false;
+    }
+}
+
+/* Tests whether an operator is commutative.
+ */
+static bool is_commutative(int k) {
+    switch (k) {
+    case Tac::ADD:
+    case Tac::MUL:
+    case Tac::MULH:
+    case Tac::EQU:
+    case Tac::NEQ:
+    case Tac::LAND:
+    case Tac::LOR:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+/* Finds the expression computed by a TAC.
+ *
+ * PARAMETERS:
+ *   p     - the state of the partial redundancy elimination
+ *   t     - the TAC
+ *   add   - whether to add the expression if it is new
+ * RETURNS:
+ *   the expression, or NULL if the TAC computes none (or a new one)
+ */
+static Expr *find_expr(Placement &p, Tac *t, bool add) {
+    Temp *slots[2];
+
+    if (!is_movable(p, t))
+        return NULL;
+
+    // the operands, constants and temporaries defined once
+    int n = t->getUseSlots(slots);
+    bool c[2] = {false, false};
+    int v[2] = {-1, -1};
+    for (int i = 0; i < n; ++i) {
+        if (get_const(p, *slots[i], v[i]))
+            c[i] = true;
+        else if (defs_of(p, *slots[i]) > 1)
+            return NULL;
+        else
+            v[i] = (*slots[i])->id;
+    }
+
+    int op = t->op_code;
+    if (Tac::GTR == op || Tac::GEQ == op ||
+        (is_commutative(op) && (c[0] > c[1] || (c[0] == c[1] && v[0] > v[1])))) {
+        // (a > b) is (b < a), and so on
+        if (Tac::GTR == op)
+            op = Tac::LES;
+        else if (Tac::GEQ == op)
+            op = Tac::LEQ;
+        bool x = c[0];
+        c[0] = c[1];
+        c[1] = x;
+        int y = v[0];
+        v[0] = v[1];
+        v[1] = y;
+    }
+
+    unsigned h = (unsigned)op * 0x9e3779b1u;
+    h = (h ^ (unsigned)v[0] ^ (c[0] ? 0x40000000u : 0)) * 0x85ebca6bu;
+    h = (h ^ (unsigned)v[1] ^ (c[1] ? 0x40000000u : 0)) * 0xc2b2ae35u;
+    h ^= h >> 15;
+
+    size_t mask = p.table.size() - 1;
+    size_t i = h & mask;
+    while (p.table[i] >= 0) {
+        Expr *e = p.exprs[p.table[i]];
+        if (e->op == op && e->c1 == c[0] && e->v1 == v[0] && e->c2 == c[1] &&
+            e->v2 == v[1])
+            return e;
+        i = (i + 1) & mask;
+    }
+    if (!add)
+        return NULL;
+
+    Expr *e = new Expr;
+    e->id = (int)p.exprs.size();
+    e->op = op;
+    e->c1 = c[0];
+    e->c2 = c[1];
+    e->v1 = v[0];
+    e->v2 = v[1];
+    e->sample = new Tac(*t); // (the TAC itself may be replaced)
+    e->sample->LiveOut = NULL;
+    e->holder = NULL;
+    p.exprs.push_back(e);
+    p.table[i] = e->id;
+
+    for (int k = 0; k < n; ++k)
+        if (!c[k])
+            p.users[v[k]].push_back(e->id);
+
+    return e;
+}
+
+/* Inserts a TAC before another one (or at the end of the block).
+ */
+static void insert_before(BasicBlock *b, Tac *pos, Tac *t) {
+    t->bb_num = b->bb_num;
+
+    if (NULL == pos) {
+        Tac *last = b->tac_chain;
+        while (NULL != last && NULL != last->next)
+            last = last->next;
+        t->prev = last;
+        t->next = NULL;
+        if (NULL == last)
+            b->tac_chain = t;
+        else
+            last->next = t;
+        return;
+    }
+
+    t->prev = pos->prev;
+    t->next = pos;
+    if (NULL == pos->prev)
+        b->tac_chain = t;
+    else
+        pos->prev->next = t;
+    pos->prev = t;
+}
+
+/* Removes a TAC from its block.
+ */
+static void unlink(BasicBlock *b, Tac *t) {
+    if (NULL == t->prev)
+        b->tac_chain = t->next;
+    else
+        t->prev->next = t->next;
+    if (NULL != t->next)
+        t->next->prev = t->prev;
+}
+
+/* Gets the successors of a block.
+ *
+ * RETURNS:
+ *   the number of successors
+ */
+static int successors(BasicBlock *b, int succ[2]) {
+    switch (b->end_kind) {
+    case BasicBlock::BY_JZERO:
+        succ[0] = b->next[0];
+        succ[1] = b->next[1];
+        return (succ[0] == succ[1]) ? 1 : 2;
+
+    case BasicBlock::BY_JUMP:
+        succ[0] = b->next[0];
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* Moves the partially redundant computations to where they are needed
+ * (lazy code motion).
+ *
+ * NOTE: the TACs should be in SSA form. The temporary holding an
+ *       expression is defined in several places (with the same value),
+ *       and it replaces the temporaries of the computations removed,
+ *       except for the PHI arguments, which get a copy of it instead.
+ */
+void FlowGraph::eliminatePartialRedundancies(void) {
+    Placement p;
+    int inserted = 0, removed = 0, count = 0;
+
+    p.g = this;
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            t->bb_num = i; // (the blocks may have been renumbered)
+            if (NULL != t->getDef())
+                set_def(p, t->getDef(), t);
+            ++count;
+        }
+    }
+    if ((size_t)_tempCount > p.def.size()) {
+        p.def.resize(_tempCount, NULL);
+        p.num_defs.resize(_tempCount, 0);
+        p.users.resize(_tempCount);
+    }
+
+    size_t size = 16;
+    while (size < 2 * (size_t)count + 16)
+        size *= 2;
+    p.table.resize(size, -1);
+    for (int i = 0; i < _n; ++i)
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next)
+            find_expr(p, t, true);
+
+    int m = (int)p.exprs.size();
+    if (0 == m) {
+        if (Option::showStats())
+            std::cerr << "pre: 0 expressions" << std::endl;
+        return;
+    }
+
+    // every edge into a join gets a block of its own
+    int blocks = _n;
+    computePredecessors();
+    for (int i = 0; i < blocks; ++i) {
+        Vector<int> preds = _bbs[i]->preds;
+        if (preds.size() < 2)
+            continue;
+        for (size_t k = 0; k < preds.size(); ++k)
+            splitEdge(preds[k], i);
+    }
+    int split = _n - blocks;
+    computeDominators();
+
+    // the blocks taking part (reachable), in reverse postorder
+    Vector<int> order, rpo;
+    computeReversePostorder(order);
+    for (size_t k = 0; k < order.size(); ++k)
+        if (_bbs[order[k]]->dom_pre >= 0)
+            rpo.push_back(order[k]);
+
+    // the blocks from which a RETURN is reachable
+    Vector<bool> to_exit;
+    Vector<int> stack;
+    to_exit.resize(_n, false);
+    for (size_t k = 0; k < rpo.size(); ++k) {
+        if (BasicBlock::BY_RETURN == _bbs[rpo[k]]->end_kind) {
+            to_exit[rpo[k]] = true;
+            stack.push_back(rpo[k]);
+        }
+    }
+    while (!stack.empty()) {
+        BasicBlock *b = _bbs[stack.back()];
+        stack.pop_back();
+        for (size_t k = 0; k < b->preds.size(); ++k) {
+            if (!to_exit[b->preds[k]]) {
+                to_exit[b->preds[k]] = true;
+                stack.push_back(b->preds[k]);
+            }
+        }
+    }
+
+    // the local sets (USE: computed before any kill)
+    ExprSet all(m);
+    for (int e = 0; e < m; ++e)
+        all.add(p.exprs[e]);
+
+    Vector<ExprSet *> use, kill;
+    use.resize(_n, NULL);
+    kill.resize(_n, NULL);
+    for (int i = 0; i < _n; ++i) {
+        use[i] = new ExprSet(m);
+        kill[i] = new ExprSet(m);
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            Expr *e = find_expr(p, t, false);
+            if (NULL != e && !kill[i]->contains(e))
+                use[i]->add(e);
+
+            Temp v = t->getDef();
+            if (NULL == v)
+                continue;
+            Vector<int> &u = p.users[v->id];
+            for (size_t k = 0; k < u.size(); ++k)
+                kill[i]->add(p.exprs[u[k]]);
+        }
+    }
+
+    Vector<ExprSet *> ant, avail, earliest, post, latest, used;
+    ant.resize(_n, NULL);
+    avail.resize(_n, NULL);
+    earliest.resize(_n, NULL);
+    post.resize(_n, NULL);
+    latest.resize(_n, NULL);
+    used.resize(_n, NULL);
+    for (int i = 0; i < _n; ++i) {
+        ant[i] = to_exit[i] ? all.clone() : new ExprSet(m);
+        avail[i] = all.clone(); // (at the exit)
+        earliest[i] = new ExprSet(m);
+        post[i] = all.clone(); // (at the exit)
+        latest[i] = new ExprSet(m);
+        used[i] = new ExprSet(m); // (at the entry)
+    }
+
+    ExprSet x(m), y(m);
+    int succ[2];
+    bool changed;
+
+    // ANTICIPATED (at the entry)
+    do {
+        changed = false;
+        for (int k = (int)rpo.size() - 1; k >= 0; --k) {
+            int i = rpo[k];
+            if (!to_exit[i])
+                continue;
+
+            int n = successors(_bbs[i], succ);
+            x.clear();
+            if (n > 0) {
+                x.assign(ant[succ[0]]);
+                for (int j = 1; j < n; ++j)
+                    x.retainAll(ant[succ[j]]);
+            }
+            x.removeAll(kill[i]);
+            x.addAll(use[i]);
+            if (!x.equal(ant[i])) {
+                ant[i]->assign(&x);
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    // AVAILABLE (at the exit), and EARLIEST
+    do {
+        changed = false;
+        for (size_t k = 0; k < rpo.size(); ++k) {
+            int i = rpo[k];
+            BasicBlock *b = _bbs[i];
+
+            x.clear();
+            bool first = true;
+            for (size_t j = 0; j < b->preds.size() && 0 != i; ++j) {
+                if (_bbs[b->preds[j]]->dom_pre < 0)
+                    continue;
+                if (first)
+                    x.assign(avail[b->preds[j]]);
+                else
+                    x.retainAll(avail[b->preds[j]]);
+                first = false;
+            }
+            earliest[i]->assign(ant[i]);
+            earliest[i]->removeAll(&x);
+
+            x.addAll(ant[i]);
+            x.removeAll(kill[i]);
+            if (!x.equal(avail[i])) {
+                avail[i]->assign(&x);
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    // POSTPONABLE (at the exit); "latest" holds EARLIEST + POSTPONABLE at
+    // the entry for now
+    do {
+        changed = false;
+        for (size_t k = 0; k < rpo.size(); ++k) {
+            int i = rpo[k];
+            BasicBlock *b = _bbs[i];
+
+            x.clear();
+            bool first = true;
+            for (size_t j = 0; j < b->preds.size() && 0 != i; ++j) {
+                if (_bbs[b->preds[j]]->dom_pre < 0)
+                    continue;
+                if (first)
+                    x.assign(post[b->preds[j]]);
+                else
+                    x.retainAll(post[b->preds[j]]);
+                first = false;
+            }
+            x.addAll(earliest[i]);
+            latest[i]->assign(&x);
+
+            x.removeAll(use[i]);
+            if (!x.equal(post[i])) {
+                post[i]->assign(&x);
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    // LATEST: no successor may take the computation over
+    for (size_t k = 0; k < rpo.size(); ++k) {
+        int i = rpo[k];
+        int n = successors(_bbs[i], succ);
+
+        x.assign(&all);
+        for (int j = 0; j < n; ++j)
+            x.retainAll(latest[succ[j]]);
+        y.assign(&all);
+        y.removeAll(&x);
+        y.addAll(use[i]);
+        earliest[i]->assign(latest[i]); // (reused as the final result)
+        earliest[i]->retainAll(&y);
+    }
+    for (size_t k = 0; k < rpo.size(); ++k)
+        latest[rpo[k]]->assign(earliest[rpo[k]]);
+
+    // USED (at the entry)
+    do {
+        changed = false;
+        for (int k = (int)rpo.size() - 1; k >= 0; --k) {
+            int i = rpo[k];
+            int n = successors(_bbs[i], succ);
+
+            x.clear();
+            for (int j = 0; j < n; ++j)
+                x.addAll(used[succ[j]]);
+            x.addAll(use[i]);
+            x.removeAll(latest[i]);
+            if (!x.equal(used[i])) {
+                used[i]->assign(&x);
+                changed = true;
+            }
+        }
+    } while (changed);
+
+    // the temporaries used by the PHIs keep their definitions
+    Vector<bool> phi_use;
+    phi_use.resize(_tempCount, false);
+    for (int i = 0; i < _n; ++i)
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next)
+            for (size_t k = 0; k < t->phi_args->size(); ++k)
+                phi_use[(*t->phi_args)[k]->id] = true;
+
+    Vector<Temp> repl;
+    Temp *slots[2];
+    repl.resize(_tempCount, NULL);
+    for (size_t k = 0; k < rpo.size(); ++k) {
+        int i = rpo[k];
+        BasicBlock *b = _bbs[i];
+        int n = successors(b, succ);
+
+        // USED at the exit
+        x.clear();
+        for (int j = 0; j < n; ++j)
+            x.addAll(used[succ[j]]);
+
+        // inserts the expressions LATEST here, and USED later
+        Tac *pos = b->tac_chain;
+        while (NULL != pos && Tac::PHI == pos->op_code)
+            pos = pos->next;
+        y.assign(latest[i]);
+        y.retainAll(&x);
+        for (ExprSet::iterator it = y.begin(); it != y.end(); ++it) {
+            Expr *e = *it;
+            if (NULL == e->holder)
+                e->holder = newTemp();
+
+            Tac *t = new Tac(*e->sample);
+            t->op0.var = e->holder;
+            int c = t->getUseSlots(slots);
+            for (int j = 0; j < c; ++j) {
+                int val;
+                if (get_const(p, *slots[j], val)) {
+                    Tac *l = Tac::LoadImm4(newTemp(), val);
+                    insert_before(b, pos, l);
+                    *slots[j] = l->op0.var;
+                }
+            }
+            insert_before(b, pos, t);
+            ++inserted;
+        }
+
+        // replaces the first computations, unless LATEST and not USED
+        y.assign(latest[i]);
+        y.removeAll(&x);
+        x.assign(use[i]);
+        x.removeAll(&y);
+        if (x.empty())
+            continue;
+
+        Tac *next = NULL;
+        y.clear(); // (the expressions killed so far)
+        for (Tac *t = pos; t != NULL; t = next) {
+            next = t->next;
+
+            Expr *e = find_expr(p, t, false);
+            if (NULL != e && x.contains(e) && !y.contains(e)) {
+                x.remove(e);
+                mind_assert(NULL != e->holder);
+                Temp v = t->op0.var;
+                if (phi_use[v->id]) {
+                    t->op_code = Tac::ASSIGN;
+                    t->op1.var = e->holder;
+                    t->op2.var = NULL;
+                } else {
+                    unlink(b, t);
+                    repl[v->id] = e->holder;
+                }
+                ++removed;
+                continue;
+            }
+
+            Temp v = t->getDef();
+            if (NULL == v || (size_t)v->id >= p.users.size())
+                continue;
+            Vector<int> &u = p.users[v->id];
+            for (size_t j = 0; j < u.size(); ++j)
+                y.add(p.exprs[u[j]]);
+        }
+    }
+
+    // the uses of the computations removed
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = t->getUseSlots(slots);
+            for (int j = 0; j < n; ++j)
+                if ((size_t)(*slots[j])->id < repl.size() &&
+                    NULL != repl[(*slots[j])->id])
+                    *slots[j] = repl[(*slots[j])->id];
+        }
+        if (BasicBlock::BY_JUMP != b->end_kind &&
+            (size_t)b->var->id < repl.size() && NULL != repl[b->var->id])
+            b->var = repl[b->var->id];
+    }
+
+    // removes the split blocks which stay empty
+    for (int i = blocks; i < _n; ++i) {
+        BasicBlock *s = _bbs[i];
+        if (NULL != s->tac_chain)
+            continue;
+
+        BasicBlock *from = _bbs[s->preds[0]];
+        BasicBlock *to = _bbs[s->next[0]];
+        for (int k = 0; k < 2; ++k)
+            if (from->next[k] == i)
+                from->next[k] = to->bb_num;
+        for (size_t k = 0; k < to->preds.size(); ++k)
+            if (to->preds[k] == i)
+                to->preds[k] = from->bb_num;
+        s->cancelled = true;
+    }
+    removeCancelledBlocks();
+
+    if (Option::showStats())
+        std::cerr << "pre: " << m << " expressions, " << split
+                  << " edges split, " << inserted << " inserted, " << removed
+                  << " redundant computations removed" << std::endl;
+}
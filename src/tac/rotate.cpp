@@ -0,0 +1,147 @@
+/*****************************************************
+ *  Loop Rotation.
+ *
+ *  This file contains the implementation of FlowGraph::rotateLoops.
+ *
+ *  A while loop (or a for loop) is translated with its test at the top
+ *
+ *      H:  c <- ...
+ *          if (c == 0) jump EXIT
+ *      B:  ...                    (the body)
+ *          jump H
+ *
+ *  so that every iteration runs a branch and a jump. The test is copied
+ *  into the latches instead:
+ *
+ *      H:  c <- ...               (the guard, run once)
+ *          if (c == 0) jump EXIT
+ *      B:  ...
+ *          c <- ...
+ *          if (c != 0) jump B
+ *
+ *  and B becomes the header of the loop. A "continue" jumps to H as a
+ *  latch does (or to a block jumping to H), so it gets the copy of the
+ *  test as well. The TACs are not in SSA form yet, so the copies share
+ *  the temporaries of H.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// the largest number of TACs in a test which is copied
+#define ROTATE_MAX_TACS 16
+
+/* Makes a copy of a TAC sequence.
+ *
+ * PARAMETERS:
+ *   t      - the first TAC
+ *   bb_num - the block of the copies
+ * RETURNS:
+ *   the first TAC of the copy (NULL if the sequence is empty)
+ */
+static Tac *copy_tacs(Tac *t, int bb_num) {
+    Tac *first = NULL, *last = NULL;
+    for (; t != NULL; t = t->next) {
+        Tac *x = new Tac(*t);
+        x->prev = last;
+        x->next = NULL;
+        x->LiveOut = NULL;
+        x->bb_num = bb_num;
+        if (NULL == last)
+            first = x;
+        else
+            last->next = x;
+        last = x;
+    }
+
+    return first;
+}
+
+/* Moves the tests of the loops to their latches.
+ *
+ * NOTE: a loop is rotated when its header ends with the test, which
+ *       goes either into the loop or out of it; the TACs should not be
+ *       in SSA form. A latch ending with a jump gets the test appended,
+ *       and the back edge of a branch goes to a copy of the header.
+ */
+void FlowGraph::rotateLoops(void) {
+    int rotated = 0, copied = 0;
+
+    findLoops();
+    Vector<bool> in_loop;
+    size_t num_loops = _loops.size();
+    for (size_t li = 0; li < num_loops; ++li) {
+        Loop *l = _loops[li];
+        BasicBlock *h = _bbs[l->header];
+        if (BasicBlock::BY_JZERO != h->end_kind)
+            continue;
+
+        in_loop.assign(_n, false);
+        for (size_t k = 0; k < l->blocks.size(); ++k)
+            in_loop[l->blocks[k]] = true;
+        if (in_loop[h->next[0]] == in_loop[h->next[1]] ||
+            h->next[0] == h->bb_num || h->next[1] == h->bb_num)
+            continue;
+
+        int size = 0;
+        for (Tac *t = h->tac_chain; t != NULL; t = t->next)
+            ++size;
+        if (size > ROTATE_MAX_TACS)
+            continue;
+
+        for (size_t k = 0; k < l->latches.size(); ++k) {
+            BasicBlock *b = _bbs[l->latches[k]];
+            Tac *test = copy_tacs(h->tac_chain, b->bb_num);
+
+            if (BasicBlock::BY_JUMP == b->end_kind) {
+                // "jump H" becomes the test
+                Tac *last = b->tac_chain;
+                while (NULL != last && NULL != last->next)
+                    last = last->next;
+                if (NULL == last)
+                    b->tac_chain = test;
+                else
+                    last->next = test;
+                if (NULL != test)
+                    test->prev = last;
+                b->end_kind = BasicBlock::BY_JZERO;
+                b->var = h->var;
+                b->next[0] = h->next[0];
+                b->next[1] = h->next[1];
+
+            } else {
+                BasicBlock *c = new BasicBlock();
+                c->bb_num = _n++;
+                c->end_kind = h->end_kind;
+                c->var = h->var;
+                c->next[0] = h->next[0];
+                c->next[1] = h->next[1];
+                c->tac_chain = test;
+                for (Tac *t = test; t != NULL; t = t->next)
+                    t->bb_num = c->bb_num;
+                _bbs.push_back(c);
+
+                for (int j = 0; j < 2; ++j)
+                    if (b->next[j] == h->bb_num)
+                        b->next[j] = c->bb_num;
+            }
+            ++copied;
+        }
+        ++rotated;
+    }
+
+    if (rotated > 0)
+        computePredecessors();
+
+    if (Option::showStats())
+        std::cerr << "rotate: " << rotated << " loops rotated, " << copied
+                  << " tests copied" << std::endl;
+}
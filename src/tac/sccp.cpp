@@ -0,0 +1,366 @@
+/*****************************************************
+ *  Conditional Constant Propagation.
+ *
+ *  This file contains the implementation of FlowGraph::propagateConstants.
+ *
+ *  Every temporary is mapped to a value of the lattice
+ *
+ *        TOP  (no value seen yet)
+ *         |
+ *     ... -1, 0, 1, 2 ...  (a known constant)
+ *         |
+ *      BOTTOM (not a constant)
+ *
+ *  at the entry of every block. Only the blocks and edges which have
+ *  been found executable take part in the propagation: a branch on a
+ *  known condition only makes one of its successors executable, so a
+ *  variable assigned in the other arm does not spoil the constant.
+ *
+ *  Reference: M. N. Wegman and F. K. Zadeck. Constant Propagation with
+ *             Conditional Branches. ACM TOPLAS 13(2), 1991.
+ *             (the CFG version of it, since our TAC is not in SSA form)
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// the lattice
+enum { TOP, CONST, BOTTOM };
+
+struct Cell {
+    int state; // TOP, CONST or BOTTOM
+    int val;   // the value (for CONST)
+};
+
+typedef Vector<Cell> Cells; // a cell for every temporary (by id)
+
+/* Meets a cell into another one.
+ *
+ * RETURNS:
+ *   whether "x" has changed
+ */
+static bool meet(Cell &x, const Cell &y) {
+    if (BOTTOM == x.state || TOP == y.state)
+        return false;
+
+    if (TOP == x.state) {
+        x = y;
+        return true;
+    }
+
+    if (CONST == y.state && x.val == y.val)
+        return false;
+
+    x.state = BOTTOM;
+    return true;
+}
+
+/* Gets the cell of a temporary.
+ */
+static Cell &cell_of(Cells &c, Temp v) {
+    mind_assert(NULL != v && (size_t)v->id < c.size());
+
+    return c[v->id];
+}
+
+/* Computes the value defined by a TAC.
+ *
+ * PARAMETERS:
+ *   t     - the TAC
+ *   c     - the values of the temporaries before "t"
+ * RETURNS:
+ *   the value of the temporary defined by "t"
+ */
+static Cell evaluate(Tac *t, Cells &c) {
+    Cell r, a, b;
+    r.state = BOTTOM;
+    r.val = 0;
+
+    switch (t->op_code) {
+    case Tac::LOAD_IMM4:
+        r.state = CONST;
+        r.val = t->op1.ival;
+        return r;
+
+    case Tac::POP:
+        return r;
+
+    case Tac::ASSIGN:
+    case Tac::NEG:
+    case Tac::NOT:
+    case Tac::LNOT:
+    case Tac::BNOT:
+        a = cell_of(c, t->op1.var);
+        if (CONST == a.state && t->evaluate(a.val, 0, r.val))
+            r.state = CONST;
+        else if (TOP == a.state)
+            r.state = TOP;
+        return r;
+
+    default:
+        break;
+    }
+
+    a = cell_of(c, t->op1.var);
+    b = cell_of(c, t->op2.var);
+
+    // a known operand may decide the result alone
+    if ((CONST == a.state && 0 == a.val) || (CONST == b.state && 0 == b.val)) {
+        if (Tac::MUL == t->op_code || Tac::MULH == t->op_code ||
+            Tac::LAND == t->op_code) {
+            r.state = CONST;
+            return r;
+        }
+    }
+    if ((CONST == a.state && 0 != a.val) || (CONST == b.state && 0 != b.val)) {
+        if (Tac::LOR == t->op_code) {
+            r.state = CONST;
+            r.val = 1;
+            return r;
+        }
+    }
+    if (Tac::SEL_NZ == t->op_code || Tac::SEL_Z == t->op_code) {
+        // a zero value, or a condition dropping the value, gives zero
+        bool drops = CONST == a.state &&
+                     ((0 == a.val) == (Tac::SEL_NZ == t->op_code));
+        if (drops || (CONST == b.state && 0 == b.val)) {
+            r.state = CONST;
+            return r;
+        }
+    }
+
+    if (CONST == a.state && CONST == b.state) {
+        if (t->evaluate(a.val, b.val, r.val))
+            r.state = CONST;
+    } else if (BOTTOM != a.state && BOTTOM != b.state) {
+        r.state = TOP;
+    }
+
+    return r;
+}
+
+/* Passes a TAC.
+ *
+ * PARAMETERS:
+ *   t     - the TAC
+ *   c     - the values before "t" (then, the values after "t")
+ */
+static void transfer(Tac *t, Cells &c) {
+    Temp v = t->getDef();
+
+    if (NULL != v)
+        cell_of(c, v) = evaluate(t, c);
+}
+
+/* Turns a TAC into a LoadImm4.
+ */
+static void make_load_imm4(Tac *t, int val) {
+    t->op_code = Tac::LOAD_IMM4;
+    t->op1.var = t->op2.var = NULL;
+    t->op1.ival = val;
+}
+
+/* Inserts a TAC before another one in the TAC chain of a block.
+ *
+ * PARAMETERS:
+ *   b     - the basic block
+ *   pos   - the TAC to precede (NULL: at the end of the block)
+ *   t     - the new TAC
+ */
+static void insert_before(BasicBlock *b, Tac *pos, Tac *t) {
+    t->bb_num = b->bb_num;
+
+    if (NULL == pos) {
+        Tac *last = b->tac_chain;
+        while (NULL != last && NULL != last->next)
+            last = last->next;
+        t->prev = last;
+        t->next = NULL;
+        if (NULL == last)
+            b->tac_chain = t;
+        else
+            last->next = t;
+        return;
+    }
+
+    t->prev = pos->prev;
+    t->next = pos;
+    if (NULL == pos->prev)
+        b->tac_chain = t;
+    else
+        pos->prev->next = t;
+    pos->prev = t;
+}
+
+/* Propagates the constants through the flow graph, and simplifies it.
+ *
+ * NOTE: the following transformations are done:
+ *   1. a TAC computing a constant becomes a LoadImm4;
+ *   2. a constant coming from another block is reloaded by a LoadImm4
+ *      right before its use (so the instruction selector sees it);
+ *   3. an END-BY-JZERO block with a constant condition becomes an
+ *      END-BY-JUMP block;
+ *   4. the blocks which are never executed are removed.
+ *   The variables have no known value at the entry of the function.
+ */
+void FlowGraph::propagateConstants(void) {
+    Vector<Cells *> in; // values at the entry (NULL: unreached)
+    Vector<bool> queued;
+    Vector<int> order;
+    Cells cur;
+    Cell bottom;
+    bottom.state = BOTTOM;
+    bottom.val = 0;
+
+    // values are indexed by the temporary id
+    computeReversePostorder(order);
+    in.resize(_n, NULL);
+    queued.resize(_n, false);
+    in[0] = new Cells();
+    in[0]->resize(_tempCount, bottom);
+    queued[0] = true;
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        for (size_t k = 0; k < order.size(); ++k) {
+            BasicBlock *b = _bbs[order[k]];
+            if (!queued[b->bb_num])
+                continue;
+            queued[b->bb_num] = false;
+            changed = true;
+
+            cur = *in[b->bb_num];
+            for (Tac *t = b->tac_chain; t != NULL; t = t->next)
+                transfer(t, cur);
+
+            // the executable successors
+            int succ[2], n = 0;
+            if (BasicBlock::BY_JUMP == b->end_kind) {
+                succ[n++] = b->next[0];
+            } else if (BasicBlock::BY_JZERO == b->end_kind) {
+                Cell &cond = cell_of(cur, b->var);
+                if (CONST == cond.state) {
+                    succ[n++] = b->next[0 == cond.val ? 0 : 1];
+                } else {
+                    succ[n++] = b->next[0];
+                    succ[n++] = b->next[1];
+                }
+            }
+
+            for (int i = 0; i < n; ++i) {
+                int s = succ[i];
+                bool grew = false;
+                if (NULL == in[s]) {
+                    in[s] = new Cells(cur);
+                    grew = true;
+                } else {
+                    for (size_t j = 0; j < cur.size(); ++j)
+                        grew = meet((*in[s])[j], cur[j]) || grew;
+                }
+                if (grew)
+                    queued[s] = true;
+            }
+        }
+    }
+
+    // rewrites the reachable blocks
+    int folded = 0, reloaded = 0, resolved = 0, removed = 0;
+    size_t num_temps = _tempCount;
+    Vector<int> local;       // last block defining the temp
+    Vector<Temp> reload;     // the reloaded copy of a constant
+    Vector<int> reloaded_in; // ... made in which block
+    local.resize(num_temps, -1);
+    reload.resize(num_temps, NULL);
+    reloaded_in.resize(num_temps, -1);
+
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        if (NULL == in[i]) {
+            b->cancelled = true;
+            ++removed;
+            continue;
+        }
+
+        cur = *in[i];
+        Temp uses[2];
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            Temp v = t->getDef();
+            if (Tac::LOAD_IMM4 == t->op_code) {
+                transfer(t, cur);
+                local[v->id] = i;
+                continue;
+            }
+
+            Cell r;
+            r.state = BOTTOM;
+            if (NULL != v)
+                r = evaluate(t, cur);
+            if (CONST == r.state) {
+                make_load_imm4(t, r.val);
+                ++folded;
+
+            } else {
+                // the constants from other blocks are reloaded here
+                int nu = t->getUses(uses);
+                for (int j = 0; j < nu; ++j) {
+                    Temp u = uses[j];
+                    if ((size_t)u->id >= num_temps || local[u->id] == i ||
+                        CONST != cell_of(cur, u).state)
+                        continue;
+
+                    if (reloaded_in[u->id] != i) {
+                        reload[u->id] = newTemp();
+                        reloaded_in[u->id] = i;
+                        insert_before(b, t, Tac::LoadImm4(reload[u->id],
+                                                          cell_of(cur, u).val));
+                        ++reloaded;
+                    }
+                    if (Tac::PUSH == t->op_code && t->op0.var == u)
+                        t->op0.var = reload[u->id];
+                    if (t->op1.var == u)
+                        t->op1.var = reload[u->id];
+                    if (t->op2.var == u)
+                        t->op2.var = reload[u->id];
+                }
+            }
+
+            if (NULL != v) {
+                cell_of(cur, v) = r;
+                local[v->id] = i;
+            }
+        }
+
+        if (BasicBlock::BY_JZERO == b->end_kind &&
+            CONST == cell_of(cur, b->var).state) {
+            int target = b->next[0 == cell_of(cur, b->var).val ? 0 : 1];
+            b->end_kind = BasicBlock::BY_JUMP;
+            b->next[0] = b->next[1] = target;
+            ++resolved;
+
+        } else if (BasicBlock::BY_RETURN == b->end_kind &&
+                   CONST == cell_of(cur, b->var).state &&
+                   local[b->var->id] != i) {
+            Temp v = newTemp();
+            insert_before(b, NULL, Tac::LoadImm4(v, cell_of(cur, b->var).val));
+            b->var = v;
+            ++reloaded;
+        }
+    }
+
+    removeCancelledBlocks();
+
+    if (Option::showStats())
+        std::cerr << "sccp: " << folded << " folded, " << reloaded
+                  << " reloaded, " << resolved << " branches resolved, "
+                  << removed << " blocks removed" << std::endl;
+}
@@ -0,0 +1,287 @@
+/*****************************************************
+ *  Live Range Splitting around Loops.
+ *
+ *  This file contains the implementation of FlowGraph::splitAroundLoops
+ *  and FlowGraph::joinRanges.
+ *
+ *  A variable referenced inside an innermost loop is renamed there:
+ *
+ *      preheader:  v' <- v        (if v is alive at the header)
+ *      loop:       ... v' ...     (every use and definition of v)
+ *      exit:       v <- v'        (if v is alive after the exit)
+ *
+ *  so that the register allocator sees a short live range covering the
+ *  loop, apart from the rest of the live range of v. When v has been
+ *  spilled, v' may still get a register, and the copies are executed
+ *  once per entry and exit of the loop instead of a memory access per
+ *  use. A variable is only split if it is referenced in the loop more
+ *  often than it is copied. The edge entering the loop, and an exit edge
+ *  whose target has other predecessors, are split when necessary, so
+ *  that the copies are only executed when entering or leaving the loop.
+ *  A piece which gets no register either is joined back afterwards.
+ *
+ *  Reference: K. D. Cooper and L. T. Simpson. Live Range Splitting in a
+ *             Graph Coloring Register Allocator. CC 1998.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// how many references inside a loop should pay for a copy
+#define SPLIT_MIN_GAIN 1
+
+/* Appends a TAC to the TAC chain of a block.
+ */
+static void append(BasicBlock *b, Tac *t) {
+    t->bb_num = b->bb_num;
+    t->next = NULL;
+    t->prev = NULL;
+
+    Tac *last = b->tac_chain;
+    while (NULL != last && NULL != last->next)
+        last = last->next;
+    if (NULL == last) {
+        b->tac_chain = t;
+    } else {
+        last->next = t;
+        t->prev = last;
+    }
+}
+
+/* Inserts a TAC at the beginning of the TAC chain of a block.
+ */
+static void prepend(BasicBlock *b, Tac *t) {
+    t->bb_num = b->bb_num;
+    t->prev = NULL;
+    t->next = b->tac_chain;
+    if (NULL != b->tac_chain)
+        b->tac_chain->prev = t;
+    b->tac_chain = t;
+}
+
+/* Renames a variable in a block.
+ */
+static void rename(BasicBlock *b, Temp v, Temp w) {
+    Temp *slots[2];
+
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+        int n = t->getUseSlots(slots);
+        for (int k = 0; k < n; ++k)
+            if (*slots[k] == v)
+                *slots[k] = w;
+        if (t->getDef() == v)
+            t->op0.var = w;
+    }
+    if (BasicBlock::BY_JUMP != b->end_kind && b->var == v)
+        b->var = w;
+}
+
+/* Inserts an empty block on an edge, alive as its target.
+ *
+ * RETURNS:
+ *   number of the new block
+ * NOTE: the liveness of the new block is needed for the loops after.
+ */
+static int split_edge(FlowGraph *g, int from, int to) {
+    int s = g->splitEdge(from, to);
+    g->getBlock(s)->LiveIn->assign(g->getBlock(to)->LiveIn);
+    g->getBlock(s)->LiveOut->assign(g->getBlock(to)->LiveIn);
+
+    return s;
+}
+
+/* Counts a reference to a variable which may be split.
+ *
+ * PARAMETERS:
+ *   v     - the variable referenced (may be NULL)
+ *   vars  - the variables whose live ranges may be split
+ *   bound - the variables alive at the loop boundary
+ *   refs  - how many times a variable is referenced (by id)
+ *   cands - the variables referenced so far
+ */
+static void count_ref(Temp v, BitSet<Temp> *vars, BitSet<Temp> *bound,
+                      Vector<int> &refs, Vector<Temp> &cands) {
+    if (NULL == v || !vars->contains(v) || !bound->contains(v))
+        return;
+
+    if ((size_t)v->id >= refs.size())
+        refs.resize(v->id + 1, 0);
+    if (0 == refs[v->id]++)
+        cands.push_back(v);
+}
+
+/* Splits the live ranges of some variables around the innermost loops.
+ *
+ * PARAMETERS:
+ *   vars  - the variables whose live ranges may be split
+ *   orig  - receives the variables split (once per loop)
+ *   piece - receives the new variables used inside the loops (in the
+ *           same order as "orig")
+ * RETURNS:
+ *   how many live ranges have been split
+ * NOTE: the TACs should not be in SSA form, and the liveness should have
+ *       been analyzed (it has to be analyzed again afterwards).
+ */
+int FlowGraph::splitAroundLoops(BitSet<Temp> *vars, Vector<Temp> &orig,
+                                Vector<Temp> &piece) {
+    Vector<int> num_refs; // references inside the loop (by id)
+    Temp refd[3];
+    int splits = 0, loops = 0;
+
+    findLoops();
+
+    // an innermost loop contains no other loop
+    Vector<bool> inner;
+    inner.resize(_loops.size(), true);
+    for (size_t l = 0; l < _loops.size(); ++l)
+        if (_loops[l]->parent >= 0)
+            inner[_loops[l]->parent] = false;
+
+    for (size_t l = 0; l < _loops.size(); ++l) {
+        Loop *loop = _loops[l];
+        if (!inner[l] || 0 == loop->header)
+            continue;
+
+        // the edge entering the loop (where the preheader goes)
+        BasicBlock *header = _bbs[loop->header];
+        int entering = -1, num_entering = 0;
+        for (size_t k = 0; k < header->preds.size(); ++k)
+            if (!dominates(loop->header, header->preds[k])) {
+                entering = header->preds[k];
+                ++num_entering;
+            }
+        if (1 != num_entering)
+            continue;
+
+        Vector<bool> in_loop;
+        in_loop.resize(_n, false);
+        for (size_t k = 0; k < loop->blocks.size(); ++k)
+            in_loop[loop->blocks[k]] = true;
+
+        // the exit edges
+        Vector<int> from, to;
+        BitSet<Temp> *boundary = header->LiveIn->clone();
+        for (size_t k = 0; k < loop->blocks.size(); ++k) {
+            BasicBlock *b = _bbs[loop->blocks[k]];
+            if (BasicBlock::BY_RETURN == b->end_kind)
+                continue;
+            for (int j = 0; j < 2; ++j) {
+                int s = b->next[j];
+                if (in_loop[s] || (1 == j && s == b->next[0]))
+                    continue;
+                from.push_back(b->bb_num);
+                to.push_back(s);
+                boundary->addAll(_bbs[s]->LiveIn);
+            }
+        }
+
+        // the variables referenced inside, and alive at the boundary
+        Vector<Temp> cands;
+        for (size_t k = 0; k < loop->blocks.size(); ++k) {
+            BasicBlock *b = _bbs[loop->blocks[k]];
+            for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+                int n = t->getUses(refd);
+                refd[n++] = t->getDef();
+                for (int j = 0; j < n; ++j)
+                    count_ref(refd[j], vars, boundary, num_refs, cands);
+            }
+            if (BasicBlock::BY_JUMP != b->end_kind)
+                count_ref(b->var, vars, boundary, num_refs, cands);
+        }
+
+        // a variable should be referenced more often than it is copied
+        BitSet<Temp> *refs = new BitSet<Temp>();
+        for (size_t k = 0; k < cands.size(); ++k) {
+            Temp v = cands[k];
+            int copies = header->LiveIn->contains(v) ? 1 : 0;
+            for (size_t j = 0; j < to.size(); ++j)
+                if (_bbs[to[j]]->LiveIn->contains(v))
+                    ++copies;
+            if (num_refs[v->id] > SPLIT_MIN_GAIN * copies)
+                refs->add(v);
+            num_refs[v->id] = 0;
+        }
+        if (refs->empty())
+            continue;
+
+        // the blocks receiving the copies on the entering and exit edges
+        int preheader = entering;
+        if (BasicBlock::BY_JUMP != _bbs[entering]->end_kind)
+            preheader = split_edge(this, entering, loop->header);
+        Vector<int> exits;
+        Vector<BitSet<Temp> *> live;
+        for (size_t k = 0; k < to.size(); ++k) {
+            BitSet<Temp> *out = _bbs[to[k]]->LiveIn->clone();
+            out->retainAll(refs);
+            if (out->empty())
+                continue;
+            int s = to[k];
+            if (_bbs[s]->preds.size() > 1)
+                s = split_edge(this, from[k], s);
+            exits.push_back(s);
+            live.push_back(out);
+        }
+
+        for (BitSet<Temp>::iterator it = refs->begin(); it != refs->end();
+             ++it) {
+            Temp v = *it, w = newTemp();
+            orig.push_back(v);
+            piece.push_back(w);
+            for (size_t k = 0; k < loop->blocks.size(); ++k)
+                rename(_bbs[loop->blocks[k]], v, w);
+            if (header->LiveIn->contains(v))
+                append(_bbs[preheader], Tac::Assign(w, v));
+            for (size_t k = 0; k < exits.size(); ++k)
+                if (live[k]->contains(v))
+                    prepend(_bbs[exits[k]], Tac::Assign(v, w));
+            ++splits;
+        }
+        ++loops;
+    }
+
+    if (Option::showStats())
+        std::cerr << "live range splitting: " << splits << " ranges split in "
+                  << loops << " loops" << std::endl;
+
+    return splits;
+}
+
+/* Joins some pieces of live ranges back into the original variables.
+ *
+ * PARAMETERS:
+ *   orig  - the original variables
+ *   piece - the pieces made by FlowGraph::splitAroundLoops (in the same
+ *           order as "orig")
+ * NOTE: the copies between a piece and its original variable are
+ *       removed (the blocks made for them are left empty).
+ */
+void FlowGraph::joinRanges(Vector<Temp> &orig, Vector<Temp> &piece) {
+    for (size_t k = 0; k < piece.size(); ++k)
+        for (int i = 0; i < _n; ++i)
+            rename(_bbs[i], piece[k], orig[k]);
+
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        Tac *t = b->tac_chain;
+        while (NULL != t) {
+            Tac *next = t->next;
+            if (Tac::ASSIGN == t->op_code && t->op0.var == t->op1.var) {
+                if (NULL == t->prev)
+                    b->tac_chain = next;
+                else
+                    t->prev->next = next;
+                if (NULL != next)
+                    next->prev = t->prev;
+            }
+            t = next;
+        }
+    }
+}
@@ -0,0 +1,582 @@
+/*****************************************************
+ *  Static Single Assignment Form.
+ *
+ *  This file contains the implementation of the following 2 functions:
+ *  1. FlowGraph::buildSSA   (into pruned SSA form)
+ *  2. FlowGraph::destroySSA (out of SSA form)
+ *
+ *  In SSA form, every temporary is defined by at most one TAC. A
+ *  temporary without any definition holds its value from the entry
+ *  of the function. A PHI takes one argument per predecessor of its
+ *  block (in the order of BasicBlock::preds), and all the PHIs of a
+ *  block are placed before the other TACs, taking effect in parallel.
+ *
+ *  Reference: R. Cytron et al. Efficiently Computing Static Single
+ *             Assignment Form and the Control Dependence Graph.
+ *             ACM TOPLAS 13(4), 1991.
+ *             Z. Budimlic et al. Fast Copy Coalescing and Live-Range
+ *             Identification. PLDI 2002.
+ *             B. Boissinot et al. Revisiting Out-of-SSA Translation for
+ *             Correctness, Code Quality, and Efficiency. CGO 2009.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* Gets the first TAC after the PHIs of a block.
+ */
+static Tac *first_non_phi(BasicBlock *b) {
+    Tac *t = b->tac_chain;
+    while (NULL != t && Tac::PHI == t->op_code)
+        t = t->next;
+
+    return t;
+}
+
+/* Inserts a TAC at the beginning of a block.
+ */
+static void prepend(BasicBlock *b, Tac *t) {
+    t->bb_num = b->bb_num;
+    t->prev = NULL;
+    t->next = b->tac_chain;
+    if (NULL != b->tac_chain)
+        b->tac_chain->prev = t;
+    b->tac_chain = t;
+}
+
+/* Inserts a TAC at the end of a block.
+ */
+static void append(BasicBlock *b, Tac *t) {
+    Tac *last = b->tac_chain;
+    while (NULL != last && NULL != last->next)
+        last = last->next;
+
+    t->bb_num = b->bb_num;
+    t->prev = last;
+    t->next = NULL;
+    if (NULL == last)
+        b->tac_chain = t;
+    else
+        last->next = t;
+}
+
+/* State of the renaming walk (see rename_block).
+ */
+struct Renaming {
+    FlowGraph *g;
+    Vector<bool> renamed;           // whether a temp (by id) gets versions
+    Vector<Vector<Temp> > versions; // the stack of versions of every temp
+    Vector<Temp> origin;            // the temp of every id
+};
+
+/* Gets the current version of a temporary.
+ */
+static Temp current_version(Renaming &r, Temp v) {
+    if (NULL == v || (size_t)v->id >= r.renamed.size() || !r.renamed[v->id] ||
+        r.versions[v->id].empty())
+        return v; // (the value from the entry of the function)
+
+    return r.versions[v->id].back();
+}
+
+/* Renames the temporaries in a block and (recursively) in the blocks it
+ * immediately dominates.
+ *
+ * PARAMETERS:
+ *   r     - the renaming state
+ *   b     - the basic block
+ */
+static void rename_block(Renaming &r, BasicBlock *b) {
+    Vector<int> pushed; // the ids whose stacks get a new version here
+    Temp *slots[2];
+
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+        if (Tac::PHI != t->op_code) {
+            int n = t->getUseSlots(slots);
+            for (int i = 0; i < n; ++i)
+                *slots[i] = current_version(r, *slots[i]);
+        }
+
+        Temp v = t->getDef();
+        if (NULL != v && r.renamed[v->id]) {
+            Temp x = r.g->newTemp();
+            r.versions[v->id].push_back(x);
+            pushed.push_back(v->id);
+            t->op0.var = x;
+        }
+    }
+
+    if (BasicBlock::BY_JUMP != b->end_kind)
+        b->var = current_version(r, b->var);
+
+    // fills in the PHI arguments of the successors
+    for (int k = 0; k < 2; ++k) {
+        if (BasicBlock::BY_RETURN == b->end_kind ||
+            (1 == k && b->next[1] == b->next[0]))
+            break;
+
+        BasicBlock *s = r.g->getBlock(b->next[k]);
+        size_t j = 0;
+        while (j < s->preds.size() && s->preds[j] != b->bb_num)
+            ++j;
+        mind_assert(j < s->preds.size());
+
+        // (Tac::mark of a PHI holds the id of the original temp)
+        for (Tac *t = s->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next)
+            (*t->phi_args)[j] = current_version(r, r.origin[t->mark]);
+    }
+
+    for (size_t i = 0; i < b->dom_children.size(); ++i)
+        rename_block(r, r.g->getBlock(b->dom_children[i]));
+
+    for (size_t i = 0; i < pushed.size(); ++i)
+        r.versions[pushed[i]].pop_back();
+}
+
+/* Converts the TACs into pruned SSA form.
+ *
+ * NOTE: a temporary defined only once, and not alive at the entry, is
+ *       already in SSA form and keeps its name. The others get a new
+ *       version at every definition, and a PHI is placed in the
+ *       iterated dominance frontier of their definitions wherever
+ *       they are alive (according to FlowGraph::analyzeLiveness).
+ */
+void FlowGraph::buildSSA(void) {
+    // the entry block must not be the target of any edge
+    computePredecessors();
+    if (!_bbs[0]->preds.empty()) {
+        BasicBlock *e = new BasicBlock();
+        e->end_kind = BasicBlock::BY_JUMP;
+        _bbs.insert(_bbs.begin(), e);
+        ++_n;
+        for (int i = 0; i < _n; ++i) {
+            _bbs[i]->bb_num = i;
+            if (i > 0 && BasicBlock::BY_RETURN != _bbs[i]->end_kind) {
+                ++_bbs[i]->next[0];
+                ++_bbs[i]->next[1];
+            }
+        }
+        e->next[0] = e->next[1] = 1;
+    }
+
+    analyzeLiveness();
+    computeDominators();
+    computeDominanceFrontiers();
+
+    // finds the temporaries to be renamed
+    Renaming r;
+    Vector<int> num_defs;
+    Vector<Vector<int> > def_blocks;
+    r.g = this;
+    r.renamed.resize(_tempCount, false);
+    r.versions.resize(_tempCount);
+    r.origin.resize(_tempCount, NULL);
+    num_defs.resize(_tempCount, 0);
+    def_blocks.resize(_tempCount);
+
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            Temp v = t->getDef();
+            if (NULL == v)
+                continue;
+
+            r.origin[v->id] = v;
+            ++num_defs[v->id];
+            Vector<int> &db = def_blocks[v->id];
+            if (db.empty() || db.back() != i)
+                db.push_back(i);
+        }
+    }
+
+    int num_renamed = 0, num_phis = 0;
+    for (int id = 0; id < _tempCount; ++id) {
+        if (num_defs[id] > 1 ||
+            (num_defs[id] > 0 && _bbs[0]->LiveIn->contains(r.origin[id]))) {
+            r.renamed[id] = true;
+            ++num_renamed;
+        }
+    }
+
+    // places the PHIs (only where the temporary is alive)
+    Vector<int> has_phi, on_worklist, worklist;
+    has_phi.resize(_n, -1);
+    on_worklist.resize(_n, -1);
+
+    for (int id = 0; id < _tempCount; ++id) {
+        if (!r.renamed[id])
+            continue;
+
+        Temp v = r.origin[id];
+        worklist = def_blocks[id];
+        for (size_t k = 0; k < worklist.size(); ++k)
+            on_worklist[worklist[k]] = id;
+
+        while (!worklist.empty()) {
+            BasicBlock *x = _bbs[worklist.back()];
+            worklist.pop_back();
+
+            for (size_t k = 0; k < x->frontier.size(); ++k) {
+                BasicBlock *y = _bbs[x->frontier[k]];
+                if (has_phi[y->bb_num] == id || !y->LiveIn->contains(v))
+                    continue;
+
+                Tac *phi = Tac::Phi(v, y->preds.size());
+                phi->mark = id;
+                prepend(y, phi);
+                has_phi[y->bb_num] = id;
+                ++num_phis;
+
+                if (on_worklist[y->bb_num] != id) {
+                    on_worklist[y->bb_num] = id;
+                    worklist.push_back(y->bb_num);
+                }
+            }
+        }
+    }
+
+    rename_block(r, _bbs[0]);
+
+    if (Option::showStats())
+        std::cerr << "ssa: " << num_renamed << " temps renamed, " << num_phis
+                  << " phis" << std::endl;
+}
+
+/* State of the out-of-SSA translation.
+ */
+struct Destruction {
+    FlowGraph *g;
+    Vector<Tac *> def;  // the defining TAC of every temp (by id)
+    Vector<int> parent; // union-find forest of the temps (by id)
+    Vector<Vector<Temp> > members; // the members of every web (by root)
+};
+
+/* Marks a temporary alive at the entry of a block (and, backwards, at
+ * the exit of the predecessors up to its definition).
+ */
+static void mark_live_in(Destruction &d, BasicBlock *b, Temp v) {
+    Vector<BasicBlock *> stack;
+    stack.push_back(b);
+
+    while (!stack.empty()) {
+        BasicBlock *x = stack.back();
+        stack.pop_back();
+        if (x->LiveIn->contains(v))
+            continue;
+        x->LiveIn->add(v);
+
+        for (size_t k = 0; k < x->preds.size(); ++k) {
+            BasicBlock *p = d.g->getBlock(x->preds[k]);
+            if (p->LiveOut->contains(v))
+                continue;
+            p->LiveOut->add(v);
+            if (NULL == d.def[v->id] || d.def[v->id]->bb_num != p->bb_num)
+                stack.push_back(p);
+        }
+    }
+}
+
+/* Computes the LiveIn and LiveOut sets of the blocks in SSA form.
+ *
+ * NOTE: a PHI argument is alive at the exit of the corresponding
+ *       predecessor, but not at the entry of the PHI's block.
+ */
+static void analyze_ssa_liveness(Destruction &d) {
+    FlowGraph *g = d.g;
+    Temp uses[2];
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        (*it)->LiveIn->clear();
+        (*it)->LiveOut->clear();
+    }
+
+    for (FlowGraph::iterator it = g->begin(); it != g->end(); ++it) {
+        BasicBlock *b = *it;
+
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            if (Tac::PHI == t->op_code) {
+                for (size_t k = 0; k < t->phi_args->size(); ++k) {
+                    Temp v = (*t->phi_args)[k];
+                    BasicBlock *p = g->getBlock(b->preds[k]);
+                    if (p->LiveOut->contains(v))
+                        continue;
+                    p->LiveOut->add(v);
+                    if (NULL == d.def[v->id] ||
+                        d.def[v->id]->bb_num != p->bb_num)
+                        mark_live_in(d, p, v);
+                }
+                continue;
+            }
+
+            int n = t->getUses(uses);
+            for (int i = 0; i < n; ++i) {
+                Tac *x = d.def[uses[i]->id];
+                if (NULL == x || x->bb_num != b->bb_num || x->mark >= t->mark)
+                    mark_live_in(d, b, uses[i]);
+            }
+        }
+
+        if (BasicBlock::BY_JUMP != b->end_kind) {
+            Tac *x = d.def[b->var->id];
+            if (NULL == x || x->bb_num != b->bb_num)
+                mark_live_in(d, b, b->var);
+        }
+    }
+}
+
+/* Tests whether a temporary is alive right after the definition of
+ * another one.
+ *
+ * PARAMETERS:
+ *   d     - the out-of-SSA state
+ *   x     - the temporary to test
+ *   y     - the temporary whose definition is the point
+ */
+static bool live_after_def(Destruction &d, Temp x, Temp y) {
+    Tac *dy = d.def[y->id];
+    BasicBlock *b = d.g->getBlock(NULL == dy ? 0 : dy->bb_num);
+    Temp uses[2];
+
+    // (a PHI takes effect together with the other PHIs)
+    Tac *t = (NULL == dy) ? b->tac_chain : dy->next;
+    if (NULL == dy || Tac::PHI == dy->op_code) {
+        if (NULL == dy && b->LiveIn->contains(x))
+            return true;
+        t = first_non_phi(b);
+    }
+
+    for (; t != NULL; t = t->next) {
+        int n = t->getUses(uses);
+        for (int i = 0; i < n; ++i)
+            if (uses[i] == x)
+                return true;
+        if (t->getDef() == x)
+            return false;
+    }
+
+    if (BasicBlock::BY_JUMP != b->end_kind && b->var == x)
+        return true;
+
+    return b->LiveOut->contains(x);
+}
+
+/* Gets the root of the web of a temporary.
+ */
+static int find_web(Destruction &d, int id) {
+    while (d.parent[id] != id) {
+        d.parent[id] = d.parent[d.parent[id]];
+        id = d.parent[id];
+    }
+
+    return id;
+}
+
+/* Tests whether two webs interfere (some of their members are alive at
+ * the same time).
+ */
+static bool webs_interfere(Destruction &d, int a, int b) {
+    Vector<Temp> &x = d.members[a], &y = d.members[b];
+
+    for (size_t i = 0; i < x.size(); ++i) {
+        for (size_t j = 0; j < y.size(); ++j) {
+            // (the PHIs of a block are assigned at the same time)
+            Tac *dx = d.def[x[i]->id], *dy = d.def[y[j]->id];
+            if (NULL != dx && NULL != dy && Tac::PHI == dx->op_code &&
+                Tac::PHI == dy->op_code && dx->bb_num == dy->bb_num)
+                return true;
+
+            if (live_after_def(d, x[i], y[j]) || live_after_def(d, y[j], x[i]))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+/* Appends a parallel copy to a block as a sequence of ASSIGNs.
+ *
+ * NOTE: a copy is emitted once its destination is no longer needed as
+ *       a source; what remains are cycles, which are broken by saving
+ *       one destination into a new temporary.
+ * PARAMETERS:
+ *   g     - the flow graph
+ *   b     - the block
+ *   dst   - the destinations (all distinct)
+ *   src   - the sources
+ * RETURNS:
+ *   number of ASSIGNs emitted
+ */
+static int sequentialize(FlowGraph *g, BasicBlock *b, Vector<Temp> &dst,
+                         Vector<Temp> &src) {
+    int emitted = 0;
+
+    while (!dst.empty()) {
+        bool progress = false;
+
+        for (size_t i = 0; i < dst.size(); ++i) {
+            bool needed = false;
+            for (size_t j = 0; j < src.size() && !needed; ++j)
+                needed = (j != i && src[j] == dst[i]);
+            if (needed)
+                continue;
+
+            append(b, Tac::Assign(dst[i], src[i]));
+            ++emitted;
+            dst.erase(dst.begin() + i);
+            src.erase(src.begin() + i);
+            progress = true;
+            break;
+        }
+
+        if (!progress) {
+            // every destination is still to be read: breaks a cycle
+            Temp t = g->newTemp();
+            append(b, Tac::Assign(t, dst[0]));
+            ++emitted;
+            for (size_t j = 0; j < src.size(); ++j)
+                if (src[j] == dst[0])
+                    src[j] = t;
+        }
+    }
+
+    return emitted;
+}
+
+/* Converts the TACs out of SSA form.
+ *
+ * NOTE: the temporaries connected by PHIs are first gathered into webs
+ *       as long as the members of a web never interfere (so that they
+ *       can share a name). The PHIs which still need some copies are
+ *       replaced by parallel copies at the end of the predecessors
+ *       (splitting the critical edges), sequentialized into ASSIGNs.
+ */
+void FlowGraph::destroySSA(void) {
+    Destruction d;
+    d.g = this;
+
+    bool any_phi = false;
+    for (int i = 0; i < _n && !any_phi; ++i)
+        any_phi = (NULL != _bbs[i]->tac_chain &&
+                   Tac::PHI == _bbs[i]->tac_chain->op_code);
+    if (!any_phi)
+        return;
+
+    // numbers the TACs and finds the definitions
+    computePredecessors();
+    d.def.resize(_tempCount, NULL);
+    d.parent.resize(_tempCount);
+    d.members.resize(_tempCount);
+    Vector<Temp> temp_of;
+    temp_of.resize(_tempCount, NULL);
+    Temp uses[2];
+
+    for (int i = 0; i < _n; ++i) {
+        int pos = 0;
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            t->bb_num = i;
+            t->mark = (Tac::PHI == t->op_code) ? 0 : ++pos;
+
+            Temp v = t->getDef();
+            if (NULL != v) {
+                d.def[v->id] = t;
+                temp_of[v->id] = v;
+            }
+            int n = t->getUses(uses);
+            for (int k = 0; k < n; ++k)
+                temp_of[uses[k]->id] = uses[k];
+            if (Tac::PHI == t->op_code)
+                for (size_t k = 0; k < t->phi_args->size(); ++k)
+                    temp_of[(*t->phi_args)[k]->id] = (*t->phi_args)[k];
+        }
+        if (BasicBlock::BY_JUMP != _bbs[i]->end_kind)
+            temp_of[_bbs[i]->var->id] = _bbs[i]->var;
+    }
+    for (int id = 0; id < _tempCount; ++id) {
+        d.parent[id] = id;
+        if (NULL != temp_of[id])
+            d.members[id].push_back(temp_of[id]);
+    }
+
+    analyze_ssa_liveness(d);
+
+    // gathers the webs
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next) {
+            for (size_t k = 0; k < t->phi_args->size(); ++k) {
+                int a = find_web(d, t->op0.var->id);
+                int b = find_web(d, (*t->phi_args)[k]->id);
+                if (a == b || webs_interfere(d, a, b))
+                    continue;
+
+                d.parent[b] = a;
+                d.members[a].insert(d.members[a].end(), d.members[b].begin(),
+                                    d.members[b].end());
+                d.members[b].clear();
+            }
+        }
+    }
+
+    // every web gets the name of its root
+    Temp *slots[2];
+    for (int i = 0; i < _n; ++i) {
+        BasicBlock *b = _bbs[i];
+        for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+            int n = t->getUseSlots(slots);
+            for (int k = 0; k < n; ++k)
+                *slots[k] = temp_of[find_web(d, (*slots[k])->id)];
+            if (NULL != t->getDef())
+                t->op0.var = temp_of[find_web(d, t->op0.var->id)];
+            if (Tac::PHI == t->op_code)
+                for (size_t k = 0; k < t->phi_args->size(); ++k)
+                    (*t->phi_args)[k] =
+                        temp_of[find_web(d, (*t->phi_args)[k]->id)];
+        }
+        if (BasicBlock::BY_JUMP != b->end_kind)
+            b->var = temp_of[find_web(d, b->var->id)];
+    }
+
+    // replaces the PHIs with copies
+    int num_copies = 0, num_split = 0;
+    int old_n = _n;
+    for (int i = 0; i < old_n; ++i) {
+        BasicBlock *b = _bbs[i];
+        Tac *body = first_non_phi(b);
+
+        for (size_t k = 0; k < b->preds.size(); ++k) {
+            Vector<Temp> dst, src;
+            for (Tac *t = b->tac_chain; t != body; t = t->next) {
+                Temp x = (*t->phi_args)[k];
+                if (x != t->op0.var) {
+                    dst.push_back(t->op0.var);
+                    src.push_back(x);
+                }
+            }
+            if (dst.empty())
+                continue;
+
+            BasicBlock *p = _bbs[b->preds[k]];
+            if (BasicBlock::BY_JUMP != p->end_kind) {
+                p = _bbs[splitEdge(p->bb_num, i)];
+                ++num_split;
+            }
+            num_copies += sequentialize(this, p, dst, src);
+        }
+
+        b->tac_chain = body;
+        if (NULL != body)
+            body->prev = NULL;
+    }
+
+    if (Option::showStats())
+        std::cerr << "out of ssa: " << num_copies << " copies, " << num_split
+                  << " edges split" << std::endl;
+}
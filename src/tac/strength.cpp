@@ -0,0 +1,360 @@
+/*****************************************************
+ *  Induction-Variable Strength Reduction.
+ *
+ *  This file contains the implementation of FlowGraph::reduceStrength.
+ *
+ *  A basic induction variable is a PHI "i" of a loop header whose value
+ *  from the back edge is i + s (s being a constant). Inside the loop,
+ *  a temporary is a linear function a * i + b of it if it is computed
+ *  from "i" by adding, subtracting and multiplying constants. For a
+ *  multiplication computing a * i + b, a new induction variable
+ *
+ *      p <- phi(a * i0, p + a * s)
+ *
+ *  is created in the header, and the multiplication becomes p + b.
+ *  Since the arithmetic wraps around, the equation holds even if some
+ *  of the values overflow.
+ *
+ *  Reference: K. D. Cooper, L. T. Simpson and C. A. Vick. Operator
+ *             Strength Reduction. ACM TOPLAS 23(5), 2001.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+/* A linear function of an induction variable.
+ */
+struct Linear {
+    Temp iv;   // the basic induction variable (NULL: not linear)
+    unsigned a; // the factor
+    unsigned b; // the offset
+};
+
+/* A reduced induction variable: p = a * iv.
+ */
+struct Reduced {
+    Temp iv;    // the basic induction variable
+    unsigned a; // the factor
+    Temp p;     // the new induction variable
+};
+
+/* State of the strength reduction.
+ */
+struct Reduction {
+    FlowGraph *g;
+    Vector<Tac *> def;     // the TAC defining every temp (NULL: the entry)
+    Vector<Linear> linear; // the linear function of every temp
+    Vector<bool> in_loop;  // whether a block is in the current loop
+};
+
+/* Records the definition of a temporary.
+ */
+static void set_def(Reduction &r, Temp v, Tac *t) {
+    if ((size_t)v->id >= r.def.size())
+        r.def.resize(v->id + 1, NULL);
+    r.def[v->id] = t;
+}
+
+/* Gets the constant held by a temporary.
+ *
+ * RETURNS:
+ *   true if the temporary is defined by a LoadImm4
+ */
+static bool get_const(Reduction &r, Temp v, unsigned &val) {
+    if ((size_t)v->id >= r.def.size() || NULL == r.def[v->id] ||
+        Tac::LOAD_IMM4 != r.def[v->id]->op_code)
+        return false;
+
+    val = (unsigned)r.def[v->id]->op1.ival;
+    return true;
+}
+
+/* Gets the linear function of a temporary in the current loop.
+ */
+static Linear get_linear(Reduction &r, Temp v) {
+    Linear l;
+    l.iv = NULL;
+    l.a = l.b = 0;
+
+    if ((size_t)v->id < r.linear.size())
+        l = r.linear[v->id];
+    return l;
+}
+
+/* Records the linear function of a temporary.
+ */
+static void set_linear(Reduction &r, Temp v, Linear l) {
+    if ((size_t)v->id >= r.linear.size()) {
+        Linear none;
+        none.iv = NULL;
+        none.a = none.b = 0;
+        r.linear.resize(v->id + 1, none);
+    }
+    r.linear[v->id] = l;
+}
+
+/* Computes the linear function defined by a TAC.
+ *
+ * RETURNS:
+ *   the linear function (whose "iv" is NULL if there is none)
+ */
+static Linear linear_of(Reduction &r, Tac *t) {
+    Linear x, y, none;
+    unsigned k;
+    none.iv = NULL;
+    none.a = none.b = 0;
+
+    switch (t->op_code) {
+    case Tac::ASSIGN:
+        return get_linear(r, t->op1.var);
+
+    case Tac::NEG:
+        x = get_linear(r, t->op1.var);
+        x.a = 0u - x.a;
+        x.b = 0u - x.b;
+        return x;
+
+    case Tac::ADD:
+    case Tac::SUB:
+    case Tac::MUL:
+        break;
+
+    default:
+        return none;
+    }
+
+    x = get_linear(r, t->op1.var);
+    y = get_linear(r, t->op2.var);
+    if (NULL != x.iv && get_const(r, t->op2.var, k)) {
+        if (Tac::ADD == t->op_code) {
+            x.b += k;
+        } else if (Tac::SUB == t->op_code) {
+            x.b -= k;
+        } else {
+            x.a *= k;
+            x.b *= k;
+        }
+        return x;
+    }
+    if (NULL != y.iv && get_const(r, t->op1.var, k)) {
+        if (Tac::ADD == t->op_code) {
+            y.b += k;
+        } else if (Tac::SUB == t->op_code) {
+            y.a = 0u - y.a;
+            y.b = k - y.b;
+        } else {
+            y.a *= k;
+            y.b *= k;
+        }
+        return y;
+    }
+
+    return none;
+}
+
+/* Inserts a TAC before another one (or at the end of the block).
+ */
+static void insert_before(BasicBlock *b, Tac *pos, Tac *t) {
+    t->bb_num = b->bb_num;
+
+    if (NULL == pos) {
+        Tac *last = b->tac_chain;
+        while (NULL != last && NULL != last->next)
+            last = last->next;
+        t->prev = last;
+        t->next = NULL;
+        if (NULL == last)
+            b->tac_chain = t;
+        else
+            last->next = t;
+        return;
+    }
+
+    t->prev = pos->prev;
+    t->next = pos;
+    if (NULL == pos->prev)
+        b->tac_chain = t;
+    else
+        pos->prev->next = t;
+    pos->prev = t;
+}
+
+/* Reduces the multiplications by the induction variables to additions.
+ *
+ * NOTE: the TACs should be in SSA form. Only the loops with a single
+ *       back edge are considered, and every loop is given a preheader
+ *       first (see FlowGraph::insertPreheaders).
+ */
+void FlowGraph::reduceStrength(void) {
+    Reduction r;
+    int reduced = 0, created = 0;
+
+    insertPreheaders();
+
+    r.g = this;
+    for (int i = 0; i < _n; ++i) {
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next) {
+            t->bb_num = i; // (the blocks may have been renumbered)
+            if (NULL != t->getDef())
+                set_def(r, t->getDef(), t);
+        }
+    }
+
+    Vector<Temp> subst; // the replacement of a temp in the current loop
+    for (size_t li = 0; li < _loops.size(); ++li) {
+        Loop *l = _loops[li];
+        if (l->preheader < 0 || 1 != l->latches.size())
+            continue;
+
+        BasicBlock *h = _bbs[l->header];
+        BasicBlock *pre = _bbs[l->preheader];
+        BasicBlock *latch = _bbs[l->latches[0]];
+        if (2 != h->preds.size())
+            continue;
+        int from_pre = (h->preds[0] == pre->bb_num) ? 0 : 1;
+        int from_latch = 1 - from_pre;
+
+        r.in_loop.assign(_n, false);
+        for (size_t k = 0; k < l->blocks.size(); ++k)
+            r.in_loop[l->blocks[k]] = true;
+        r.linear.clear();
+
+        Linear base;
+        base.a = 1;
+        base.b = 0;
+        for (Tac *t = h->tac_chain; t != NULL && Tac::PHI == t->op_code;
+             t = t->next) {
+            base.iv = t->op0.var;
+            set_linear(r, t->op0.var, base);
+        }
+
+        // the linear functions, in a preorder of the dominator tree
+        Vector<int> stack;
+        Vector<Tac *> muls;
+        stack.push_back(h->bb_num);
+        while (!stack.empty()) {
+            BasicBlock *b = _bbs[stack.back()];
+            stack.pop_back();
+            for (size_t k = 0; k < b->dom_children.size(); ++k)
+                if (r.in_loop[b->dom_children[k]])
+                    stack.push_back(b->dom_children[k]);
+
+            for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+                if (Tac::PHI == t->op_code)
+                    continue;
+                Linear x = linear_of(r, t);
+                if (NULL == x.iv)
+                    continue;
+                set_linear(r, t->op0.var, x);
+                if (Tac::MUL == t->op_code)
+                    muls.push_back(t);
+            }
+        }
+
+        Vector<Reduced> done;
+        subst.clear();
+        for (size_t k = 0; k < muls.size(); ++k) {
+            Tac *t = muls[k];
+            Linear x = get_linear(r, t->op0.var);
+
+            // the step of the basic induction variable
+            Tac *phi = r.def[x.iv->id];
+            Linear next = get_linear(r, (*phi->phi_args)[from_latch]);
+            if (next.iv != x.iv || 1 != next.a)
+                continue;
+
+            Temp p = NULL;
+            for (size_t j = 0; j < done.size() && NULL == p; ++j)
+                if (done[j].iv == x.iv && done[j].a == x.a)
+                    p = done[j].p;
+
+            if (NULL == p) {
+                // p <- a * i0 (in the preheader)
+                Temp init = (*phi->phi_args)[from_pre];
+                Temp p0 = newTemp();
+                unsigned c;
+                if (get_const(r, init, c)) {
+                    insert_before(pre, NULL, Tac::LoadImm4(p0, (int)(c * x.a)));
+                } else {
+                    Temp ta = newTemp();
+                    insert_before(pre, NULL, Tac::LoadImm4(ta, (int)x.a));
+                    insert_before(pre, NULL, Tac::Mul(p0, init, ta));
+                }
+
+                // p' <- p + a * s (at the end of the latch)
+                p = newTemp();
+                Temp ts = newTemp(), p1 = newTemp();
+                insert_before(latch, NULL,
+                              Tac::LoadImm4(ts, (int)(x.a * next.b)));
+                insert_before(latch, NULL, Tac::Add(p1, p, ts));
+
+                Tac *p_phi = Tac::Phi(p, 2);
+                (*p_phi->phi_args)[from_pre] = p0;
+                (*p_phi->phi_args)[from_latch] = p1;
+                p_phi->mark = p->id;
+                insert_before(h, h->tac_chain, p_phi);
+
+                Reduced d;
+                d.iv = x.iv;
+                d.a = x.a;
+                d.p = p;
+                done.push_back(d);
+                ++created;
+            }
+
+            // t <- p + b (or a copy of p, which the loop uses directly)
+            if (0 == x.b) {
+                t->op_code = Tac::ASSIGN;
+                t->op1.var = p;
+                t->op2.var = NULL;
+                if ((size_t)t->op0.var->id >= subst.size())
+                    subst.resize(t->op0.var->id + 1, NULL);
+                subst[t->op0.var->id] = p;
+            } else {
+                Temp tb = newTemp();
+                insert_before(_bbs[t->bb_num], t, Tac::LoadImm4(tb, (int)x.b));
+                t->op_code = Tac::ADD;
+                t->op1.var = p;
+                t->op2.var = tb;
+            }
+            ++reduced;
+        }
+
+        // every use in the loop sees the value of the same iteration
+        if (subst.empty())
+            continue;
+        Temp *slots[2];
+        for (size_t k = 0; k < l->blocks.size(); ++k) {
+            BasicBlock *b = _bbs[l->blocks[k]];
+            for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+                int n = t->getUseSlots(slots);
+                for (int j = 0; j < n; ++j)
+                    if ((size_t)(*slots[j])->id < subst.size() &&
+                        NULL != subst[(*slots[j])->id])
+                        *slots[j] = subst[(*slots[j])->id];
+                if (Tac::PHI == t->op_code) {
+                    Vector<Temp> &args = *t->phi_args;
+                    for (size_t j = 0; j < args.size(); ++j)
+                        if ((size_t)args[j]->id < subst.size() &&
+                            NULL != subst[args[j]->id])
+                            args[j] = subst[args[j]->id];
+                }
+            }
+            if (BasicBlock::BY_JUMP != b->end_kind &&
+                (size_t)b->var->id < subst.size() && NULL != subst[b->var->id])
+                b->var = subst[b->var->id];
+        }
+    }
+
+    if (Option::showStats())
+        std::cerr << "strength reduction: " << reduced << " reduced, "
+                  << created << " induction variables created" << std::endl;
+}
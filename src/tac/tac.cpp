@@ -9,6 +9,7 @@
 #include "options.hpp"
 #include "tac/flow_graph.hpp"
 
+#include <climits>
 #include <iomanip>
 #include <sstream>
 
@@ -29,10 +30,12 @@ static Tac *allocateNewTac(Tac::Kind code) {
     Tac *t = new Tac;
     t->op_code = code;
     t->op0.ival = t->op1.ival = t->op2.ival = 0;
+    t->op0.var = t->op1.var = t->op2.var = NULL;
     t->bb_num = 0;
     t->mark = 0;
     t->prev = t->next = NULL;
     t->LiveOut = NULL;
+    t->phi_args = NULL;
 
     return t;
 }
@@ -173,6 +176,102 @@ Tac *Tac::Mod(Temp dest, Temp op1, Temp op2) {
     return t;
 }
 
+/* Creates a Shl tac.
+ *
+ * NOTE:
+ *   shift left (by op2 mod 32)
+ * PARAMETERS:
+ *   dest - result
+ *   op1  - operand 1 (left)
+ *   op2  - operand 2 (right)
+ * RETURNS:
+ *   a Shl tac
+ */
+Tac *Tac::Shl(Temp dest, Temp op1, Temp op2) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(op1);
+    REQUIRE_I4(op2);
+
+    Tac *t = allocateNewTac(Tac::SHL);
+    t->op0.var = dest;
+    t->op1.var = op1;
+    t->op2.var = op2;
+
+    return t;
+}
+
+/* Creates a Shr tac.
+ *
+ * NOTE:
+ *   logical shift right (by op2 mod 32)
+ * PARAMETERS:
+ *   dest - result
+ *   op1  - operand 1 (left)
+ *   op2  - operand 2 (right)
+ * RETURNS:
+ *   a Shr tac
+ */
+Tac *Tac::Shr(Temp dest, Temp op1, Temp op2) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(op1);
+    REQUIRE_I4(op2);
+
+    Tac *t = allocateNewTac(Tac::SHR);
+    t->op0.var = dest;
+    t->op1.var = op1;
+    t->op2.var = op2;
+
+    return t;
+}
+
+/* Creates a Sar tac.
+ *
+ * NOTE:
+ *   arithmetic shift right (by op2 mod 32)
+ * PARAMETERS:
+ *   dest - result
+ *   op1  - operand 1 (left)
+ *   op2  - operand 2 (right)
+ * RETURNS:
+ *   a Sar tac
+ */
+Tac *Tac::Sar(Temp dest, Temp op1, Temp op2) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(op1);
+    REQUIRE_I4(op2);
+
+    Tac *t = allocateNewTac(Tac::SAR);
+    t->op0.var = dest;
+    t->op1.var = op1;
+    t->op2.var = op2;
+
+    return t;
+}
+
+/* Creates a MulH tac.
+ *
+ * NOTE:
+ *   high 32 bits of the signed 64-bit product
+ * PARAMETERS:
+ *   dest - result
+ *   op1  - operand 1 (left)
+ *   op2  - operand 2 (right)
+ * RETURNS:
+ *   a MulH tac
+ */
+Tac *Tac::MulH(Temp dest, Temp op1, Temp op2) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(op1);
+    REQUIRE_I4(op2);
+
+    Tac *t = allocateNewTac(Tac::MULH);
+    t->op0.var = dest;
+    t->op1.var = op1;
+    t->op2.var = op2;
+
+    return t;
+}
+
 /* Creates an Equ tac.
  *
  * NOTE:
@@ -370,6 +469,54 @@ Tac *Tac::LOr(Temp dest, Temp op1, Temp op2) {
     return t;
 }
 
+/* Creates a SelNZ tac.
+ *
+ * NOTE:
+ *   keeps the value if the condition holds (zero otherwise)
+ * PARAMETERS:
+ *   dest  - result
+ *   cond  - the condition
+ *   value - the value
+ * RETURNS:
+ *   a SelNZ tac
+ */
+Tac *Tac::SelNZ(Temp dest, Temp cond, Temp value) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(cond);
+    REQUIRE_I4(value);
+
+    Tac *t = allocateNewTac(Tac::SEL_NZ);
+    t->op0.var = dest;
+    t->op1.var = cond;
+    t->op2.var = value;
+
+    return t;
+}
+
+/* Creates a SelZ tac.
+ *
+ * NOTE:
+ *   keeps the value if the condition fails (zero otherwise)
+ * PARAMETERS:
+ *   dest  - result
+ *   cond  - the condition
+ *   value - the value
+ * RETURNS:
+ *   a SelZ tac
+ */
+Tac *Tac::SelZ(Temp dest, Temp cond, Temp value) {
+    REQUIRE_I4(dest);
+    REQUIRE_I4(cond);
+    REQUIRE_I4(value);
+
+    Tac *t = allocateNewTac(Tac::SEL_Z);
+    t->op0.var = dest;
+    t->op1.var = cond;
+    t->op2.var = value;
+
+    return t;
+}
+
 /* Creates an Assign tac.
  *
  * NOTE:
@@ -489,6 +636,28 @@ Tac *Tac::LoadImm4(Temp dest, int value) {
     return t;
 }
 
+/* Creates a Phi tac.
+ *
+ * NOTE:
+ *   only appears at the beginning of a basic block in SSA form
+ *   (see tac/ssa.cpp). the arguments are filled in later.
+ * PARAMETERS:
+ *   dest      - result
+ *   num_preds - number of predecessors of the basic block
+ * RETURNS:
+ *   a Phi tac
+ */
+Tac *Tac::Phi(Temp dest, int num_preds) {
+    REQUIRE_I4(dest);
+
+    Tac *t = allocateNewTac(Tac::PHI);
+    t->op0.var = dest;
+    t->phi_args = new util::Vector<Temp>();
+    t->phi_args->resize(num_preds, NULL);
+
+    return t;
+}
+
 /* Creates a Jump tac.
  *
  * NOTE:
@@ -598,6 +767,266 @@ Tac *Tac::Mark(Label label) {
     return t;
 }
 
+/* Gets the variable defined by this tac.
+ *
+ * RETURNS:
+ *   the defined variable, or NULL if this tac defines nothing
+ * NOTE:
+ *   if you add some new Tacs, please update this function and getUses
+ */
+Temp Tac::getDef(void) {
+    switch (op_code) {
+    case ASSIGN:
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case MOD:
+    case SHL:
+    case SHR:
+    case SAR:
+    case MULH:
+    case EQU:
+    case NEQ:
+    case LES:
+    case LEQ:
+    case GTR:
+    case GEQ:
+    case NEG:
+    case NOT:
+    case LAND:
+    case LOR:
+    case SEL_NZ:
+    case SEL_Z:
+    case LNOT:
+    case BNOT:
+    case POP:
+    case LOAD_IMM4:
+    case PHI:
+        return op0.var;
+
+    default:
+        return NULL;
+    }
+}
+
+/* Gets the variables used by this tac.
+ *
+ * PARAMETERS:
+ *   uses  - receives the used variables (room for 2 is needed)
+ * RETURNS:
+ *   how many variables are used
+ */
+int Tac::getUses(Temp *uses) {
+    switch (op_code) {
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case MOD:
+    case SHL:
+    case SHR:
+    case SAR:
+    case MULH:
+    case EQU:
+    case NEQ:
+    case LES:
+    case LEQ:
+    case GTR:
+    case GEQ:
+    case LAND:
+    case LOR:
+    case SEL_NZ:
+    case SEL_Z:
+        uses[0] = op1.var;
+        uses[1] = op2.var;
+        return 2;
+
+    case ASSIGN:
+    case NEG:
+    case NOT:
+    case LNOT:
+    case BNOT:
+    case JZERO:
+        uses[0] = op1.var;
+        return 1;
+
+    case PUSH:
+    case RETURN:
+        uses[0] = op0.var;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* Gets the operand fields holding the variables used by this tac.
+ *
+ * NOTE: useful for renaming the uses (see also getUses)
+ * PARAMETERS:
+ *   slots - receives the addresses of the fields (room for 2 is needed)
+ * RETURNS:
+ *   how many variables are used
+ */
+int Tac::getUseSlots(Temp **slots) {
+    switch (op_code) {
+    case ADD:
+    case SUB:
+    case MUL:
+    case DIV:
+    case MOD:
+    case SHL:
+    case SHR:
+    case SAR:
+    case MULH:
+    case EQU:
+    case NEQ:
+    case LES:
+    case LEQ:
+    case GTR:
+    case GEQ:
+    case LAND:
+    case LOR:
+    case SEL_NZ:
+    case SEL_Z:
+        slots[0] = &op1.var;
+        slots[1] = &op2.var;
+        return 2;
+
+    case ASSIGN:
+    case NEG:
+    case NOT:
+    case LNOT:
+    case BNOT:
+    case JZERO:
+        slots[0] = &op1.var;
+        return 1;
+
+    case PUSH:
+    case RETURN:
+        slots[0] = &op0.var;
+        return 1;
+
+    default:
+        return 0;
+    }
+}
+
+/* Computes the result of this tac from constant operands.
+ *
+ * NOTE: the arithmetic wraps around like the target machine does
+ * PARAMETERS:
+ *   a     - the value of op1
+ *   b     - the value of op2 (ignored by unary tacs)
+ *   r     - receives the value of op0
+ * RETURNS:
+ *   false if it could not be evaluated at compile time (e.g. division
+ *   by zero, or a tac which computes nothing)
+ */
+bool Tac::evaluate(int a, int b, int &r) {
+    unsigned ua = a, ub = b;
+
+    switch (op_code) {
+    case ASSIGN:
+        r = a;
+        break;
+
+    case NEG:
+        r = (int)(0u - ua);
+        break;
+
+    case NOT:
+    case LNOT:
+        r = !a;
+        break;
+
+    case BNOT:
+        r = ~a;
+        break;
+
+    case ADD:
+        r = (int)(ua + ub);
+        break;
+
+    case SUB:
+        r = (int)(ua - ub);
+        break;
+
+    case MUL:
+        r = (int)(ua * ub);
+        break;
+
+    case DIV:
+    case MOD:
+        if (0 == b || (INT_MIN == a && -1 == b))
+            return false;
+        r = (DIV == op_code) ? a / b : a % b;
+        break;
+
+    case SHL:
+        r = (int)(ua << (ub & 31));
+        break;
+
+    case SHR:
+        r = (int)(ua >> (ub & 31));
+        break;
+
+    case SAR:
+        r = a >> (ub & 31);
+        break;
+
+    case MULH:
+        r = (int)(((long long)a * b) >> 32);
+        break;
+
+    case LES:
+        r = a < b;
+        break;
+
+    case LEQ:
+        r = a <= b;
+        break;
+
+    case GTR:
+        r = a > b;
+        break;
+
+    case GEQ:
+        r = a >= b;
+        break;
+
+    case EQU:
+        r = a == b;
+        break;
+
+    case NEQ:
+        r = a != b;
+        break;
+
+    case LAND:
+        r = a && b;
+        break;
+
+    case LOR:
+        r = a || b;
+        break;
+
+    case SEL_NZ:
+        r = (0 != a) ? b : 0;
+        break;
+
+    case SEL_Z:
+        r = (0 == a) ? b : 0;
+        break;
+
+    default:
+        return false;
+    }
+
+    return true;
+}
+
 /* Outputs a temporary variable.
  *
  * PARAMETERS:
@@ -679,6 +1108,26 @@ void Tac::dump(std::ostream &os) {
            << ")";
         break;
 
+    case SHL:
+        os << "    " << op0.var << " <- (" << op1.var << " << " << op2.var
+           << ")";
+        break;
+
+    case SHR:
+        os << "    " << op0.var << " <- (" << op1.var << " >>> " << op2.var
+           << ")";
+        break;
+
+    case SAR:
+        os << "    " << op0.var << " <- (" << op1.var << " >> " << op2.var
+           << ")";
+        break;
+
+    case MULH:
+        os << "    " << op0.var << " <- (" << op1.var << " *h " << op2.var
+           << ")";
+        break;
+
     case EQU:
         os << "    " << op0.var << " <- (" << op1.var << " == " << op2.var
            << ")";
@@ -723,6 +1172,16 @@ void Tac::dump(std::ostream &os) {
            << ")";
         break;
 
+    case SEL_NZ:
+        os << "    " << op0.var << " <- (" << op1.var << " ? " << op2.var
+           << " : 0)";
+        break;
+
+    case SEL_Z:
+        os << "    " << op0.var << " <- (" << op1.var << " ? 0 : " << op2.var
+           << ")";
+        break;
+
     case LNOT:
         os << "    " << op0.var << " <- (! " << op1.var << ")";
         break;
@@ -766,6 +1225,13 @@ void Tac::dump(std::ostream &os) {
         os << "    " << op0.var << " <- " << op1.ival;
         break;
 
+    case PHI:
+        os << "    " << op0.var << " <- phi(";
+        for (size_t i = 0; i < phi_args->size(); ++i)
+            os << (i > 0 ? ", " : "") << (*phi_args)[i];
+        os << ")";
+        break;
+
     default:
         mind_assert(false); // unreachable
         break;
@@ -6,7 +6,8 @@
 #ifndef __MIND_TAC__
 #define __MIND_TAC__
 
-#include "3rdparty/set.hpp"
+#include "3rdparty/bitset.hpp"
+#include "3rdparty/vector.hpp"
 #include "define.hpp"
 
 #include <iostream>
@@ -75,6 +76,10 @@ struct Tac {
         MUL,
         DIV,
         MOD,
+        SHL,  // op0 <- op1 << op2
+        SHR,  // op0 <- op1 >> op2 (logical)
+        SAR,  // op0 <- op1 >> op2 (arithmetic)
+        MULH, // op0 <- the high 32 bits of op1 * op2 (signed)
         EQU,
         NEQ,
         LES,
@@ -85,6 +90,8 @@ struct Tac {
         NOT,
         LAND,
         LOR,
+        SEL_NZ, // op0 <- (op1 != 0 ? op2 : 0)
+        SEL_Z,  // op0 <- (op1 == 0 ? op2 : 0)
         LNOT,
         BNOT,
         MARK,
@@ -94,6 +101,7 @@ struct Tac {
         POP,
         RETURN,
         LOAD_IMM4,
+        PHI,
         MEMO
     } Kind;
 
@@ -117,15 +125,23 @@ struct Tac {
     Tac *next; // the next tac
 
     int bb_num; // basic block number, for dataflow analysis
-    util::Set<Temp> *LiveOut; // for dataflow analysis: LiveOut set of this TAC
+    util::BitSet<Temp> *LiveOut; // for dataflow analysis: LiveOut set of this TAC
     int mark;   // auxiliary: do anything you want
 
+    util::Vector<Temp> *phi_args; // for PHI: the value coming from every
+                                  // predecessor (in the order of
+                                  // BasicBlock::preds, see tac/ssa.cpp)
+
     // static creation methods for TACs. (see: TransHelper)
     static Tac *Add(Temp dest, Temp op1, Temp op2);
     static Tac *Sub(Temp dest, Temp op1, Temp op2);
     static Tac *Mul(Temp dest, Temp op1, Temp op2);
     static Tac *Div(Temp dest, Temp op1, Temp op2);
     static Tac *Mod(Temp dest, Temp op1, Temp op2);
+    static Tac *Shl(Temp dest, Temp op1, Temp op2);
+    static Tac *Shr(Temp dest, Temp op1, Temp op2);
+    static Tac *Sar(Temp dest, Temp op1, Temp op2);
+    static Tac *MulH(Temp dest, Temp op1, Temp op2);
     static Tac *Equ(Temp dest, Temp op1, Temp op2);
     static Tac *Neq(Temp dest, Temp op1, Temp op2);
     static Tac *Les(Temp dest, Temp op1, Temp op2);
@@ -134,6 +150,8 @@ struct Tac {
     static Tac *Geq(Temp dest, Temp op1, Temp op2);
     static Tac *LAnd(Temp dest, Temp op1, Temp op2);
     static Tac *LOr(Temp dest, Temp op1, Temp op2);
+    static Tac *SelNZ(Temp dest, Temp cond, Temp value);
+    static Tac *SelZ(Temp dest, Temp cond, Temp value);
     static Tac *Assign(Temp dest, Temp src);
     static Tac *Neg(Temp dest, Temp src);
     static Tac *Not(Temp dest, Temp src);
@@ -147,6 +165,18 @@ struct Tac {
     static Tac *Return(Temp value);
     static Tac *Mark(Label label);
     static Tac *Memo(const char *);
+    static Tac *Phi(Temp dest, int num_preds);
+
+    // gets the variable defined by this tac (NULL if none)
+    Temp getDef(void);
+    // gets the variables used by this tac (returns how many, at most 2)
+    // (the arguments of a PHI are not included: they are used at the
+    //  end of the predecessors)
+    int getUses(Temp *);
+    // gets the operand fields holding those variables (in the same order)
+    int getUseSlots(Temp **);
+    // computes the result from constant operands (false if impossible)
+    bool evaluate(int, int, int &);
 
     // dumps a single tac node to some output stream
     void dump(std::ostream &);
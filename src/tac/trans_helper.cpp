@@ -371,6 +371,49 @@ Temp TransHelper::genLOr(Temp a, Temp b) {
     return c;
 }
 
+/* Appends a SelNZ tac node to the current list.
+ *
+ * PARAMETERS:
+ *   c    - the condition
+ *   a    - the value if c is nonzero
+ * RETURNS:
+ *   the temporary containing the result of (c ? a : 0)
+ */
+Temp TransHelper::genSelNZ(Temp c, Temp a) {
+    Temp x = getNewTempI4();
+    chainUp(Tac::SelNZ(x, c, a));
+    return x;
+}
+
+/* Appends a SelZ tac node to the current list.
+ *
+ * PARAMETERS:
+ *   c    - the condition
+ *   b    - the value if c is zero
+ * RETURNS:
+ *   the temporary containing the result of (c ? 0 : b)
+ */
+Temp TransHelper::genSelZ(Temp c, Temp b) {
+    Temp x = getNewTempI4();
+    chainUp(Tac::SelZ(x, c, b));
+    return x;
+}
+
+/* Appends the tac nodes of a branch-free selection to the current list.
+ *
+ * PARAMETERS:
+ *   c    - the condition
+ *   a    - the value if c is nonzero
+ *   b    - the value if c is zero
+ * RETURNS:
+ *   the temporary containing the result of (c ? a : b)
+ * NOTE:
+ *   computed as b + (c ? a - b : 0), which is exact modulo 2^32
+ */
+Temp TransHelper::genSelect(Temp c, Temp a, Temp b) {
+    return genAdd(b, genSelNZ(c, genSub(a, b)));
+}
+
 /* Appends a LNot tac node to the current list.
  *
  * PARAMETERS:
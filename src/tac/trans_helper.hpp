@@ -56,6 +56,9 @@ class TransHelper {
     // Logical
     Temp genLAnd(Temp, Temp);
     Temp genLOr(Temp, Temp);
+    Temp genSelNZ(Temp, Temp);
+    Temp genSelZ(Temp, Temp);
+    Temp genSelect(Temp, Temp, Temp);
     Temp genLNot(Temp);
     // Bitwise
     Temp genBNot(Temp);
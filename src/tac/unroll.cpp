@@ -0,0 +1,453 @@
+/*****************************************************
+ *  Loop Unrolling.
+ *
+ *  This file contains the implementation of FlowGraph::unrollLoops.
+ *
+ *  A counted loop looks like
+ *
+ *      H:  ...
+ *          c <- (i < n)           (n is a constant)
+ *          if (c == 0) jump EXIT
+ *      B:  ...                    (the body, where i <- i + k once)
+ *          jump H
+ *
+ *  so that the test will succeed in the next U iterations if
+ *  i + (U - 1) * k < n. The loop is unrolled into
+ *
+ *      G:  c' <- (i < n - (U - 1) * k)
+ *          if (c' == 0) jump H    (the original loop does the rest)
+ *          H B H B ... H B        (U copies, without the tests)
+ *          jump G
+ *
+ *  If the trip count is known to be a multiple of U, the original loop
+ *  is not needed any more: G goes to a copy of H which leaves the loop.
+ *  If the trip count is known at all, the loop is entered at the first
+ *  copy, whose test would succeed; and if it equals U, G is dropped.
+ *  The TACs are not in SSA form yet, so the copies of a block share
+ *  its temporaries.
+ */
+
+#include "config.hpp"
+#include "options.hpp"
+#include "tac/flow_graph.hpp"
+#include "tac/tac.hpp"
+
+#include <climits>
+#include <iostream>
+
+using namespace mind;
+using namespace mind::tac;
+using namespace mind::util;
+
+// the largest number of TACs in all the copies of a loop
+#define UNROLL_MAX_TACS 128
+
+/* Gets the closest definition of a temporary before a TAC of the block.
+ *
+ * RETURNS:
+ *   the defining TAC (NULL if it is not defined before "t" in the block)
+ */
+static Tac *def_before(Tac *t, Temp v) {
+    for (Tac *x = t->prev; x != NULL; x = x->prev)
+        if (x->getDef() == v)
+            return x;
+
+    return NULL;
+}
+
+/* Gets the value of a temporary loaded by a LoadImm4 before a TAC.
+ *
+ * RETURNS:
+ *   true if the temporary holds a known constant there
+ */
+static bool const_before(Tac *t, Temp v, int &val) {
+    Tac *d = def_before(t, v);
+    if (NULL == d || Tac::LOAD_IMM4 != d->op_code)
+        return false;
+
+    val = d->op1.ival;
+    return true;
+}
+
+/* Gets the step of an induction variable.
+ *
+ * PARAMETERS:
+ *   t     - the only TAC defining "i" in the loop
+ *   i     - the induction variable
+ *   step  - (output) the constant added to "i"
+ * RETURNS:
+ *   true if "t" is i <- i + k, i <- i - k, or a copy of such a sum
+ */
+static bool get_step(Tac *t, Temp i, int &step) {
+    if (Tac::ASSIGN == t->op_code) {
+        t = def_before(t, t->op1.var);
+        if (NULL == t)
+            return false;
+    }
+
+    int k;
+    switch (t->op_code) {
+    case Tac::ADD:
+        if (t->op1.var == i && const_before(t, t->op2.var, k)) {
+            step = k;
+            return true;
+        }
+        if (t->op2.var == i && const_before(t, t->op1.var, k)) {
+            step = k;
+            return true;
+        }
+        return false;
+
+    case Tac::SUB:
+        if (t->op1.var == i && const_before(t, t->op2.var, k) && k != INT_MIN) {
+            step = -k;
+            return true;
+        }
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+/* Gets the value of the induction variable when entering the loop.
+ *
+ * PARAMETERS:
+ *   g       - the flow graph
+ *   h       - the loop header
+ *   in_loop - whether a block is in the loop
+ *   i       - the induction variable
+ *   init    - (output) the value of "i"
+ * RETURNS:
+ *   true if a single block enters the loop, and loads a constant to "i"
+ */
+static bool get_init(FlowGraph *g, BasicBlock *h, Vector<bool> &in_loop,
+                     Temp i, int &init) {
+    BasicBlock *e = NULL;
+    for (size_t k = 0; k < h->preds.size(); ++k) {
+        if (in_loop[h->preds[k]])
+            continue;
+        if (NULL != e)
+            return false;
+        e = g->getBlock(h->preds[k]);
+    }
+    if (NULL == e || NULL == e->tac_chain)
+        return false;
+
+    Tac *last = e->tac_chain;
+    while (NULL != last->next)
+        last = last->next;
+    Tac *d = (last->getDef() == i) ? last : def_before(last, i);
+    if (NULL != d && Tac::ASSIGN == d->op_code)
+        return const_before(d, d->op1.var, init);
+    if (NULL != d && Tac::LOAD_IMM4 == d->op_code) {
+        init = d->op1.ival;
+        return true;
+    }
+
+    return false;
+}
+
+/* Computes how many times the test "i OP n" succeeds.
+ *
+ * PARAMETERS:
+ *   op    - the comparison (LES or LEQ if step > 0, GTR or GEQ if not)
+ *   init  - the initial value of "i"
+ *   n     - the bound
+ *   step  - the constant added to "i" in every iteration
+ * RETURNS:
+ *   the trip count of the loop
+ */
+static long long trip_count(Tac::Kind op, int init, int n, int step) {
+    long long dist = (step > 0) ? (long long)n - init : (long long)init - n;
+    long long k = (step > 0) ? step : -(long long)step;
+
+    if (Tac::LEQ == op || Tac::GEQ == op)
+        return (dist < 0) ? 0 : dist / k + 1;
+    else
+        return (dist <= 0) ? 0 : (dist + k - 1) / k;
+}
+
+/* Chooses the unrolling factor of a loop with a known trip count.
+ *
+ * NOTE: a factor dividing the trip count is preferred, so that the
+ *       remainder loop only runs its test. The tests of the unrolled
+ *       loop and the remainder loop should be fewer than the original
+ *       ones, or the loop is not worth unrolling.
+ * PARAMETERS:
+ *   max   - the largest factor allowed
+ *   trips - the trip count
+ * RETURNS:
+ *   the factor (less than 2 if the loop should not be unrolled)
+ */
+static int choose_factor(int max, long long trips) {
+    int u = (trips < max) ? (int)trips : max;
+    for (int f = u; f >= 2; --f) {
+        if (0 == trips % f) {
+            u = f;
+            break;
+        }
+    }
+    if (u < 2 || trips / u + trips % u + 2 >= trips + 1)
+        return 1;
+
+    return u;
+}
+
+/* Swaps the operands of a comparison.
+ */
+static Tac::Kind swap_compare(Tac::Kind k) {
+    switch (k) {
+    case Tac::LES:
+        return Tac::GTR;
+    case Tac::LEQ:
+        return Tac::GEQ;
+    case Tac::GTR:
+        return Tac::LES;
+    default:
+        return Tac::LEQ;
+    }
+}
+
+/* Makes a copy of a basic block (with the same successors).
+ */
+static BasicBlock *copy_block(BasicBlock *b) {
+    BasicBlock *c = new BasicBlock();
+    c->end_kind = b->end_kind;
+    c->var = b->var;
+    c->next[0] = b->next[0];
+    c->next[1] = b->next[1];
+
+    Tac *last = NULL;
+    for (Tac *t = b->tac_chain; t != NULL; t = t->next) {
+        Tac *x = new Tac(*t);
+        x->prev = last;
+        x->next = NULL;
+        x->LiveOut = NULL;
+        if (NULL == last)
+            c->tac_chain = x;
+        else
+            last->next = x;
+        last = x;
+    }
+
+    return c;
+}
+
+/* Unrolls the counted loops.
+ *
+ * NOTE: only the innermost loops are unrolled, whose header is their
+ *       only exit; the TACs should not be in SSA form.
+ * PARAMETERS:
+ *   factor - how many copies of the body an iteration of the unrolled
+ *            loop runs (reduced for a large loop)
+ */
+void FlowGraph::unrollLoops(int factor) {
+    int unrolled = 0, copied = 0, removed = 0;
+
+    findLoops();
+    for (int i = 0; i < _n; ++i)
+        for (Tac *t = _bbs[i]->tac_chain; t != NULL; t = t->next)
+            t->bb_num = i; // (the blocks may have been renumbered)
+
+    Vector<bool> is_outer;
+    is_outer.resize(_loops.size(), false);
+    for (size_t i = 0; i < _loops.size(); ++i)
+        if (_loops[i]->parent >= 0)
+            is_outer[_loops[i]->parent] = true;
+
+    Vector<bool> in_loop;
+    Vector<int> copy_of;
+    for (size_t li = 0; li < _loops.size(); ++li) {
+        Loop *l = _loops[li];
+        BasicBlock *h = _bbs[l->header];
+        if (is_outer[li] || 0 == l->header ||
+            BasicBlock::BY_JZERO != h->end_kind)
+            continue;
+
+        in_loop.assign(_n, false);
+        for (size_t k = 0; k < l->blocks.size(); ++k)
+            in_loop[l->blocks[k]] = true;
+        if (in_loop[h->next[0]] || !in_loop[h->next[1]])
+            continue;
+
+        // the header is the only exit, and the loop is small enough
+        bool ok = true;
+        int size = 0;
+        for (size_t k = 0; k < l->blocks.size() && ok; ++k) {
+            BasicBlock *b = _bbs[l->blocks[k]];
+            if (BasicBlock::BY_RETURN == b->end_kind ||
+                (b != h && (!in_loop[b->next[0]] || !in_loop[b->next[1]])))
+                ok = false;
+            for (Tac *t = b->tac_chain; t != NULL; t = t->next)
+                ++size;
+        }
+        int u = factor;
+        while (u > 1 && u * size > UNROLL_MAX_TACS)
+            --u;
+        if (!ok || u < 2)
+            continue;
+
+        // the exit test: i OP n
+        Tac *last = h->tac_chain;
+        while (NULL != last && NULL != last->next)
+            last = last->next;
+        Tac *cmp = (NULL == last) ? NULL
+                   : (last->getDef() == h->var) ? last
+                                                : def_before(last, h->var);
+        if (NULL == cmp || (Tac::LES != cmp->op_code && Tac::LEQ != cmp->op_code &&
+                            Tac::GTR != cmp->op_code && Tac::GEQ != cmp->op_code))
+            continue;
+
+        Temp i = cmp->op1.var;
+        Tac::Kind op = cmp->op_code;
+        int n;
+        if (!const_before(cmp, cmp->op2.var, n)) {
+            i = cmp->op2.var;
+            op = swap_compare(op);
+            if (!const_before(cmp, cmp->op1.var, n))
+                continue;
+        }
+
+        // "i" is changed once in every iteration, outside the header
+        Tac *inc = NULL;
+        int defs = 0, step = 0;
+        for (size_t k = 0; k < l->blocks.size(); ++k) {
+            for (Tac *t = _bbs[l->blocks[k]]->tac_chain; t != NULL; t = t->next) {
+                if (t->getDef() == i) {
+                    inc = t;
+                    ++defs;
+                }
+            }
+        }
+        if (1 != defs || NULL == inc || inc->bb_num == h->bb_num ||
+            !get_step(inc, i, step))
+            continue;
+
+        bool dominates_latches = true;
+        for (size_t k = 0; k < l->latches.size(); ++k)
+            dominates_latches =
+                dominates_latches && dominates(inc->bb_num, l->latches[k]);
+        if (!dominates_latches)
+            continue;
+
+        bool upward = (Tac::LES == op || Tac::LEQ == op);
+        if ((upward && step <= 0) || (!upward && step >= 0))
+            continue;
+
+        // a known trip count picks a factor dividing it (not larger, so the
+        // first test of the unrolled loop is known to succeed)
+        int init;
+        bool known = false; // whether the trip count is known
+        bool exact = false; // whether the remainder loop never runs
+        bool once = false;  // whether the unrolled loop runs only once
+        if (get_init(this, h, in_loop, i, init)) {
+            long long trips = trip_count(op, init, n, step);
+            u = choose_factor(u, trips);
+            if (u < 2)
+                continue;
+            known = true;
+            exact = (0 == trips % u);
+            once = (trips == u);
+        }
+
+        long long bound = (long long)n - (long long)(u - 1) * step;
+        if (bound < INT_MIN || bound > INT_MAX)
+            continue;
+        int num_old = _n;
+
+        // X: the header of the remainder loop, whose test fails at once
+        BasicBlock *x = NULL;
+        if (exact) {
+            x = copy_block(h);
+            x->bb_num = _n++;
+            x->end_kind = BasicBlock::BY_JUMP;
+            x->next[0] = x->next[1] = h->next[0];
+            for (Tac *t = x->tac_chain; t != NULL; t = t->next)
+                t->bb_num = x->bb_num;
+            _bbs.push_back(x);
+        }
+
+        // G: the test of the unrolled loop
+        BasicBlock *g = NULL;
+        if (!once) {
+            g = new BasicBlock();
+            g->bb_num = _n++;
+            _bbs.push_back(g);
+            Temp tn = newTemp(), tc = newTemp();
+            Tac *ld = Tac::LoadImm4(tn, (int)bound);
+            Tac *test = (Tac::LES == op)   ? Tac::Les(tc, i, tn)
+                        : (Tac::LEQ == op) ? Tac::Leq(tc, i, tn)
+                        : (Tac::GTR == op) ? Tac::Gtr(tc, i, tn)
+                                           : Tac::Geq(tc, i, tn);
+            ld->next = test;
+            test->prev = ld;
+            g->tac_chain = ld;
+            g->end_kind = BasicBlock::BY_JZERO;
+            g->var = tc;
+            g->next[0] = exact ? x->bb_num : h->bb_num;
+        }
+
+        // the copies, from the last one to the first one
+        int follow = once ? x->bb_num : g->bb_num; // where the back edges go
+        copy_of.assign(_n, -1);
+        for (int c = u - 1; c >= 0; --c) {
+            for (size_t k = 0; k < l->blocks.size(); ++k) {
+                BasicBlock *b = copy_block(_bbs[l->blocks[k]]);
+                b->bb_num = _n++;
+                _bbs.push_back(b);
+                copy_of.push_back(-1);
+                copy_of[l->blocks[k]] = b->bb_num;
+                for (Tac *t = b->tac_chain; t != NULL; t = t->next)
+                    t->bb_num = b->bb_num;
+                ++copied;
+            }
+
+            for (size_t k = 0; k < l->blocks.size(); ++k) {
+                BasicBlock *b = _bbs[copy_of[l->blocks[k]]];
+                if (l->blocks[k] == h->bb_num) {
+                    // (the test is known to succeed)
+                    b->end_kind = BasicBlock::BY_JUMP;
+                    b->next[0] = b->next[1] = copy_of[h->next[1]];
+                    continue;
+                }
+                for (int j = 0; j < 2; ++j)
+                    b->next[j] = (b->next[j] == h->bb_num) ? follow
+                                                           : copy_of[b->next[j]];
+            }
+            follow = copy_of[h->bb_num];
+        }
+        if (NULL != g)
+            g->next[1] = follow;
+        ++unrolled;
+
+        // the edges entering the loop now go to G (or to the first copy,
+        // if its test is known to succeed)
+        int entry = known ? follow : g->bb_num;
+        for (int k = 0; k < num_old; ++k) {
+            if (in_loop[k] || _bbs[k]->cancelled ||
+                BasicBlock::BY_RETURN == _bbs[k]->end_kind)
+                continue;
+            for (int j = 0; j < 2; ++j)
+                if (_bbs[k]->next[j] == h->bb_num)
+                    _bbs[k]->next[j] = entry;
+        }
+
+        if (exact) {
+            // the original loop is replaced by X
+            for (size_t k = 0; k < l->blocks.size(); ++k)
+                _bbs[l->blocks[k]]->cancelled = true;
+            ++removed;
+        }
+    }
+
+    if (removed > 0)
+        removeCancelledBlocks();
+    if (unrolled > 0)
+        computePredecessors();
+
+    if (Option::showStats())
+        std::cerr << "unroll: " << unrolled << " loops unrolled, " << copied
+                  << " blocks copied, " << removed << " remainder loops removed"
+                  << std::endl;
+}
@@ -12,6 +12,7 @@
 #include "ast/ast.hpp"
 #include "compiler.hpp"
 #include "config.hpp"
+#include "options.hpp"
 #include "scope/scope.hpp"
 #include "symb/symbol.hpp"
 #include "tac/tac.hpp"
@@ -105,6 +106,135 @@ void Translation::visit(ast::AssignExpr *s) {
 void Translation::visit(ast::ExprStmt *s) { s->e->accept(this); }
 void Translation::visit(ast::EmptyStmt *s) { return; }
 
+/* Translates a condition into branches (the "jumping code").
+ *
+ * PARAMETERS:
+ *   e      - the condition
+ *   target - where to jump
+ *   when   - jumps if the condition is true (otherwise, if it is false)
+ * NOTE:
+ *   the code falls through when it does not jump. "&&", "||" and "!"
+ *   become branches alone, and a comparison feeds the branch directly
+ *   (the code generator fuses them), so no boolean is materialized.
+ */
+void Translation::translateCondition(ast::Expr *e, Label target, bool when) {
+    Label skip;
+    ast::Expr *e1 = NULL, *e2 = NULL;
+
+    switch (e->getKind()) {
+    case ast::ASTNode::INT_CONST:
+        if ((0 != ((ast::IntConst *)e)->value) == when)
+            tr->genJump(target);
+        return;
+
+    case ast::ASTNode::NOT_EXPR:
+        translateCondition(((ast::NotExpr *)e)->e, target, !when);
+        return;
+
+    case ast::ASTNode::AND_EXPR:
+        e1 = ((ast::AndExpr *)e)->e1;
+        e2 = ((ast::AndExpr *)e)->e2;
+        if (!when) {
+            // jumps as soon as an operand is false
+            translateCondition(e1, target, false);
+            translateCondition(e2, target, false);
+        } else {
+            skip = tr->getNewLabel();
+            translateCondition(e1, skip, false);
+            translateCondition(e2, target, true);
+            tr->genMarkLabel(skip);
+        }
+        return;
+
+    case ast::ASTNode::OR_EXPR:
+        e1 = ((ast::OrExpr *)e)->e1;
+        e2 = ((ast::OrExpr *)e)->e2;
+        if (when) {
+            // jumps as soon as an operand is true
+            translateCondition(e1, target, true);
+            translateCondition(e2, target, true);
+        } else {
+            skip = tr->getNewLabel();
+            translateCondition(e1, skip, true);
+            translateCondition(e2, target, false);
+            tr->genMarkLabel(skip);
+        }
+        return;
+
+    case ast::ASTNode::LES_EXPR:
+    case ast::ASTNode::GRT_EXPR:
+    case ast::ASTNode::LEQ_EXPR:
+    case ast::ASTNode::GEQ_EXPR:
+    case ast::ASTNode::EQU_EXPR:
+    case ast::ASTNode::NEQ_EXPR:
+        if (when)
+            break;
+        // the comparison is translated as usual: its value is only tested
+        e->accept(this);
+        tr->genJumpOnZero(target, e->ATTR(val));
+        return;
+
+    default:
+        e->accept(this);
+        if (!when) {
+            tr->genJumpOnZero(target, e->ATTR(val));
+        } else {
+            skip = tr->getNewLabel();
+            tr->genJumpOnZero(skip, e->ATTR(val));
+            tr->genJump(target);
+            tr->genMarkLabel(skip);
+        }
+        return;
+    }
+
+    // jumps if the comparison holds: tests the opposite one for zero
+    Temp v = NULL;
+    switch (e->getKind()) {
+    case ast::ASTNode::LES_EXPR: // !(x >= y)
+        ((ast::LesExpr *)e)->e1->accept(this);
+        ((ast::LesExpr *)e)->e2->accept(this);
+        v = tr->genGeq(((ast::LesExpr *)e)->e1->ATTR(val),
+                       ((ast::LesExpr *)e)->e2->ATTR(val));
+        break;
+
+    case ast::ASTNode::GRT_EXPR: // !(x <= y)
+        ((ast::GrtExpr *)e)->e1->accept(this);
+        ((ast::GrtExpr *)e)->e2->accept(this);
+        v = tr->genLeq(((ast::GrtExpr *)e)->e1->ATTR(val),
+                       ((ast::GrtExpr *)e)->e2->ATTR(val));
+        break;
+
+    case ast::ASTNode::LEQ_EXPR: // !(x > y)
+        ((ast::LeqExpr *)e)->e1->accept(this);
+        ((ast::LeqExpr *)e)->e2->accept(this);
+        v = tr->genGtr(((ast::LeqExpr *)e)->e1->ATTR(val),
+                       ((ast::LeqExpr *)e)->e2->ATTR(val));
+        break;
+
+    case ast::ASTNode::GEQ_EXPR: // !(x < y)
+        ((ast::GeqExpr *)e)->e1->accept(this);
+        ((ast::GeqExpr *)e)->e2->accept(this);
+        v = tr->genLes(((ast::GeqExpr *)e)->e1->ATTR(val),
+                       ((ast::GeqExpr *)e)->e2->ATTR(val));
+        break;
+
+    case ast::ASTNode::EQU_EXPR: // !(x != y)
+        ((ast::EquExpr *)e)->e1->accept(this);
+        ((ast::EquExpr *)e)->e2->accept(this);
+        v = tr->genNeq(((ast::EquExpr *)e)->e1->ATTR(val),
+                       ((ast::EquExpr *)e)->e2->ATTR(val));
+        break;
+
+    default: // !(x == y)
+        ((ast::NeqExpr *)e)->e1->accept(this);
+        ((ast::NeqExpr *)e)->e2->accept(this);
+        v = tr->genEqu(((ast::NeqExpr *)e)->e1->ATTR(val),
+                       ((ast::NeqExpr *)e)->e2->ATTR(val));
+        break;
+    }
+    tr->genJumpOnZero(target, v);
+}
+
 /* Translating an ast::IfStmt node.
  *
  * NOTE:
@@ -113,8 +243,7 @@ void Translation::visit(ast::EmptyStmt *s) { return; }
 void Translation::visit(ast::IfStmt *s) {
     Label L1 = tr->getNewLabel(); // entry of the false branch
     Label L2 = tr->getNewLabel(); // exit
-    s->condition->accept(this);
-    tr->genJumpOnZero(L1, s->condition->ATTR(val));
+    translateCondition(s->condition, L1, false);
 
     s->true_brch->accept(this);
     tr->genJump(L2); // done
@@ -125,35 +254,145 @@ void Translation::visit(ast::IfStmt *s) {
     tr->genMarkLabel(L2);
 }
 
-void Translation::visit(ast::IfExpr *s) {
+// the cost of an expression which cannot be evaluated eagerly
+#define NOT_EAGER 1000
+// the largest total cost of the two arms of a branch-free selection
+#define SELECT_MAX_COST 4
 
+/* Estimates the cost of evaluating an expression whether it is needed.
+ *
+ * PARAMETERS:
+ *   e     - the expression
+ * RETURNS:
+ *   the number of operations (variables and constants are free), or
+ *   NOT_EAGER if it has side effects or may be expensive
+ */
+static int eager_cost(ast::Expr *e) {
+    ast::Expr *e1, *e2;
 
-    /*
-    decl->ATTR(sym)->attachTemp(tr->getNewTempI4());
-    if(decl->init){
-        decl->init->accept(this);
-        tr->genAssign(decl->ATTR(sym)->getTemp(), decl->init->ATTR(val));
+    switch (e->getKind()) {
+    case ast::ASTNode::INT_CONST:
+    case ast::ASTNode::LVALUE_EXPR:
+        return 0;
+
+    case ast::ASTNode::NEG_EXPR:
+        return 1 + eager_cost(((ast::NegExpr *)e)->e);
+
+    case ast::ASTNode::NOT_EXPR:
+        return 1 + eager_cost(((ast::NotExpr *)e)->e);
+
+    case ast::ASTNode::BIT_NOT_EXPR:
+        return 1 + eager_cost(((ast::BitNotExpr *)e)->e);
+
+    case ast::ASTNode::ADD_EXPR:
+        e1 = ((ast::AddExpr *)e)->e1;
+        e2 = ((ast::AddExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::SUB_EXPR:
+        e1 = ((ast::SubExpr *)e)->e1;
+        e2 = ((ast::SubExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::MUL_EXPR:
+        e1 = ((ast::MulExpr *)e)->e1;
+        e2 = ((ast::MulExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::LES_EXPR:
+        e1 = ((ast::LesExpr *)e)->e1;
+        e2 = ((ast::LesExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::GRT_EXPR:
+        e1 = ((ast::GrtExpr *)e)->e1;
+        e2 = ((ast::GrtExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::LEQ_EXPR:
+        e1 = ((ast::LeqExpr *)e)->e1;
+        e2 = ((ast::LeqExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::GEQ_EXPR:
+        e1 = ((ast::GeqExpr *)e)->e1;
+        e2 = ((ast::GeqExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::EQU_EXPR:
+        e1 = ((ast::EquExpr *)e)->e1;
+        e2 = ((ast::EquExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::NEQ_EXPR:
+        e1 = ((ast::NeqExpr *)e)->e1;
+        e2 = ((ast::NeqExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::AND_EXPR:
+        e1 = ((ast::AndExpr *)e)->e1;
+        e2 = ((ast::AndExpr *)e)->e2;
+        break;
+
+    case ast::ASTNode::OR_EXPR:
+        e1 = ((ast::OrExpr *)e)->e1;
+        e2 = ((ast::OrExpr *)e)->e2;
+        break;
+
+    default: // assignments, calls, divisions, nested conditionals...
+        return NOT_EAGER;
+    }
+
+    int c1 = eager_cost(e1), c2 = eager_cost(e2);
+    if (c1 >= NOT_EAGER || c2 >= NOT_EAGER)
+        return NOT_EAGER;
+    return 1 + c1 + c2;
+}
+
+/* Tests whether an expression is the constant 0.
+ */
+static bool is_zero(ast::Expr *e) {
+    return ast::ASTNode::INT_CONST == e->getKind() &&
+           0 == ((ast::IntConst *)e)->value;
+}
+
+/* Translating an ast::IfExpr node.
+ *
+ * NOTE:
+ *   when optimizing, a condition and two cheap arms without side effects
+ *   are all evaluated, and the value is selected without branches
+ */
+void Translation::visit(ast::IfExpr *s) {
+    if (Option::doOptimize() && eager_cost(s->condition) < NOT_EAGER &&
+        eager_cost(s->true_brch) + eager_cost(s->false_brch) <=
+            SELECT_MAX_COST) {
+        s->condition->accept(this);
+        s->true_brch->accept(this);
+        s->false_brch->accept(this);
+        Temp c = s->condition->ATTR(val);
+        if (is_zero(s->false_brch))
+            s->ATTR(val) = tr->genSelNZ(c, s->true_brch->ATTR(val));
+        else if (is_zero(s->true_brch))
+            s->ATTR(val) = tr->genSelZ(c, s->false_brch->ATTR(val));
+        else
+            s->ATTR(val) = tr->genSelect(c, s->true_brch->ATTR(val),
+                                         s->false_brch->ATTR(val));
+        return;
     }
-    */
-    //((ast::VarRef*)s)->ATTR(sym)->attachTemp(tr->getNewTempI4());
+
     s->ATTR(val) = tr->getNewTempI4();
     Label L1 = tr->getNewLabel(); // entry of the false branch
     Label L2 = tr->getNewLabel(); // exit
-    s->condition->accept(this);
-    tr->genJumpOnZero(L1, s->condition->ATTR(val));
+    translateCondition(s->condition, L1, false);
 
     s->true_brch->accept(this);
-    //s->ATTR(type) = s->true_brch->ATTR(type);
     tr->genAssign(s->ATTR(val), s->true_brch->ATTR(val));
-
     tr->genJump(L2); // done
 
     tr->genMarkLabel(L1);
     s->false_brch->accept(this);
-    //s->ATTR(val) = tr->getNewTempI4();
-    //s->ATTR(type) = s->false_brch->ATTR(type);
     tr->genAssign(s->ATTR(val), s->false_brch->ATTR(val));
-    
+
     tr->genMarkLabel(L2);
 }
 
@@ -168,8 +407,7 @@ void Translation::visit(ast::WhileStmt *s) {
     Label old_continue = current_continue_label;
     current_continue_label = L1;
     tr->genMarkLabel(L1);
-    s->condition->accept(this);
-    tr->genJumpOnZero(L2, s->condition->ATTR(val));
+    translateCondition(s->condition, L2, false);
 
     s->loop_body->accept(this);
     tr->genJump(L1);
@@ -180,21 +418,26 @@ void Translation::visit(ast::WhileStmt *s) {
     current_continue_label = old_continue;
 }
 
+/* Translating an ast::DoWhileStmt node.
+ *
+ * NOTE:
+ *   the body runs before the first test, and "continue" goes to the test
+ */
 void Translation::visit(ast::DoWhileStmt *s) {
-    Label L1 = tr->getNewLabel();
-    Label L2 = tr->getNewLabel();
+    Label L1 = tr->getNewLabel(); // the body
+    Label L2 = tr->getNewLabel(); // exit
+    Label L3 = tr->getNewLabel(); // the test
 
     Label old_break = current_break_label;
     current_break_label = L2;
     Label old_continue = current_continue_label;
-    current_continue_label = L1;
+    current_continue_label = L3;
 
     tr->genMarkLabel(L1);
-    s->condition->accept(this);
-    tr->genJumpOnZero(L2, s->condition->ATTR(val));
-
     s->loop_body->accept(this);
-    tr->genJump(L1);
+
+    tr->genMarkLabel(L3);
+    translateCondition(s->condition, L1, true);
 
     tr->genMarkLabel(L2);
 
@@ -230,8 +473,7 @@ void Translation::visit(ast::ForStmt *s) {
 
     tr->genMarkLabel(L1);
     if(s->expr2){
-        s->expr2->accept(this);
-        tr->genJumpOnZero(L2, s->expr2->ATTR(val));
+        translateCondition(s->expr2, L2, false);
     }
     
     if(s->loop_body)
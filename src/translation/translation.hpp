@@ -60,6 +60,8 @@ class Translation : public ast::Visitor {
 
   private:
     tac::TransHelper *tr;
+    // translates a condition into branches (jumps when it is true/false)
+    void translateCondition(ast::Expr *, tac::Label, bool);
     tac::Label current_break_label = NULL;
     tac::Label current_continue_label = NULL;
     // TODO: label for continue
@@ -0,0 +1,25 @@
+// comparisons computed before other statements of the block, whose
+// operands die before the branch; fusing them must not read registers
+// which have been reused in between
+int main() {
+    int n = 9;
+    int s = 0;
+    int i = 0;
+    while (i < 12) {
+        int c = i < n;
+        int d = i * 3;
+        s = s + d;
+        int e = d + 1;
+        s = s - e % 4;
+        if (c) {
+            s = s + 5;
+        }
+        int f = s > 40;
+        int g = s - i;
+        s = g + i;
+        if (f)
+            s = s - 2;
+        i = i + 1;
+    }
+    return s % 256;
+}
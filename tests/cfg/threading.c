@@ -0,0 +1,28 @@
+// branches whose condition is known on the incoming edge, chains of
+// empty blocks, and an empty entry block
+int main() {
+    int s = 0;
+    for (int r = 0; r < 5; r = r + 1) {
+        int f = 0;
+        if (r > 2)
+            f = 1;
+        if (f)
+            s = s + 10;
+        else
+            s = s + 1;
+        if (f == 0) {
+        } else {
+            if (r == 4) {
+            }
+        }
+        int g = r % 2;
+        if (g)
+            if (g)
+                s = s + 3;
+    }
+    {
+        {
+        }
+    }
+    return s % 256;
+}
@@ -0,0 +1,131 @@
+#!/bin/bash
+#
+#  Regression tests of the optimizer and the register allocators.
+#
+#  Every tests/*/NAME.c is compiled by mind without optimization and
+#  with -O, -O1 and -O2 (plus the flags listed in NAME.flags, one set
+#  per line), assembled, and run on qemu. The exit status must be the
+#  number in NAME.out, which is what the program returns modulo 256.
+#  The compiler runs in the directory of the test.
+#
+#  NAME.expect checks that the passes really fire. Every line is
+#  "FLAGS: KIND PATTERN", where PATTERN is an extended regular expression
+#  and KIND is one of
+#    asm       some line of the assembly matches
+#    no-asm    no line of the assembly matches
+#    stats     some line printed by "-s" matches
+#    error     the compiler fails, and some line of its errors matches
+#  (the empty lines and the ones starting with '#' are skipped).
+#
+#  Usage: tests/check.sh [NAME.c ...]
+#
+#  The tools can be overridden from the environment:
+#    MIND      the compiler (DEFAULT: src/mind)
+#    RISCV_CC  the RISC-V cross compiler used to assemble and link
+#    QEMU      the user-mode emulator
+#    RISCV_CC_ZICOND, QEMU_ZICOND
+#              the same, with the Zicond extension (for the flags with -z)
+#
+
+TESTS=$(cd "$(dirname "$0")" && pwd)
+MIND=${MIND:-$TESTS/../src/mind}
+RISCV_CC=${RISCV_CC:-riscv64-unknown-elf-gcc -march=rv32im -mabi=ilp32}
+QEMU=${QEMU:-qemu-riscv32}
+RISCV_CC_ZICOND=${RISCV_CC_ZICOND:-riscv64-unknown-elf-gcc -march=rv32im_zicond -mabi=ilp32}
+QEMU_ZICOND=${QEMU_ZICOND:-qemu-riscv32 -cpu rv32,zicond=true}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+
+if [ $# -eq 0 ]; then
+    set -- "$TESTS"/*/*.c
+fi
+
+# checks a line of NAME.expect (see above)
+expect() {
+    local flags=${1%%:*} rest=${1#*:}
+    rest=${rest# }
+    local kind=${rest%% *} pattern=${rest#* }
+    local what="${src#$TESTS/} [${flags:-no optimization}] $kind '$pattern'"
+
+    (cd "$dir" && $MIND $flags -s -l 5 "$src") > "$WORK/e.s" 2> "$WORK/err"
+    local status=$?
+    case "$kind" in
+    asm)
+        [ $status -eq 0 ] && grep -Eq -- "$pattern" "$WORK/e.s" ;;
+    no-asm)
+        [ $status -eq 0 ] && ! grep -Eq -- "$pattern" "$WORK/e.s" ;;
+    stats)
+        [ $status -eq 0 ] && grep -Eq -- "$pattern" "$WORK/err" ;;
+    error)
+        [ $status -ne 0 ] && grep -Eq -- "$pattern" "$WORK/err" ;;
+    *)
+        false ;;
+    esac
+    if [ $? -eq 0 ]; then
+        passed=$((passed + 1))
+    else
+        echo "FAIL $what"
+        sed 's/^/    /' "$WORK/err"
+        failed=$((failed + 1))
+    fi
+}
+
+passed=0
+failed=0
+for src in "$@"; do
+    dir=$(cd "$(dirname "$src")" && pwd)
+    src=$dir/$(basename "$src")
+    name=${src%.c}
+    expected=$(cat "$name.out")
+    levels=("" "-O" "-O1" "-O2")
+    if [ -f "$name.flags" ]; then
+        while read -r line; do
+            [ -n "$line" ] && levels+=("$line")
+        done < "$name.flags"
+    fi
+
+    for flags in "${levels[@]}"; do
+        what="${src#$TESTS/} [${flags:-no optimization}]"
+        cc=$RISCV_CC
+        qemu=$QEMU
+        case " $flags " in
+        *" -z "*)
+            cc=$RISCV_CC_ZICOND
+            qemu=$QEMU_ZICOND ;;
+        esac
+        if ! (cd "$dir" && $MIND $flags -l 5 "$src") > "$WORK/a.s" \
+                2> "$WORK/err"; then
+            echo "FAIL $what: compiler error"
+            sed 's/^/    /' "$WORK/err"
+            failed=$((failed + 1))
+            continue
+        fi
+        if ! $cc "$WORK/a.s" -o "$WORK/a.out" 2> "$WORK/err"; then
+            echo "FAIL $what: cannot assemble"
+            sed 's/^/    /' "$WORK/err"
+            failed=$((failed + 1))
+            continue
+        fi
+        $qemu "$WORK/a.out" > /dev/null
+        got=$?
+        if [ "$got" != "$expected" ]; then
+            echo "FAIL $what: returned $got, expected $expected"
+            failed=$((failed + 1))
+        else
+            passed=$((passed + 1))
+        fi
+    done
+
+    if [ -f "$name.expect" ]; then
+        while read -r line; do
+            case "$line" in
+            "" | "#"*) ;;
+            *) expect "$line" ;;
+            esac
+        done < "$name.expect"
+    fi
+done
+
+echo "$passed passed, $failed failed"
+[ $failed -eq 0 ]
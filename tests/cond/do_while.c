@@ -0,0 +1,29 @@
+// do-while loops run their body before the first test, including when the
+// test is false on entry, and with continue and break in the body
+int main() {
+    int s = 0;
+    int i = 10;
+    do {
+        s = s + i;
+        i = i + 1;
+    } while (i < 5);
+    int j = 0;
+    do {
+        j = j + 1;
+        if (j % 3 == 0)
+            continue;
+        if (j > 14)
+            break;
+        s = s + j * 2;
+    } while (j < 20);
+    int k = 0;
+    do {
+        int m = 0;
+        do {
+            s = s + m * k;
+            m = m + 1;
+        } while (m < k);
+        k = k + 1;
+    } while (k < 5);
+    return (s + j) % 256;
+}
@@ -0,0 +1,25 @@
+// && and || in if, while, for and do-while conditions, with assignments in
+// the right operands which must run only when the left one does not decide
+int main() {
+    int s = 0;
+    int c = 0;
+    for (int i = 0; i < 10; i = i + 1) {
+        if (i > 2 && (c = c + i) % 2 == 0)
+            s = s + i;
+        if (i < 3 || (c = c + 1) > 7)
+            s = s + 2;
+        if (!(i == 4 || i == 6) && (i != 8 || s > 100))
+            s = s + 1;
+        s = s + (i > 5 && s > 3) + (i < 2 || s % 2);
+    }
+    int j = 0;
+    while (j < 20 && (j % 7 != 6 || (c = c * 2) < 0))
+        j = j + 1;
+    int k = 0;
+    do {
+        k = k + 1;
+    } while (k < 3 || k < 9 && (c = c + k) % 6 != 0);
+    for (int m = 0; m < 5 && c < 1000 || m == 2; m = m + 1)
+        s = s + m;
+    return (s * 7 + j * 3 + k + c * 11) % 256;
+}
@@ -0,0 +1,19 @@
+// the simplifier merges blocks after leaving SSA form, and the dead code
+// elimination which runs again afterwards finds more to remove
+int main() {
+    int v0 = 0;
+    int v1 = (4096 <= (v0 % -7));
+    int v2 = (0 ? (~16) : (v1 ? 2047 : v0));
+    for (int i0 = -1; i0 < 4; i0 = i0 + 1) {
+        if (16) {
+            for (int i1 = 0; i1 < 1; i1 = i1 + 1) {
+                int w = 0;
+                while (w < 1) {
+                    w = w + 1;
+                    v1 = (2048 + (i0 * (-(3 < i0))));
+                }
+            }
+        }
+    }
+    return v0 + v1 % 251 * 3 + v2 * 5;
+}
@@ -0,0 +1,24 @@
+// dead chains, a loop computing only a dead value, and branches whose
+// arms are dead, next to live values computed the same way
+int main() {
+    int s = 0;
+    for (int r = 0; r < 4; r = r + 1) {
+        int a = r + 3;
+        int b = r * 2;
+        int t1 = a * b;
+        int t2 = t1 + 1;
+        int u = 0;
+        for (int i = 0; i < a; i = i + 1)
+            u = u + i * t2;
+        if (b > 2)
+            t2 = u - 1;
+        else
+            t2 = u + 1;
+        int live = a * b + 1;
+        int v = live;
+        if (r == 3)
+            v = v - a;
+        s = s + v;
+    }
+    return s % 256;
+}
@@ -0,0 +1,30 @@
+// values which live across blocks one group after another, so their stack
+// slots are shared, next to values which stay alive over all the groups
+int main() {
+    int keep = 3;
+    int s = 0;
+    for (int r = 0; r < 3; r = r + 1) {
+        int a1 = r + 1;
+        int a2 = r * 2;
+        int a3 = r - 5;
+        if (a1 > a2)
+            s = s + a1 * a3;
+        else
+            s = s - a2;
+        int b1 = s % 13;
+        int b2 = s / 3;
+        int b3 = b1 + b2;
+        if (b3 % 2 == 0)
+            s = s + b1 - b2;
+        else
+            s = s + b3 * keep;
+        int c1 = s * 3;
+        int c2 = c1 - r;
+        int c3 = c2 + keep;
+        while (c3 > 50)
+            c3 = c3 - c1 % 7 - 11;
+        s = s + c3 + c2;
+        keep = keep + a1 + b1;
+    }
+    return (s + keep) % 256;
+}
@@ -0,0 +1,18 @@
+// constants at the limits of the 12-bit immediates, zero operands read
+// from x0, and the logical operators
+int main() {
+    int z = 0;
+    int s = 0;
+    for (int i = -3; i < 4; i = i + 1) {
+        int a = i + 2047;
+        int b = i - 2048;
+        int c = i + 2048;
+        int d = i - 2049;
+        s = s + (a < 2047) + (b < -2048) + (c >= 2048) + (d > -2049);
+        s = s + (i == 2047) + (i != -2048) + (i == 0) + (i != z);
+        s = s + (i <= 2046) + (i >= -2047) + (2047 > i) + (-2048 < i);
+        s = s + !i + ~i + -i + (i && 2047) + (i || z) + (z && i);
+        s = s + (i && i) + (z || z) + i * z + z - i;
+    }
+    return s % 256;
+}
@@ -0,0 +1,28 @@
+// nested loops whose tops follow a fall-through edge, with a rarely taken
+// branch inside the inner loop and loops entered only by a jump
+int main() {
+    int s = 0;
+    int n = 0;
+    for (int i = 0; i < 12; i = i + 1) {
+        int j = i;
+        while (j > 0) {
+            if (j % 7 == 3)
+                s = s - j * i;
+            else
+                s = s + j;
+            j = j - 1;
+        }
+        do {
+            n = n + 1;
+        } while (n % 5 != 0);
+        if (i > 20)
+            break;
+    }
+    int k = 0;
+    while (k < s % 9 + 4) {
+        for (int m = k; m < 6; m = m + 1)
+            s = s + m * k;
+        k = k + 1;
+    }
+    return (s + n) % 256;
+}
@@ -0,0 +1,12 @@
+// a branch inside a loop which the static estimate takes the wrong way:
+// the edge profile (profiled.prof) makes the other successor fall through
+int main() {
+    int s = 0;
+    for (int i = 0; i < 100; i = i + 1) {
+        if (i % 10 == 9)
+            s = s + i * 2;
+        else
+            s = s - 1;
+    }
+    return s % 256;
+}
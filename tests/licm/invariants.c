@@ -0,0 +1,36 @@
+// invariant computations in loops, in a loop which never runs, in a
+// branch of the body, and ones which only look invariant
+int main() {
+    int s = 0;
+    for (int r = 0; r < 3; r = r + 1) {
+        int a = r + 6;
+        int b = r * 7;
+        int n = r + 4;
+        for (int i = 0; i < n; i = i + 1) {
+            int k = a * b + 3;
+            s = s + k - i;
+            if (i > 2) {
+                int m = a - b * 2;
+                s = s + m;
+            }
+        }
+        int z = r - r;
+        for (int j = 0; j < z; j = j + 1) {
+            s = s + a * 1000;
+        }
+        int c = r;
+        for (int j = 0; j < 4; j = j + 1) {
+            int v = c * 3;
+            s = s + v;
+            c = c + j;
+        }
+        int w = 0;
+        while (w < 3) {
+            for (int k = 0; k < 3; k = k + 1) {
+                s = s + n * w + a / (b + 1);
+            }
+            w = w + 1;
+        }
+    }
+    return s % 256;
+}
@@ -0,0 +1,21 @@
+// values dying at different points of nested loops
+int main() {
+    int a = 3;
+    int b = 5;
+    int c = 0;
+    int r = 0;
+    for (int i = 0; i < 6; i = i + 1) {
+        int t = a * i;
+        for (int j = 0; j < 4; j = j + 1) {
+            if (j == 2) {
+                c = c + t;
+                continue;
+            }
+            r = r + b - j;
+        }
+        a = a + 1;
+        if (i == 4)
+            b = c;
+    }
+    return (r + c + a) % 256;
+}
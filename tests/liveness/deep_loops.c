@@ -0,0 +1,19 @@
+// a loop nest whose liveness needs several worklist visits, built with
+// each register allocator (see deep_loops.flags)
+int main() {
+    int s = 0;
+    int k = 1;
+    for (int a = 0; a < 3; a = a + 1) {
+        for (int b = 0; b < 3; b = b + 1) {
+            for (int c = 0; c < 3; c = c + 1) {
+                int d = 0;
+                while (d < 3) {
+                    s = s + a * b - c + d * k;
+                    d = d + 1;
+                }
+                k = k + 1;
+            }
+        }
+    }
+    return s % 256;
+}
@@ -0,0 +1,225 @@
+// more variables than a bitset word holds, all alive across a loop
+int main() {
+    int v0 = 0;
+    int v1 = 7;
+    int v2 = 1;
+    int v3 = 8;
+    int v4 = 2;
+    int v5 = 9;
+    int v6 = 3;
+    int v7 = 10;
+    int v8 = 4;
+    int v9 = 11;
+    int v10 = 5;
+    int v11 = 12;
+    int v12 = 6;
+    int v13 = 0;
+    int v14 = 7;
+    int v15 = 1;
+    int v16 = 8;
+    int v17 = 2;
+    int v18 = 9;
+    int v19 = 3;
+    int v20 = 10;
+    int v21 = 4;
+    int v22 = 11;
+    int v23 = 5;
+    int v24 = 12;
+    int v25 = 6;
+    int v26 = 0;
+    int v27 = 7;
+    int v28 = 1;
+    int v29 = 8;
+    int v30 = 2;
+    int v31 = 9;
+    int v32 = 3;
+    int v33 = 10;
+    int v34 = 4;
+    int v35 = 11;
+    int v36 = 5;
+    int v37 = 12;
+    int v38 = 6;
+    int v39 = 0;
+    int v40 = 7;
+    int v41 = 1;
+    int v42 = 8;
+    int v43 = 2;
+    int v44 = 9;
+    int v45 = 3;
+    int v46 = 10;
+    int v47 = 4;
+    int v48 = 11;
+    int v49 = 5;
+    int v50 = 12;
+    int v51 = 6;
+    int v52 = 0;
+    int v53 = 7;
+    int v54 = 1;
+    int v55 = 8;
+    int v56 = 2;
+    int v57 = 9;
+    int v58 = 3;
+    int v59 = 10;
+    int v60 = 4;
+    int v61 = 11;
+    int v62 = 5;
+    int v63 = 12;
+    int v64 = 6;
+    int v65 = 0;
+    int v66 = 7;
+    int v67 = 1;
+    int v68 = 8;
+    int v69 = 2;
+    int v70 = 9;
+    int v71 = 3;
+    int i = 0;
+    while (i < 5) {
+        v0 = v0 + v1 % 3 + i;
+        v1 = v1 + v2 % 3 + i;
+        v2 = v2 + v3 % 3 + i;
+        v3 = v3 + v4 % 3 + i;
+        v4 = v4 + v5 % 3 + i;
+        v5 = v5 + v6 % 3 + i;
+        v6 = v6 + v7 % 3 + i;
+        v7 = v7 + v8 % 3 + i;
+        v8 = v8 + v9 % 3 + i;
+        v9 = v9 + v10 % 3 + i;
+        v10 = v10 + v11 % 3 + i;
+        v11 = v11 + v12 % 3 + i;
+        v12 = v12 + v13 % 3 + i;
+        v13 = v13 + v14 % 3 + i;
+        v14 = v14 + v15 % 3 + i;
+        v15 = v15 + v16 % 3 + i;
+        v16 = v16 + v17 % 3 + i;
+        v17 = v17 + v18 % 3 + i;
+        v18 = v18 + v19 % 3 + i;
+        v19 = v19 + v20 % 3 + i;
+        v20 = v20 + v21 % 3 + i;
+        v21 = v21 + v22 % 3 + i;
+        v22 = v22 + v23 % 3 + i;
+        v23 = v23 + v24 % 3 + i;
+        v24 = v24 + v25 % 3 + i;
+        v25 = v25 + v26 % 3 + i;
+        v26 = v26 + v27 % 3 + i;
+        v27 = v27 + v28 % 3 + i;
+        v28 = v28 + v29 % 3 + i;
+        v29 = v29 + v30 % 3 + i;
+        v30 = v30 + v31 % 3 + i;
+        v31 = v31 + v32 % 3 + i;
+        v32 = v32 + v33 % 3 + i;
+        v33 = v33 + v34 % 3 + i;
+        v34 = v34 + v35 % 3 + i;
+        v35 = v35 + v36 % 3 + i;
+        v36 = v36 + v37 % 3 + i;
+        v37 = v37 + v38 % 3 + i;
+        v38 = v38 + v39 % 3 + i;
+        v39 = v39 + v40 % 3 + i;
+        v40 = v40 + v41 % 3 + i;
+        v41 = v41 + v42 % 3 + i;
+        v42 = v42 + v43 % 3 + i;
+        v43 = v43 + v44 % 3 + i;
+        v44 = v44 + v45 % 3 + i;
+        v45 = v45 + v46 % 3 + i;
+        v46 = v46 + v47 % 3 + i;
+        v47 = v47 + v48 % 3 + i;
+        v48 = v48 + v49 % 3 + i;
+        v49 = v49 + v50 % 3 + i;
+        v50 = v50 + v51 % 3 + i;
+        v51 = v51 + v52 % 3 + i;
+        v52 = v52 + v53 % 3 + i;
+        v53 = v53 + v54 % 3 + i;
+        v54 = v54 + v55 % 3 + i;
+        v55 = v55 + v56 % 3 + i;
+        v56 = v56 + v57 % 3 + i;
+        v57 = v57 + v58 % 3 + i;
+        v58 = v58 + v59 % 3 + i;
+        v59 = v59 + v60 % 3 + i;
+        v60 = v60 + v61 % 3 + i;
+        v61 = v61 + v62 % 3 + i;
+        v62 = v62 + v63 % 3 + i;
+        v63 = v63 + v64 % 3 + i;
+        v64 = v64 + v65 % 3 + i;
+        v65 = v65 + v66 % 3 + i;
+        v66 = v66 + v67 % 3 + i;
+        v67 = v67 + v68 % 3 + i;
+        v68 = v68 + v69 % 3 + i;
+        v69 = v69 + v70 % 3 + i;
+        v70 = v70 + v71 % 3 + i;
+        v71 = v71 + v0 % 3 + i;
+        i = i + 1;
+    }
+    int s = 0;
+    s = s + v0 * 1;
+    s = s + v1 * 2;
+    s = s + v2 * 3;
+    s = s + v3 * 4;
+    s = s + v4 * 5;
+    s = s + v5 * 1;
+    s = s + v6 * 2;
+    s = s + v7 * 3;
+    s = s + v8 * 4;
+    s = s + v9 * 5;
+    s = s + v10 * 1;
+    s = s + v11 * 2;
+    s = s + v12 * 3;
+    s = s + v13 * 4;
+    s = s + v14 * 5;
+    s = s + v15 * 1;
+    s = s + v16 * 2;
+    s = s + v17 * 3;
+    s = s + v18 * 4;
+    s = s + v19 * 5;
+    s = s + v20 * 1;
+    s = s + v21 * 2;
+    s = s + v22 * 3;
+    s = s + v23 * 4;
+    s = s + v24 * 5;
+    s = s + v25 * 1;
+    s = s + v26 * 2;
+    s = s + v27 * 3;
+    s = s + v28 * 4;
+    s = s + v29 * 5;
+    s = s + v30 * 1;
+    s = s + v31 * 2;
+    s = s + v32 * 3;
+    s = s + v33 * 4;
+    s = s + v34 * 5;
+    s = s + v35 * 1;
+    s = s + v36 * 2;
+    s = s + v37 * 3;
+    s = s + v38 * 4;
+    s = s + v39 * 5;
+    s = s + v40 * 1;
+    s = s + v41 * 2;
+    s = s + v42 * 3;
+    s = s + v43 * 4;
+    s = s + v44 * 5;
+    s = s + v45 * 1;
+    s = s + v46 * 2;
+    s = s + v47 * 3;
+    s = s + v48 * 4;
+    s = s + v49 * 5;
+    s = s + v50 * 1;
+    s = s + v51 * 2;
+    s = s + v52 * 3;
+    s = s + v53 * 4;
+    s = s + v54 * 5;
+    s = s + v55 * 1;
+    s = s + v56 * 2;
+    s = s + v57 * 3;
+    s = s + v58 * 4;
+    s = s + v59 * 5;
+    s = s + v60 * 1;
+    s = s + v61 * 2;
+    s = s + v62 * 3;
+    s = s + v63 * 4;
+    s = s + v64 * 5;
+    s = s + v65 * 1;
+    s = s + v66 * 2;
+    s = s + v67 * 3;
+    s = s + v68 * 4;
+    s = s + v69 * 5;
+    s = s + v70 * 1;
+    s = s + v71 * 2;
+    return s % 256;
+}
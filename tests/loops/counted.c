@@ -0,0 +1,26 @@
+// counted loops of every test and direction, with trip counts which the
+// unrolling factor does not divide, unknown initial values, and
+// multiplications of the induction variables
+int main() {
+    int s = 0;
+    for (int r = 0; r < 3; r = r + 1) {
+        for (int i = 0; i < 10; i = i + 1)
+            s = s + i * 3;
+        for (int i = r; i <= 13; i = i + 2)
+            s = s + i * 5 + 1;
+        for (int i = 20; i > r; i = i - 3)
+            s = s - i * 7;
+        for (int i = 9; i >= -r; i = i - 1)
+            s = s + (i + 2) * -4;
+        int j = r * 2;
+        while (j < 11) {
+            s = s + j * 6 - r * j;
+            j = j + 1;
+        }
+        for (int i = 0; i < 1; i = i + 1)
+            s = s + 1;
+        for (int i = 5; i < 5; i = i + 1)
+            s = s + 1000;
+    }
+    return s % 256;
+}
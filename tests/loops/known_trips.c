@@ -0,0 +1,15 @@
+// counted loops with known trip counts, equal to the unrolling factor, a
+// multiple of it, or neither, so that the unrolled loop is entered without
+// its first test and may run only once
+int main() {
+    int s = 0;
+    for (int i = 0; i < 4; i = i + 1)
+        s = s + i * 3 + 1;
+    for (int i = 0; i < 100; i = i + 1)
+        s = s + i % 7;
+    for (int i = 10; i > 0; i = i - 3)
+        s = s - i;
+    for (int i = 0; i <= 8; i = i + 2)
+        s = s * 3 + i;
+    return s % 256;
+}
@@ -0,0 +1,50 @@
+// single-block loops whose values stay in registers, leaving through an
+// edge to a block with other predecessors (so the exit edge is split) and
+// with values still alive after the loop, and an inner loop entered from
+// the guard of its rotated outer loop (so it gets a preheader), and a
+// do-while loop whose preheader moves the values it has in registers
+int main() {
+    int s = 0;
+    int t = 1;
+    for (int r = 0; r < 4; r = r + 1) {
+        int i = r;
+        int a = s;
+        if (r % 2 == 0) {
+            while (i < 12) {
+                a = a + i * t;
+                i = i + 1;
+            }
+        } else {
+            a = a - r;
+        }
+        s = a + i;
+        int j = 0;
+        while (j * j < s)
+            j = j + 1;
+        t = t + j % 3;
+        s = s - j;
+    }
+    int u = 0;
+    int k = 0;
+    while (k < 50) {
+        int m = 0;
+        while (m < k) {
+            u = u + m;
+            m = m + 1;
+        }
+        k = k + 1;
+    }
+    for (int r = 0; r < 5; r = r + 1) {
+        int a = u * 3 + r;
+        int i = r * 2;
+        int c = a - 1;
+        int q = u;
+        do {
+            a = a + i * c;
+            q = q + a;
+            i = i + 3;
+        } while (i < 40);
+        u = u + a % 100 + q % 7;
+    }
+    return (s * 5 + t + u) % 256;
+}
@@ -0,0 +1,19 @@
+// division, remainder and multiplication by constants: powers of two,
+// negative divisors, divisors needing the "add" magic numbers, and the
+// most negative dividend
+int main() {
+    int s = 0;
+    int m = -2147483647 - 1;
+    for (int i = -40; i < 40; i = i + 7) {
+        int a = i * 123457;
+        s = s + a / 2 + a / 8 - a / 1024 + a % 16 - a % 2;
+        s = s + a / -4 + a % -8 + a / 1 + a % 1 + a / -1;
+        s = s + a / 3 + a / 7 + a / -7 + a % 7 + a % -7;
+        s = s + a / 10 - a % 10 + a / 641 + a % 1000 + a / 65536;
+        s = s + a * 9 - a * 15 + a * -3 + a * 1024 + a * -1 + a * 0;
+        s = s + i * 7 % 5 + i / 3 * 3;
+    }
+    s = s + m / 2 + m / 7 + m % 3 + m / -16 + m % 8 + m / 1000000007;
+    s = s + m / m + m % m + (m + 1) / -1;
+    return s % 256;
+}
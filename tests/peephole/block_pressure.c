@@ -0,0 +1,72 @@
+// a single block with more values alive than registers: spills are
+// followed by reloads of the same slot, which the peephole rules turn
+// into moves or drop
+int main() {
+    int k = 3;
+    int r = 0;
+    for (int i = 0; i < 3; i = i + 1) {
+        int v0 = k * 2 - 0;
+        int v1 = k * 3 - 1;
+        int v2 = k * 4 - 2;
+        int v3 = k * 5 - 3;
+        int v4 = k * 6 - 4;
+        int v5 = k * 7 - 5;
+        int v6 = k * 8 - 6;
+        int v7 = k * 9 - 7;
+        int v8 = k * 10 - 8;
+        int v9 = k * 11 - 9;
+        int v10 = k * 12 - 10;
+        int v11 = k * 13 - 11;
+        int v12 = k * 14 - 12;
+        int v13 = k * 15 - 13;
+        int v14 = k * 16 - 14;
+        int v15 = k * 17 - 15;
+        int v16 = k * 18 - 16;
+        int v17 = k * 19 - 17;
+        int v18 = k * 20 - 18;
+        int v19 = k * 21 - 19;
+        int v20 = k * 22 - 20;
+        int v21 = k * 23 - 21;
+        int v22 = k * 24 - 22;
+        int v23 = k * 25 - 23;
+        int v24 = k * 26 - 24;
+        int v25 = k * 27 - 25;
+        int v26 = k * 28 - 26;
+        int v27 = k * 29 - 27;
+        int v28 = k * 30 - 28;
+        int v29 = k * 31 - 29;
+        v0 = v0 + v3;
+        v1 = v1 + v10;
+        v2 = v2 + v17;
+        v3 = v3 + v24;
+        v4 = v4 + v1;
+        v5 = v5 + v8;
+        v6 = v6 + v15;
+        v7 = v7 + v22;
+        v8 = v8 + v29;
+        v9 = v9 + v6;
+        v10 = v10 + v13;
+        v11 = v11 + v20;
+        v12 = v12 + v27;
+        v13 = v13 + v4;
+        v14 = v14 + v11;
+        v15 = v15 + v18;
+        v16 = v16 + v25;
+        v17 = v17 + v2;
+        v18 = v18 + v9;
+        v19 = v19 + v16;
+        v20 = v20 + v23;
+        v21 = v21 + v0;
+        v22 = v22 + v7;
+        v23 = v23 + v14;
+        v24 = v24 + v21;
+        v25 = v25 + v28;
+        v26 = v26 + v5;
+        v27 = v27 + v12;
+        v28 = v28 + v19;
+        v29 = v29 + v26;
+        r = r + v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 + v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 + v24 + v25 + v26 + v27 + v28 + v29;
+        k = k + r % 5;
+    }
+    return r % 256;
+}
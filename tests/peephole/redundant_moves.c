@@ -0,0 +1,20 @@
+// leaves a store followed by a load of the same slot, and a copy of a
+// register into itself, for the peephole rules under -O
+int main() {
+    int v0 = -56156;
+    int v1 = v0;
+    int v2 = ((v1 * v1) >= (v1 || v1));
+    int v3 = (-(-v1));
+    int v4 = ((v1 - v2) - v2);
+    int v5 = (1 > (v4 || v0));
+    if ((~v5)) {
+        int w = 0;
+        while (w < 1) {
+            if ((((2047 + 5) > (v3 > 2048)) || 2048)) {
+                v1 = ((100 > ((2048 * w) > 5)) < v4);
+            }
+            w = w + 1;
+        }
+    }
+    return v0 * 1 + v1 * 3 + v2 * 5 + v3 * 7 + v4 * 9 + v5 * 11;
+}
@@ -0,0 +1,29 @@
+// values computed on some paths only, and in loops, which lazy code
+// motion can compute once; and ones which it must not move
+int main() {
+    int s = 0;
+    for (int r = 0; r < 6; r = r + 1) {
+        int a = r + 3;
+        int b = r * 2;
+        int x = 0;
+        if (r % 2 == 0) {
+            x = a * b;
+        } else {
+            s = s + 1;
+        }
+        int y = a * b;
+        s = s + x + y;
+        if (r > 3)
+            a = a + 1;
+        s = s + (a + b);
+        s = s + (a + b) * 2;
+        int i = 0;
+        while (i < 3) {
+            s = s + (a - b) + i;
+            if (i == 1)
+                b = b + 1;
+            i = i + 1;
+        }
+    }
+    return s % 256;
+}
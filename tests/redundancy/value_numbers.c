@@ -0,0 +1,23 @@
+// the same values computed in dominating blocks, with the operands
+// swapped or renamed by copies, and ones whose operands changed between
+int main() {
+    int s = 0;
+    for (int r = 1; r < 4; r = r + 1) {
+        int a = r * 5;
+        int b = r + 2;
+        int x = a + b;
+        int c = a;
+        int y = b + c;
+        if (r != 2) {
+            int z = a + b;
+            s = s + z * 2;
+            a = a + 1;
+        }
+        int w = a + b;
+        s = s + x + y + w + (a * b) - (b * a);
+        int m = a - b;
+        int n = b - a;
+        s = s + m * n;
+    }
+    return s % 256;
+}
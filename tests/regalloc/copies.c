@@ -0,0 +1,20 @@
+// copies between values which interfere, and ones which can share a
+// register
+int main() {
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    int d = 0;
+    for (int i = 0; i < 10; i = i + 1) {
+        int t = a;
+        a = b;
+        b = c;
+        c = t + i;
+        d = a;
+        d = d + b;
+    }
+    int x = d;
+    int y = x;
+    int z = y;
+    return (a * 100 + b * 10 + c + z) % 256;
+}
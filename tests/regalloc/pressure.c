@@ -0,0 +1,92 @@
+// more values alive at once than there are registers, some of them
+// used in a loop and some only before it
+int main() {
+    int v0 = 0 * 0 + 1;
+    int v1 = 1 * 1 + 1;
+    int v2 = 2 * 2 + 1;
+    int v3 = 3 * 3 + 1;
+    int v4 = 4 * 4 + 1;
+    int v5 = 5 * 5 + 1;
+    int v6 = 6 * 6 + 1;
+    int v7 = 7 * 7 + 1;
+    int v8 = 8 * 8 + 1;
+    int v9 = 9 * 9 + 1;
+    int v10 = 10 * 10 + 1;
+    int v11 = 11 * 11 + 1;
+    int v12 = 12 * 12 + 1;
+    int v13 = 13 * 13 + 1;
+    int v14 = 14 * 14 + 1;
+    int v15 = 15 * 15 + 1;
+    int v16 = 16 * 16 + 1;
+    int v17 = 17 * 17 + 1;
+    int v18 = 18 * 18 + 1;
+    int v19 = 19 * 19 + 1;
+    int v20 = 20 * 20 + 1;
+    int v21 = 21 * 21 + 1;
+    int v22 = 22 * 22 + 1;
+    int v23 = 23 * 23 + 1;
+    int v24 = 24 * 24 + 1;
+    int v25 = 25 * 25 + 1;
+    int v26 = 26 * 26 + 1;
+    int v27 = 27 * 27 + 1;
+    int v28 = 28 * 28 + 1;
+    int v29 = 29 * 29 + 1;
+    int v30 = 30 * 30 + 1;
+    int v31 = 31 * 31 + 1;
+    int once = v3 + v7;
+    int s = 0;
+    for (int i = 0; i < 20; i = i + 1) {
+        s = s + v0 - v1 + i;
+        s = s + v2 - v3 + i;
+        s = s + v4 - v5 + i;
+        s = s + v6 - v7 + i;
+        s = s + v8 - v9 + i;
+        s = s + v10 - v11 + i;
+        s = s + v12 - v13 + i;
+        s = s + v14 - v15 + i;
+        s = s + v16 - v17 + i;
+        s = s + v18 - v19 + i;
+        s = s + v20 - v21 + i;
+        s = s + v22 - v23 + i;
+        s = s + v24 - v25 + i;
+        s = s + v26 - v27 + i;
+        s = s + v28 - v29 + i;
+        s = s + v30 - v31 + i;
+        v0 = v0 + s % 7;
+    }
+    for (int j = 0; j < 3; j = j + 1) {
+        v0 = v5 + j;
+        v1 = v6 + j;
+        v2 = v7 + j;
+        v3 = v8 + j;
+        v4 = v9 + j;
+        v5 = v10 + j;
+        v6 = v11 + j;
+        v7 = v12 + j;
+        v8 = v13 + j;
+        v9 = v14 + j;
+        v10 = v15 + j;
+        v11 = v16 + j;
+        v12 = v17 + j;
+        v13 = v18 + j;
+        v14 = v19 + j;
+        v15 = v20 + j;
+        v16 = v21 + j;
+        v17 = v22 + j;
+        v18 = v23 + j;
+        v19 = v24 + j;
+        v20 = v25 + j;
+        v21 = v26 + j;
+        v22 = v27 + j;
+        v23 = v28 + j;
+        v24 = v29 + j;
+        v25 = v30 + j;
+        v26 = v31 + j;
+        v27 = v0 + j;
+        v28 = v1 + j;
+        v29 = v2 + j;
+        v30 = v3 + j;
+        v31 = v4 + j;
+    }
+    return (s + once + v0 + v1 + v2 + v3 + v4 + v5 + v6 + v7 + v8 + v9 + v10 + v11 + v12 + v13 + v14 + v15 + v16 + v17 + v18 + v19 + v20 + v21 + v22 + v23 + v24 + v25 + v26 + v27 + v28 + v29 + v30 + v31) % 256;
+}
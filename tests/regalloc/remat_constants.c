@@ -0,0 +1,29 @@
+// large constants which stay alive over a loop with many other live values,
+// so that they are evicted and loaded again with "li"; one of them crosses
+// blocks without a stack slot
+int main() {
+    int big = 305419896;
+    int neg = -19088744;
+    int mask = 65535;
+    int s = 0;
+    int a = 3;
+    int b = 5;
+    int c = 7;
+    int d = 11;
+    for (int i = 0; i < 9; i = i + 1) {
+        int e = a * i + b;
+        int f = c * i - d;
+        int g = e * f + big;
+        int h = g % 1000 + neg % 1000;
+        int j = (g + h) / 3 + (e - f) * 5;
+        int k = j * e - g * h + j % mask;
+        s = s + k % mask + e + f + g % 97 + h + j % 89;
+        if (s > big)
+            s = s - neg;
+        a = a + 1;
+        b = b + s % 4;
+        c = c + 2;
+        d = d + 1;
+    }
+    return (s + big % mask + neg % mask) % 256;
+}
@@ -0,0 +1,39 @@
+// a long block with more live values than registers, some of them read
+// again at once and others only at the end, so the choice of the value to
+// evict matters; every value is still exact after the reloads
+int main() {
+    int a = 1;
+    for (int k = 0; k < 2; k = k + 1)
+        a = a * 3 + k;
+    int b = a + 1;
+    int c = a * 2;
+    int d = b * 3;
+    int e = a - 9;
+    int f = c + d;
+    int g = e * 5;
+    int h = f - 3;
+    int i = a * 9 + b;
+    int j = b * 9 + c;
+    int k = c * 9 + d;
+    int l = d * 9 + e;
+    int m = e * 9 + f;
+    int n = f * 9 + g;
+    int o = g * 9 + h;
+    int p = h * 9 + i;
+    int q = i * j - k;
+    int r = j * k - l;
+    int s = k * l - m;
+    int t = l * m - n;
+    int u = m * n - o;
+    int v = n * o - p;
+    int w = o * p - q;
+    int x = p * q - r;
+    int y = q + r + s + t;
+    int z = u + v + w + x;
+    int s1 = y * 3 - z + a * h;
+    int s2 = s1 + b * g - c * f + d * e;
+    int s3 = s2 * i - j + k * l - m;
+    int s4 = s3 + n * o - p + q * r - s;
+    int s5 = s4 + t * u - v + w * x;
+    return (s5 + y * 7 + z * 5 + a + b + c + d + e + f + g + h) % 256;
+}
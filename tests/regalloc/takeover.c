@@ -0,0 +1,24 @@
+// copies whose source dies at the copy, so that the destination can take
+// the register of the source over: rotating loop variables, a returned
+// copy, and copies whose source is still read afterwards
+int main() {
+    int a = 0;
+    int b = 1;
+    int c = 2;
+    for (int i = 0; i < 20; i = i + 1) {
+        int t = a + b + c;
+        a = b;
+        b = c;
+        c = t % 1000;
+    }
+    int x = a;
+    int y = x;
+    int z = y + b;
+    int w = z;
+    int s = w + x;
+    int u = s;
+    int v = u;
+    v = v * 3 + u;
+    int r = v;
+    return (r + a + c) % 256;
+}
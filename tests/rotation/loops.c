@@ -0,0 +1,38 @@
+// rotated while and for loops: zero-trip loops, continue jumping to the
+// step of a for loop and to the test of a while loop, break, and loops
+// with an empty condition
+int main() {
+    int s = 0;
+    for (int i = 5; i < 5; i = i + 1)
+        s = s + 100;
+    int z = 3;
+    while (z < 0)
+        z = z + 1;
+    for (int i = 0; i < 30; i = i + 1) {
+        if (i % 4 == 1)
+            continue;
+        if (i > 24)
+            break;
+        s = s + i;
+    }
+    int j = 0;
+    while (j < 25) {
+        j = j + 1;
+        if (j % 3 != 0)
+            continue;
+        s = s + j * 2;
+    }
+    int n = 0;
+    for (;;) {
+        n = n + 1;
+        if (n * n > 200)
+            break;
+    }
+    for (int a = 0; a < 4; a = a + 1)
+        for (int b = a; b < 6; b = b + 1) {
+            if (b == 3)
+                continue;
+            s = s + a * b;
+        }
+    return (s + z + n) % 256;
+}
@@ -0,0 +1,25 @@
+// constants propagated through branches and loops: some conditions are
+// only known once the unreachable edges are ignored
+int main() {
+    int a = 4;
+    int b = a * 3;
+    int c = 0;
+    if (b > 10)
+        c = b - a;
+    else
+        c = b / 0 + 1;
+    int d = c;
+    int i = 0;
+    while (i < 5) {
+        if (d != 8)
+            d = d + 100;
+        i = i + 1;
+    }
+    int e = 1;
+    int j = 0;
+    while (j < 3) {
+        e = e;
+        j = j + 1;
+    }
+    return (d * 10 + e + i + j) % 256;
+}
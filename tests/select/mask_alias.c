@@ -0,0 +1,27 @@
+// selections against zero whose destination is coalesced with the value
+// they keep, so that the mask has to be built in another register; also
+// c ? 0 : b and a ? a : 0
+int main() {
+    int i = 0;
+    int x = 7;
+    int c = 5;
+    while (i * i < 50) {
+        x = (c > i) ? x : 0;
+        i = i + 1;
+    }
+    int y = 9;
+    int d = 3;
+    int j;
+    for (j = 0; j < 10; j = j + 1)
+        y = (j < d) ? y : 0;
+    int z = 11;
+    for (int k = 0; k < 6; k = k + 1)
+        z = (k > 3) ? 0 : z;
+    int w = 13;
+    for (int k = 0; k < 4; k = k + 1)
+        w = w ? w : 0;
+    int v = 5;
+    for (int k = 0; k < 7; k = k + 1)
+        v = (k == 2) ? v : v + 1;
+    return (x + i) * 3 + y + j * 5 + z * 7 + w + v;
+}
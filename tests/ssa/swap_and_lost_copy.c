@@ -0,0 +1,24 @@
+// the "swap" and "lost copy" problems of leaving SSA form: values
+// exchanged around a loop, and one used after being redefined
+int main() {
+    int a = 1;
+    int b = 2;
+    int c = 3;
+    int x = 0;
+    int y = 0;
+    for (int i = 0; i < 7; i = i + 1) {
+        int t = a;
+        a = b;
+        b = c;
+        c = t;
+        y = x;
+        x = x + i;
+    }
+    int p = 5;
+    int q = 0;
+    while (p > 0) {
+        q = p;
+        p = p - 2;
+    }
+    return (a * 100 + b * 10 + c + x + y + p + q) % 256;
+}